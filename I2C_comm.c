@@ -18,6 +18,16 @@
 #define I2C_TOUT_US   2000   // 各I2C操作のタイムアウト（us）
 #define I2C_RETRY_MS  20     // write_with_timeout等のリトライ期間
 
+// I2C_COMM_IN_RAM=1 なら読み書きを SRAM に置き、SDK（フラッシュ上）を経由せずレジスタを直接叩く
+#ifndef I2C_COMM_IN_RAM
+#define I2C_COMM_IN_RAM 0
+#endif
+#if I2C_COMM_IN_RAM
+#define I2C_RAM_FUNC(fn) __not_in_flash_func(fn)
+#else
+#define I2C_RAM_FUNC(fn) fn
+#endif
+
 // =========================================================
 // 基本初期化
 // =========================================================
@@ -50,6 +60,57 @@ void i2c_reset(i2c_inst_t *i2c_port, uint32_t speed, uint sda, uint scl) {
 // =========================================================
 // 基本的な読み書き（タイムアウト付き）
 // =========================================================
+#if I2C_COMM_IN_RAM
+// w を書いてから（rlen>0 なら RESTART して）r へ読む 1 トランザクション。最後の語に STOP を付ける。
+// 戻り値: 0=成功, -1=書込み側で中断／タイムアウト, -2=読出し側で中断／タイムアウト
+static int I2C_RAM_FUNC(i2c_xfer_regs)(i2c_inst_t *port, uint8_t dev, const uint8_t *w, size_t wlen,
+                                       uint8_t *r, size_t rlen) {
+    i2c_hw_t *hw = i2c_get_hw(port);
+    hw->enable = 0;
+    hw->tar = dev;
+    hw->enable = 1;
+
+    const size_t n = wlen + rlen;
+    const uint32_t t0 = time_us_32();
+    bool abort = false, timeout = false;
+    size_t i = 0;
+    for (; i < n && !abort && !timeout; i++) {
+        uint32_t cmd = (i < wlen) ? w[i] : I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == wlen && wlen) cmd |= I2C_IC_DATA_CMD_RESTART_BITS;
+        if (i + 1 == n)        cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+        hw->data_cmd = cmd;
+        if (i < wlen) {
+            while (!(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_EMPTY_BITS))
+                if (time_us_32() - t0 > I2C_TOUT_US) { timeout = true; break; }
+        } else {
+            while (!hw->rxflr && !(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS))
+                if (time_us_32() - t0 > I2C_TOUT_US) { timeout = true; break; }
+            if (hw->rxflr) r[i - wlen] = (uint8_t)hw->data_cmd;
+        }
+        if (hw->tx_abrt_source) { abort = true; (void)hw->clr_tx_abrt; }
+    }
+    // 中断時もコントローラが STOP を出すので STOP 検出まで待つ
+    if (!timeout) {
+        while (!(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS))
+            if (time_us_32() - t0 > I2C_TOUT_US) { timeout = true; break; }
+        (void)hw->clr_stop_det;
+    }
+    if (!abort && !timeout) return 0;
+    return (i <= wlen) ? -1 : -2;
+}
+
+int I2C_RAM_FUNC(i2c_read)(i2c_inst_t *port, uint8_t dev, uint8_t reg, uint8_t *data, size_t len) {
+    return i2c_xfer_regs(port, dev, &reg, 1, data, len);
+}
+
+int I2C_RAM_FUNC(i2c_write)(i2c_inst_t *port, uint8_t dev, uint8_t reg, uint8_t *data, size_t len) {
+    uint8_t buf[9];
+    if (len > sizeof(buf)-1) return -9;
+    buf[0] = reg;
+    for (size_t i = 0; i < len; i++) buf[1 + i] = data[i];
+    return (i2c_xfer_regs(port, dev, buf, len + 1, NULL, 0) < 0) ? -1 : 0;
+}
+#else
 int i2c_read(i2c_inst_t *port, uint8_t dev, uint8_t reg, uint8_t *data, size_t len) {
     int r = i2c_write_timeout_us(port, dev, &reg, 1, true, I2C_TOUT_US);
     if (r < 0) return -1;
@@ -65,6 +126,7 @@ int i2c_write(i2c_inst_t *port, uint8_t dev, uint8_t reg, uint8_t *data, size_t
     int r = i2c_write_timeout_us(port, dev, buf, len + 1, false, I2C_TOUT_US);
     return (r < 0) ? -1 : 0;
 }
+#endif
 
 // =========================================================
 // リトライ付き読み書き（ブロック回避）
@@ -1,17 +1,41 @@
 #include "led_blink.h"
-#include "hardware/timer.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "led_blink.pio.h"
 
-static struct repeating_timer led_timer;
+#define LED_SM_HZ   2048u       // 1 スロット 64 サイクル = 31.25 ms
 
-static bool toggle_led(struct repeating_timer *t) {
-    static bool state = false;
-    gpio_put(LED_PIN, state);
-    state = !state;
-    return true; // 繰り返す
-}
+static PIO      led_pio = pio0;
+static int      led_sm = -1;
+static uint32_t led_pat;
 
-void start_led_blinking(uint interval_ms) {
+bool start_led_pattern(uint32_t pattern) {
     gpio_init(LED_PIN);
     gpio_set_dir(LED_PIN, GPIO_OUT);
-    add_repeating_timer_ms(interval_ms, toggle_led, NULL, &led_timer);
+    gpio_put(LED_PIN, 1);
+    led_sm = pio_claim_unused_sm(led_pio, false);
+    if (led_sm < 0 || !pio_can_add_program(led_pio, &led_pattern_program)) {
+        if (led_sm >= 0) pio_sm_unclaim(led_pio, (uint)led_sm);
+        led_sm = -1;
+        return false;
+    }
+    uint offset = pio_add_program(led_pio, &led_pattern_program);
+    // 分周比の上限は 65536（clk_sys が 134 MHz を超えると周期が縮む）
+    float div = (float)clock_get_hz(clk_sys) / (float)LED_SM_HZ;
+    if (div > 65535.0f) div = 65535.0f;
+    led_pattern_program_init(led_pio, (uint)led_sm, offset, LED_PIN, div);
+    led_pat = ~pattern;
+    led_set_pattern(pattern);
+    return true;
+}
+
+void led_set_pattern(uint32_t pattern) {
+    if (led_sm < 0 || pattern == led_pat) return;
+    pio_sm_clear_fifos(led_pio, (uint)led_sm);     // 未取り込みのパターンは捨て, 最新の 1 語だけ待たせる
+    pio_sm_put(led_pio, (uint)led_sm, pattern);
+    led_pat = pattern;
+}
+
+uint32_t led_pattern(void) {
+    return led_pat;
 }
\ No newline at end of file
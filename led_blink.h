@@ -1,4 +1,6 @@
 // led_blink.h
+// LED の点灯パターンを PIO で出す（タイマ割り込みなし）。
+// パターンは 32 ビット = 32 スロット × 31.25 ms（約 1 s 周期）, LSB から順に出す。
 
 #ifndef LED_BLINK_H
 #define LED_BLINK_H
@@ -7,6 +9,20 @@
 
 #define LED_PIN 25
 
-void start_led_blinking(uint interval_ms);
+#define LED_PAT_OFF      0x00000000u    // 消灯
+#define LED_PAT_BOOT     0x0F0F0F0Fu    // 125 ms 点灯 / 125 ms 消灯（起動中・チップ検出待ち）
+#define LED_PAT_LOCKED   0x0000FFFFu    // 0.5 s 点灯 / 0.5 s 消灯（正常）
+#define LED_PAT_LOL      0x00000033u    // 短く 2 回（PLL ロック外れ）
+#define LED_PAT_LOS      0x00000333u    // 短く 3 回（基準入力断）
+#define LED_PAT_BUS_ERR  0x55555555u    // 16 Hz 点滅（I2C バス異常・チップ応答なし）
+#define LED_PAT_SWEEP    0x01010101u    // 250 ms ごとに短く点灯（掃引再生中）
+
+// PIO のステートマシンを 1 つ取ってパターンを出し始める（空きがなければ false, LED は点灯のまま）
+bool start_led_pattern(uint32_t pattern);
+
+// パターンを切り替える（変わったときだけ FIFO へ 1 語, 切替は次の周期の頭）
+void led_set_pattern(uint32_t pattern);
+
+uint32_t led_pattern(void);
 
 #endif
\ No newline at end of file
@@ -58,14 +58,11 @@ void serial_comm_echo(void) {
 }
 
 // ============================================================
-//                  標準コマンド受信（MCP9600など）
+//                  コマンド受信（行の組み立て）
 // ============================================================
 
-const char* serial_receive_command(void) {
-    static char recv_buf[64];
-    static char command_buf[64];
-    static int recv_index = 0;
-
+// 2 つの受信関数は同じ処理なので、モジュールの recv_buf / command_buf を共用する
+static const char* receive_line(void) {
     int ch = getchar_timeout_us(2000);
     if (ch == PICO_ERROR_TIMEOUT) return NULL;
 
@@ -84,40 +81,20 @@ const char* serial_receive_command(void) {
         return command_buf;
     }
 
-    if (recv_index < (int)sizeof(recv_buf) - 1)
+    if (recv_index < SERIAL_BUF_LEN - 1)
         recv_buf[recv_index++] = (char)ch;
 
     return NULL;
 }
 
-// ============================================================
-//          Si5351A CLIなど高速応答用の受信関数
-// ============================================================
+// 標準コマンド受信（MCP9600など）
+const char* serial_receive_command(void) {
+    return receive_line();
+}
 
+// Si5351A CLIなど高速応答用
 const char* serial_receive_command_fast(void) {
-    static char buf[64];
-    static char cmd[64];
-    static int idx = 0;
-
-    int ch = getchar_timeout_us(2000);
-    if (ch == PICO_ERROR_TIMEOUT) return NULL;
-
-    if (ch == '\r' || ch == '\n') {
-        if (idx == 0) return NULL;
-        buf[idx] = '\0';
-        strncpy(cmd, buf, sizeof(cmd));
-        idx = 0;
-
-        // CR+LF対策
-        while (true) {
-            int next = getchar_timeout_us(0);
-            if (next != '\r' && next != '\n') break;
-        }
-        return cmd;
-    }
-
-    if (idx < (int)sizeof(buf) - 1) buf[idx++] = (char)ch;
-    return NULL;
+    return receive_line();
 }
 
 // ============================================================
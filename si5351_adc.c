@@ -0,0 +1,136 @@
+/**
+ * @file    si5351_adc.c
+ * @brief   ADC 入力の DMA 取り込み（sna の検波器入力, fm の変調入力）と模擬入力
+ * @date    2025-11-16
+ * @version 1.0
+ */
+
+#include "si5351_adc.h"
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+
+#define ADC_CLK_HZ      48000000u
+#define ADC_CONV_CLKS   96u             // 1 変換のクロック数（clkdiv がこれ未満なら最高速）
+#define ADC_RING_COUNT  0xFFFFFFFFu     // リング取り込みの転送数（残数から書いた総数を出す）
+
+static int               g_dma = -1;
+static bool              g_ready, g_running;
+static uint32_t          g_rate = SI5351_ADC_MAX_SPS;
+static si5351_adc_sim_fn g_sim;
+static void             *g_sim_ctx;
+static uint16_t         *g_ring;                // リング取り込み中なら非 NULL
+static uint32_t          g_ring_mask, g_ring_done;
+static uint64_t          g_ring_t0;
+
+static void apply_rate(void) {
+    float div = (g_rate >= SI5351_ADC_MAX_SPS) ? 0.0f : (float)ADC_CLK_HZ / (float)g_rate - 1.0f;
+    adc_set_clkdiv(div < (float)ADC_CONV_CLKS ? 0.0f : div);
+}
+
+bool si5351_adc_init(uint8_t gpio) {
+    if (gpio < 26 || gpio > 29) return false;
+    if (g_dma < 0) {
+        g_dma = dma_claim_unused_channel(false);
+        if (g_dma < 0) return false;
+        adc_init();
+    }
+    adc_gpio_init(gpio);
+    adc_select_input(gpio - 26u);
+    adc_fifo_setup(true, true, 1, false, false);       // 1 サンプルごとに DREQ, 12 bit のまま
+    apply_rate();
+    g_ready = true;
+    return true;
+}
+
+uint32_t si5351_adc_set_rate(uint32_t sps) {
+    if (sps == 0 || sps > SI5351_ADC_MAX_SPS) sps = SI5351_ADC_MAX_SPS;
+    uint32_t div = ADC_CLK_HZ / sps;
+    g_rate = (div <= ADC_CONV_CLKS) ? SI5351_ADC_MAX_SPS : ADC_CLK_HZ / div;
+    if (g_ready) apply_rate();
+    return g_rate;
+}
+
+uint32_t si5351_adc_rate(void) { return g_rate; }
+
+void si5351_adc_set_sim(si5351_adc_sim_fn fn, void *ctx) {
+    si5351_adc_stop();
+    g_sim = fn;
+    g_sim_ctx = ctx;
+}
+
+bool si5351_adc_sim_active(void) { return g_sim != NULL; }
+
+int si5351_adc_start(uint16_t *buf, uint32_t n) {
+    if (g_sim) { g_sim(buf, n, g_sim_ctx); return 0; }
+    if (!g_ready && !si5351_adc_init(SI5351_ADC_GPIO)) return -1;
+
+    adc_run(false);
+    adc_fifo_drain();
+    dma_channel_config c = dma_channel_get_default_config((uint)g_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    dma_channel_configure((uint)g_dma, &c, buf, &adc_hw->fifo, n, true);
+    adc_run(true);
+    g_running = true;
+    return 0;
+}
+
+int si5351_adc_ring_start(uint16_t *buf, uint8_t log2_n) {
+    uint32_t bytes = 2u << log2_n;
+    if (log2_n > 14 || ((uintptr_t)buf & (bytes - 1u))) return -1;
+    si5351_adc_stop();
+    g_ring      = buf;
+    g_ring_mask = (1u << log2_n) - 1u;
+    g_ring_done = 0;
+    g_ring_t0   = time_us_64();
+    if (g_sim) return 0;
+    if (!g_ready && !si5351_adc_init(SI5351_ADC_GPIO)) { g_ring = NULL; return -1; }
+
+    adc_run(false);
+    adc_fifo_drain();
+    dma_channel_config c = dma_channel_get_default_config((uint)g_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, log2_n + 1u);     // 書込みアドレスの下位 log2_n+1 bit だけが回る
+    channel_config_set_dreq(&c, DREQ_ADC);
+    dma_channel_configure((uint)g_dma, &c, buf, &adc_hw->fifo, ADC_RING_COUNT, true);
+    adc_run(true);
+    g_running = true;
+    return 0;
+}
+
+uint32_t si5351_adc_ring_count(void) {
+    if (!g_ring) return 0;
+    if (!g_sim) return ADC_RING_COUNT - dma_hw->ch[g_dma].transfer_count;
+    // 模擬: 経過時間ぶんを順に埋める（呼び出しが空いても模擬入力の位相は連続する）
+    uint32_t due = (uint32_t)((time_us_64() - g_ring_t0) * g_rate / 1000000u);
+    while (g_ring_done != due) {
+        uint32_t i = g_ring_done & g_ring_mask, n = g_ring_mask + 1u - i;
+        if (n > due - g_ring_done) n = due - g_ring_done;
+        g_sim(&g_ring[i], n, g_sim_ctx);
+        g_ring_done += n;
+    }
+    return due;
+}
+
+bool si5351_adc_busy(void) {
+    if (!g_running) return false;
+    if (dma_channel_is_busy((uint)g_dma)) return true;
+    adc_run(false);
+    adc_fifo_drain();
+    g_running = false;
+    return false;
+}
+
+void si5351_adc_stop(void) {
+    g_ring = NULL;
+    if (!g_running) return;
+    dma_channel_abort((uint)g_dma);
+    adc_run(false);
+    adc_fifo_drain();
+    g_running = false;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file    si5351_adc.h
+ * @brief   ADC 入力の DMA 取り込み（sna の検波器入力, fm の変調入力）と模擬入力
+ * @date    2025-11-16
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * ADC を 1 入力（GPIO26..29）で連続変換し、FIFO を DMA で n 語のバッファへ移す。
+ * 取り込み中も CPU は空いているので、呼び出し側は次の準備や結果の送出を並行して進められる。
+ * リング取り込み（si5351_adc_ring_start）は 2^k 語のバッファへ止まらずに書き続け、
+ * 書いた総数（si5351_adc_ring_count）から最新のサンプルと取りこぼしを知る。
+ *
+ * si5351_adc_set_sim() で模擬入力を設定すると、ハードウェアに触れずにその関数がバッファを埋める
+ * （検波器をつないでいない基板での動作確認・ホスト側ツールの確認用）。
+ * リング取り込みでは si5351_adc_ring_count() を呼んだ時点までに変換レートで出ているはずの分を順に埋める。
+ */
+
+#ifndef SI5351_ADC_H
+#define SI5351_ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_ADC_GPIO
+#define SI5351_ADC_GPIO     26          // ADC0
+#endif
+#define SI5351_ADC_MAX_SPS  500000u     // 48 MHz / 96 クロック
+#define SI5351_ADC_BITS     12
+
+/** 模擬入力: buf に n サンプル（0..4095）を書く */
+typedef void (*si5351_adc_sim_fn)(uint16_t *buf, uint32_t n, void *ctx);
+
+/** ADC と DMA チャネルを用意する（最初の取り込みで自動的に呼ばれる）。ADC ピンでないか DMA が空いていなければ false */
+bool     si5351_adc_init(uint8_t gpio);
+
+/** 変換レート [samples/s]（0 または上限超えは 500 ksps）。実際のレートを返す */
+uint32_t si5351_adc_set_rate(uint32_t sps);
+uint32_t si5351_adc_rate(void);
+
+/** 模擬入力を設定する（fn=NULL で実 ADC に戻す） */
+void     si5351_adc_set_sim(si5351_adc_sim_fn fn, void *ctx);
+bool     si5351_adc_sim_active(void);
+
+/**
+ * @brief n サンプルの取り込みを始める（模擬入力ならその場で埋めて戻る）
+ * @return 0=開始, -1=ADC を使えない
+ */
+int      si5351_adc_start(uint16_t *buf, uint32_t n);
+
+/**
+ * @brief リング取り込みを始める（si5351_adc_stop() まで続く）
+ * @param buf 2^log2_n 語, (2 << log2_n) バイト境界に置くこと（DMA の書込みリング）
+ * @return 0=開始, -1=ADC を使えない・境界が合わない
+ */
+int      si5351_adc_ring_start(uint16_t *buf, uint8_t log2_n);
+
+/** リング取り込みで書いたサンプルの総数（最新は buf[(count - 1) & (n - 1)], 約 2^32 サンプルで一巡） */
+uint32_t si5351_adc_ring_count(void);
+
+/** 取り込み中なら true（終わっていれば ADC を止めて FIFO を空にする） */
+bool     si5351_adc_busy(void);
+
+/** 取り込みを中止する */
+void     si5351_adc_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_ADC_H
@@ -0,0 +1,284 @@
+/**
+ * @file    si5351_boot.c
+ * @brief   起動状態機械（I2C バス初期化・チップ検出の再試行・出力設定・在席監視）
+ * @date    2025-11-14
+ * @version 1.0
+ */
+
+#include "si5351_boot.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "I2C_comm.h"
+#include "serial_comm.h"
+#include "si5351_engine.h"
+#include "si5351_cli.h"
+#include "led_blink.h"
+
+// ===== 内部状態 =====
+static si5351_boot_cfg_t   g_cfg;
+static si5351_boot_state_t g_state = SI5351_BOOT_BUS;
+static bool                g_configured;        // 一度でも出力を設定した（以降の再検出は書き戻し）
+static uint32_t            g_next_ms;           // 次の手順を始める時刻
+static uint32_t            g_backoff_ms = SI5351_BOOT_BACKOFF_MIN_MS;
+static uint32_t            g_attempts;          // 現在の状態での試行回数
+static uint32_t            g_found_ms;          // 最後に検出した時刻
+static uint32_t            g_losses;
+static bool                g_failing;           // 直前の手順が失敗して再試行待ち
+static unsigned            g_led;               // k_led の添字
+
+// エンジンで実行する手順（CALL 操作）。g_op_busy が落ちたら g_op_rc に結果
+typedef enum { OP_NONE = 0, OP_BUS, OP_PROBE, OP_CHECK, OP_RELOAD } boot_op_t;
+static boot_op_t     g_op;
+static volatile bool g_op_busy;
+static volatile int  g_op_rc;
+
+static const char *const k_state_name[] = { "bus", "probe", "init", "ready", "lost" };
+
+// LED の表示（優先度の高い順に判定, led_pick() の戻り値）
+enum { LED_BOOT = 0, LED_LOCKED, LED_LOL, LED_LOS, LED_BUS_ERR, LED_SWEEP };
+static const struct { uint32_t pat; const char *name; } k_led[] = {
+    { LED_PAT_BOOT,    "boot" },
+    { LED_PAT_LOCKED,  "locked" },
+    { LED_PAT_LOL,     "LOL" },
+    { LED_PAT_LOS,     "LOS" },
+    { LED_PAT_BUS_ERR, "bus error" },
+    { LED_PAT_SWEEP,   "sweep" },
+};
+
+static uint32_t now_ms(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+// ===== ping / scan（エンジン文脈）=====
+void si5351_boot_ping(void) {
+    uint8_t dummy = 0;
+    int rc = i2c_write_timeout_us(g_cfg.port, g_cfg.addr, &dummy, 0, false, 5000);
+    if (rc >= 0) serial_printf("[PING] 0x%02X ACK", 1, g_cfg.addr);
+    else         serial_printf("[PING] 0x%02X NACK/Timeout (rc=%d)", 1, g_cfg.addr, rc);
+}
+
+void si5351_boot_scan(void) {
+    serial_printf("[SCAN] strict 7-bit scan (write reg=0 + read 1B)...", 1);
+    int found = 0;
+    for (uint8_t addr = 0x03; addr <= 0x77; addr++) {
+        uint8_t v = 0x00;
+        int rc1 = i2c_write_timeout_us(g_cfg.port, addr, &v, 1, true, 2000);
+        int rc2 = i2c_read_timeout_us(g_cfg.port, addr, &v, 1, false, 2000);
+        if (rc1 >= 0 && rc2 >= 0) {
+            serial_printf("  - found 0x%02X (val=0x%02X)", 1, addr, v);
+            found++;
+        }
+        sleep_us(500);
+    }
+    if (!found) serial_printf("[SCAN] none", 1);
+}
+
+// ===== エンジンで実行する手順 =====
+static void op_done(int rc) {
+    g_op_rc = rc;
+    __dmb();
+    g_op_busy = false;
+}
+
+// バス解放と I2C 初期化。解放後も SDA が Low なら失敗（-2）。2 回目以降は表示せずにピンを戻すだけ
+static void bus_op(void) {
+    static bool inited;
+    i2c_bus_clear(g_cfg.sda, g_cfg.scl);
+    sleep_ms(2);
+    bool sda_high = gpio_get(g_cfg.sda);
+    if (!inited) {
+        if (!i2c_init_config(g_cfg.port, g_cfg.speed_hz, g_cfg.sda, g_cfg.scl)) { op_done(-1); return; }
+        inited = true;
+    } else {
+        i2c_init(g_cfg.port, g_cfg.speed_hz);
+        gpio_set_function(g_cfg.sda, GPIO_FUNC_I2C);
+        gpio_set_function(g_cfg.scl, GPIO_FUNC_I2C);
+    }
+    op_done(sda_high ? 0 : -2);
+}
+
+// STAT0 を読めれば在席。未設定なら strict scan も出す
+static void probe_op(void) {
+    uint8_t st = 0;
+    int rc = i2c_read(g_cfg.port, g_cfg.addr, 0x00, &st, 1);
+    if (rc == 0 && !g_configured) si5351_boot_scan();
+    op_done(rc == 0 ? 0 : (gpio_get(g_cfg.sda) ? -1 : -2));
+}
+
+static void check_op(void)  { op_done(si5351_engine_check()); }
+static void reload_op(void) { op_done(si5351_engine_reload()); }
+
+static bool start_op(boot_op_t kind) {
+    static void (*const k_fn[])(void) = { NULL, bus_op, probe_op, check_op, reload_op };
+    si5351_op_t op = { .code = SI5351_OP_CALL };
+    op.v.fn = k_fn[kind];
+    g_op = kind;
+    g_op_busy = true;
+    if (si5351_engine_submit(&op)) {
+        if (kind == OP_BUS || kind == OP_PROBE) g_attempts++;
+        return true;
+    }
+    g_op = OP_NONE;             // リング満杯: 次回の poll でやり直す
+    g_op_busy = false;
+    return false;
+}
+
+static void submit(uint8_t code, uint8_t ch, uint32_t v) {
+    si5351_op_t op = { .code = code, .ch = ch };
+    op.v.u = v;
+    si5351_engine_submit_wait(&op);
+}
+
+// ===== 状態遷移 =====
+static void enter(si5351_boot_state_t s, uint32_t delay_ms) {
+    if (s != g_state) { g_attempts = 0; g_failing = false; }
+    g_state = s;
+    g_next_ms = now_ms() + delay_ms;
+}
+
+// 失敗: 間隔を倍にして同じ状態（または s）で待つ
+static void retry(si5351_boot_state_t s) {
+    enter(s, g_backoff_ms);
+    g_failing = true;
+    g_backoff_ms = (g_backoff_ms * 2u > SI5351_BOOT_BACKOFF_MAX_MS) ? SI5351_BOOT_BACKOFF_MAX_MS : g_backoff_ms * 2u;
+}
+
+void si5351_boot_start(const si5351_boot_cfg_t *cfg, si5351_boot_state_t first) {
+    g_cfg = *cfg;
+    g_configured = (first == SI5351_BOOT_READY);
+    g_backoff_ms = SI5351_BOOT_BACKOFF_MIN_MS;
+    if (g_configured) g_found_ms = now_ms();
+    enter(first, first == SI5351_BOOT_READY ? SI5351_BOOT_CHECK_MS : 0);
+}
+
+// 手順の結果を見て次へ（表示したら true）
+static bool on_result(boot_op_t kind, int rc) {
+    switch (kind) {
+    case OP_BUS:
+        if (rc == 0) {
+            g_backoff_ms = SI5351_BOOT_BACKOFF_MIN_MS;
+            enter(g_configured ? SI5351_BOOT_LOST : SI5351_BOOT_PROBE, 0);
+            return false;
+        }
+        retry(SI5351_BOOT_BUS);
+        if (g_attempts != 1) return false;
+        serial_printf("[BOOT] I2C bus %s, retrying in background", 1, rc == -2 ? "stuck (SDA low)" : "init failed");
+        return true;
+
+    case OP_PROBE:
+        if (rc != 0) {
+            bool first = (g_attempts == 1 && g_state == SI5351_BOOT_PROBE);
+            if (first) serial_printf("[BOOT] Si5351A @0x%02X not responding, retrying in background", 1, g_cfg.addr);
+            retry(rc == -2 ? SI5351_BOOT_BUS : g_state);
+            return first;
+        }
+        g_backoff_ms = SI5351_BOOT_BACKOFF_MIN_MS;
+        g_found_ms = now_ms();
+        if (g_configured) {
+            // 抜き差し・後からの給電: 構成を失ったチップへシャドウの像を書き戻す
+            serial_printf("[BOOT] Si5351A @0x%02X is back, rewriting configuration", 1, g_cfg.addr);
+            if (!start_op(OP_RELOAD)) enter(SI5351_BOOT_LOST, 0);
+            return true;
+        }
+        serial_printf("[BOOT] Si5351A @0x%02X found after %lu attempt(s), init PLLA...", 1, g_cfg.addr,
+                      (unsigned long)g_attempts);
+        submit(SI5351_OP_INIT, 0, 0);
+        enter(SI5351_BOOT_INIT, 100);       // PLL の安定を待ってから出力を設定
+        return true;
+
+    case OP_CHECK:
+        if (rc == 1) {
+            serial_printf("[BOOT] Si5351A lost its configuration (power cycle?), rewriting", 1);
+            if (!start_op(OP_RELOAD)) enter(SI5351_BOOT_READY, 0);
+            return true;
+        }
+        if (rc < 0) {
+            g_losses++;
+            serial_printf("[BOOT] Si5351A @0x%02X stopped responding, waiting for it", 1, g_cfg.addr);
+            enter(SI5351_BOOT_LOST, 0);
+            return true;
+        }
+        enter(SI5351_BOOT_READY, SI5351_BOOT_CHECK_MS);
+        return false;
+
+    case OP_RELOAD:
+        if (rc < 0) { enter(SI5351_BOOT_LOST, 0); return false; }
+        serial_printf("[BOOT] configuration rewritten (%d byte(s), PLL reset)", 1, rc);
+        enter(SI5351_BOOT_READY, SI5351_BOOT_CHECK_MS);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static unsigned led_pick(void) {
+    switch (g_state) {
+    case SI5351_BOOT_BUS:   return g_failing ? LED_BUS_ERR : LED_BOOT;
+    case SI5351_BOOT_LOST:  return LED_BUS_ERR;
+    case SI5351_BOOT_READY: break;
+    default:                return LED_BOOT;
+    }
+    uint8_t a = si5351_engine_alarms();
+    if (a & 0x18) return LED_LOS;
+    if (a & 0xE0) return LED_LOL;           // SYS_INIT は書き戻しまでロックしていない扱い
+    return si5351_engine_sweeping() ? LED_SWEEP : LED_LOCKED;
+}
+
+static bool step(void) {
+    if (g_op_busy) return false;
+    if (g_op != OP_NONE) {
+        boot_op_t kind = g_op;
+        g_op = OP_NONE;
+        __dmb();
+        return on_result(kind, g_op_rc);
+    }
+    if ((int32_t)(now_ms() - g_next_ms) < 0) return false;
+
+    switch (g_state) {
+    case SI5351_BOOT_BUS:   (void)start_op(OP_BUS); break;
+    case SI5351_BOOT_PROBE:
+    case SI5351_BOOT_LOST:  (void)start_op(OP_PROBE); break;
+    case SI5351_BOOT_READY: (void)start_op(OP_CHECK); break;
+    case SI5351_BOOT_INIT:
+        if (!si5351_engine_idle()) break;
+        submit(SI5351_OP_FREQ, 0, 100000000UL);
+        submit(SI5351_OP_FREQ, 1, 0);
+        submit(SI5351_OP_FREQ, 2, 0);
+        serial_printf("[BOOT] CLK0=100 MHz output enabled (CLK1/2 OFF)", 1);
+        si5351_cli_autorun();
+        g_configured = true;
+        enter(SI5351_BOOT_READY, SI5351_BOOT_CHECK_MS);
+        return true;
+    }
+    return false;
+}
+
+bool si5351_boot_poll(void) {
+    bool printed = step();
+    g_led = led_pick();
+    led_set_pattern(k_led[g_led].pat);      // 変わったときだけ PIO の FIFO へ（周期の頭で取り込む, 割り込みなし）
+    return printed;
+}
+
+si5351_boot_state_t si5351_boot_state(void) {
+    return g_state;
+}
+
+const char *si5351_boot_state_name(si5351_boot_state_t s) {
+    return ((unsigned)s < sizeof(k_state_name) / sizeof(k_state_name[0])) ? k_state_name[s] : "?";
+}
+
+void si5351_boot_show(void) {
+    uint32_t t = now_ms();
+    if (g_state == SI5351_BOOT_READY) {
+        serial_printf("boot: ready (Si5351A @0x%02X up %lu s, lost %lu time(s)), led %s", 1, g_cfg.addr,
+                      (unsigned long)((t - g_found_ms) / 1000u), (unsigned long)g_losses, k_led[g_led].name);
+        return;
+    }
+    int32_t wait = (int32_t)(g_next_ms - t);
+    serial_printf("boot: %s, attempt %lu, next try in %ld ms (backoff %lu ms), led %s", 1,
+                  si5351_boot_state_name(g_state), (unsigned long)g_attempts, (long)(wait > 0 ? wait : 0),
+                  (unsigned long)g_backoff_ms, k_led[g_led].name);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file    si5351_boot.h
+ * @brief   起動状態機械（I2C バス初期化・チップ検出の再試行・出力設定・在席監視）
+ * @date    2025-11-14
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * I2C の初期化失敗やチップ無応答で止まらず、CLI を動かしたままメインループから si5351_boot_poll() で進める。
+ * I2C に触れる手順はすべて si5351_engine_submit() で CALL 操作としてエンジンへ渡し、結果は次回の poll で見る
+ * （DMA 再生中などエンジンが忙しくてもメインループは待たない）。
+ *
+ *   BUS → PROBE → INIT（100 ms 待ち）→ READY ⇄ LOST
+ *   - BUS / PROBE の失敗は待って再試行（PROBE で SDA が張り付いていれば BUS からやり直す）
+ *   - READY では SI5351_BOOT_CHECK_MS ごとに在席を確かめ, 応答がなければ LOST, チップが再起動していれば書き戻す
+ *   - LOST で応答が戻れば si5351_engine_reload() で書き戻して READY
+ *
+ * 再試行の間隔は SI5351_BOOT_BACKOFF_MIN_MS から倍々で SI5351_BOOT_BACKOFF_MAX_MS まで延ばす。
+ * 最初の検出では従来の起動手順（init → CLK0=100 MHz → CLK1/2 停止 → autorun）を投入し、
+ * 一度設定した後の再検出では si5351_engine_reload() でシャドウの像を書き戻す（モジュールの抜き差し・後からの給電）。
+ *
+ * LED の表示（led_blink.h: boot / locked / LOL / LOS / bus error / sweep）も poll のたびに状態から選ぶ。
+ */
+
+#ifndef SI5351_BOOT_H
+#define SI5351_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_BOOT_BACKOFF_MIN_MS
+#define SI5351_BOOT_BACKOFF_MIN_MS  100
+#endif
+#ifndef SI5351_BOOT_BACKOFF_MAX_MS
+#define SI5351_BOOT_BACKOFF_MAX_MS  5000
+#endif
+#ifndef SI5351_BOOT_CHECK_MS
+#define SI5351_BOOT_CHECK_MS        1000    // READY 中の在席確認の間隔
+#endif
+
+typedef enum {
+    SI5351_BOOT_BUS = 0,    // I2C バス解放・初期化
+    SI5351_BOOT_PROBE,      // チップの応答待ち（未設定）
+    SI5351_BOOT_INIT,       // init 投入済み, PLL の安定待ち
+    SI5351_BOOT_READY,      // 出力設定済み
+    SI5351_BOOT_LOST,       // 応答が途絶えた（設定はシャドウに残っている）
+} si5351_boot_state_t;
+
+/** 配線 */
+typedef struct {
+    i2c_inst_t *port;
+    uint8_t     addr;
+    uint        sda, scl;
+    uint32_t    speed_hz;
+} si5351_boot_cfg_t;
+
+/**
+ * @brief 状態機械を始める（si5351_cli_init() の後）
+ * @param first 最初の状態（通常 BUS。I2C 初期化済みなら PROBE, ウォッチドッグ復元済みなら READY）
+ */
+void si5351_boot_start(const si5351_boot_cfg_t *cfg, si5351_boot_state_t first);
+
+/**
+ * @brief 状態機械を進める（メインループから毎回呼ぶ, 待たない）
+ * @return 何か表示したら true（プロンプトを出し直す）
+ */
+bool si5351_boot_poll(void);
+
+si5351_boot_state_t si5351_boot_state(void);
+
+/** 状態名（bus/probe/init/ready/lost） */
+const char *si5351_boot_state_name(si5351_boot_state_t s);
+
+/** 状態・試行回数・次の再試行までの時間を 1 行表示する（status 用） */
+void si5351_boot_show(void);
+
+/** 0x60 への ping（エンジン文脈） */
+void si5351_boot_ping(void);
+
+/** 7-bit 全アドレスの strict scan（書込み reg=0 + 読出し 1 B, エンジン文脈） */
+void si5351_boot_scan(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_BOOT_H
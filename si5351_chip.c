@@ -0,0 +1,24 @@
+/**
+ * @file    si5351_chip.c
+ * @brief   Si5351 派生品テーブル
+ * @date    2025-11-06
+ * @version 1.0
+ */
+
+#include "si5351_chip.h"
+#include <string.h>
+#include <strings.h>
+
+const si5351_chip_t si5351_chips[SI5351_CHIP_COUNT] = {
+    [SI5351_CHIP_A3] = { "a3", 3, false, false },
+    [SI5351_CHIP_A8] = { "a8", 8, false, false },
+    [SI5351_CHIP_B]  = { "b",  8, true,  false },
+    [SI5351_CHIP_C]  = { "c",  8, false, true  },
+};
+
+const si5351_chip_t *si5351_chip_find(const char *name) {
+    for (unsigned i = 0; i < SI5351_CHIP_COUNT; i++) {
+        if (!strcasecmp(name, si5351_chips[i].name)) return &si5351_chips[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file    si5351_chip.h
+ * @brief   Si5351 派生品（A-3/A-20/B/C）のチップ記述子とレジスタ配置
+ * @date    2025-11-06
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SI5351_CHIP_H
+#define SI5351_CHIP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SI5351_MAX_OUT          8
+#define SI5351_MS_FULL_MAX      6       // MS0..MS5 は 8 バイト形式、MS6/MS7 は 1 バイト形式
+
+// ===== レジスタ配置（AN619）=====
+#define SI5351_REG_CLK0_CTRL    0x10    // CLKx_CTRL = 0x10 + x
+#define SI5351_REG_DIS_STATE    0x18    // CLK3..0（0x19 が CLK7..4）, 2bit/ch
+#define SI5351_REG_MS0_BASE     0x2A    // MSx = 0x2A + 8x（x<6）
+#define SI5351_REG_MS6_P1       0x5A    // MS6/MS7 の分周比（偶数整数 6..254）
+#define SI5351_REG_R67_DIV      0x5C    // R6_DIV=bit2:0, R7_DIV=bit6:4
+#define SI5351_REG_PLL_SRC      0x0F    // PLLA_SRC=bit2, PLLB_SRC=bit3, CLKIN_DIV=bit7:6
+
+#define SI5351_MS67_MIN         6
+#define SI5351_MS67_MAX         254
+
+typedef struct {
+    const char *name;
+    uint8_t     n_out;      // 出力数
+    bool        has_vcxo;   // Si5351B: PLLB は VCXO 専用
+    bool        has_clkin;  // Si5351C: CLKIN 入力あり
+} si5351_chip_t;
+
+typedef enum {
+    SI5351_CHIP_A3 = 0,     // Si5351A-B-GT（MSOP-10, 3 出力）
+    SI5351_CHIP_A8,         // Si5351A-B-GM（QFN-20, 8 出力）
+    SI5351_CHIP_B,          // Si5351B（8 出力, VCXO）
+    SI5351_CHIP_C,          // Si5351C（8 出力, CLKIN）
+    SI5351_CHIP_COUNT
+} si5351_chip_id_t;
+
+extern const si5351_chip_t si5351_chips[SI5351_CHIP_COUNT];
+
+/** 名前（"a3","a8","b","c"）から記述子を探す。見つからなければ NULL */
+const si5351_chip_t *si5351_chip_find(const char *name);
+
+static inline uint8_t si5351_reg_clk_ctrl(unsigned ch) { return (uint8_t)(SI5351_REG_CLK0_CTRL + ch); }
+static inline bool    si5351_ms_is_compact(unsigned ch) { return ch >= SI5351_MS_FULL_MAX; }
+static inline uint8_t si5351_reg_ms_base(unsigned ch) {
+    return si5351_ms_is_compact(ch) ? (uint8_t)(SI5351_REG_MS6_P1 + ch - SI5351_MS_FULL_MAX)
+                                    : (uint8_t)(SI5351_REG_MS0_BASE + 8 * ch);
+}
+static inline uint8_t si5351_reg_dis_state(unsigned ch) { return (uint8_t)(SI5351_REG_DIS_STATE + ch / 4); }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_CHIP_H
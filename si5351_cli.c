@@ -1,167 +1,153 @@
 /**
  * @file    si5351_cli.c
- * @brief   Si5351A CLI (USBシリアル制御, CLK0~2独立制御, 診断コマンド追加版)
- * @date    2025-11-03
- * @version 2.0
+ * @brief   Si5351A CLI (USBシリアル制御, コマンド解析 → 操作リング投入)
+ * @date    2025-11-06
+ * @version 3.0
+ *
+ * このファイルは文字列を解析して si5351_op_t を組み立てるだけで、I2C には触れない。
+ * レジスタ書込みは si5351_engine.c が操作リングから取り出して実行する。
  */
 
 #include "si5351_cli.h"
+#include "pico/stdlib.h"
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include "i2c_comm.h"
 #include "serial_comm.h"
-
-// ===== 内部状態 =====
-static i2c_inst_t *g_i2c = NULL;
-static uint8_t g_addr = 0x60;   // AE-Si5351A 固定（7-bit）
-
-// ===== レジスタ定義 =====
-#define XTAL_FREQ                 25000000UL
-#define PLLA_FREQ                 800000000UL
-#define REG_STAT0                 0x00   // SYS_INIT/LOL_A/LOL_B/LOS 等
-#define REG_OE                    0x03
-#define REG_CLK0_CTRL             0x10
-#define REG_CLK1_CTRL             0x11
-#define REG_CLK2_CTRL             0x12
-#define REG_MS0_BASE              0x2A   // 0x2A..0x31
-#define REG_MS1_BASE              0x34
-#define REG_MS2_BASE              0x3E
-#define REG_CRYSTAL_LOAD          0xB7
-#define REG_PLLA_BASE             0x1A   // 0x1A..0x21
-#define REG_PLL_RESET             0xB1
-
-static const uint8_t k_clk_ctrl[3] = { REG_CLK0_CTRL, REG_CLK1_CTRL, REG_CLK2_CTRL };
-static const uint8_t k_ms_base [3] = { REG_MS0_BASE , REG_MS1_BASE , REG_MS2_BASE  };
-
-// ===== ラッパ =====
-static inline int wr8(uint8_t reg, uint8_t v) {
-    int rc = i2c_write(g_i2c, g_addr, reg, &v, 1);
-    if (rc != 0) serial_printf("[I2C] WR FAIL reg=0x%02X val=0x%02X", 1, reg, v);
-    return rc;
-}
-static inline int rd8(uint8_t reg, uint8_t *v) {
-    int rc = i2c_read(g_i2c, g_addr, reg, v, 1);
-    if (rc != 0) serial_printf("[I2C] RD FAIL reg=0x%02X", 1, reg);
-    return rc;
-}
-
-// ===== 内部ユーティリティ =====
-static void set_ms_intdiv(uint8_t ms_base, uint16_t div) {
-    // 整数分周: a=div, b=0, c=1 → P1=128a-512, P2=0, P3=1
-    if (div < 4) div = 4;
-    uint32_t a = div, b = 0, c = 1;
-    uint32_t P1 = 128*a - 512, P2 = 0, P3 = 1;
-    uint8_t d[8] = {
-        (P3>>8)&0xFF, (uint8_t)(P3&0xFF),
-        (uint8_t)((P1>>16)&0x03), (uint8_t)((P1>>8)&0xFF), (uint8_t)(P1&0xFF),
-        (uint8_t)(((P3>>12)&0xF0)|((P2>>16)&0x0F)),
-        (uint8_t)((P2>>8)&0xFF), (uint8_t)(P2&0xFF)
-    };
-    int rc = i2c_write(g_i2c, g_addr, ms_base, d, 8);
-    if (rc != 0) serial_printf("[I2C] WR FAIL MS@0x%02X (div=%u)", 1, ms_base, div);
-}
-
-static void clk_ctrl_set(uint8_t reg_clk_ctrl, uint8_t val) {
-    // 0x4F: Power ON / PLLA / integer / 非反転 / 8mA
-    (void)wr8(reg_clk_ctrl, val);
-}
-
-static void oe_mask_all(uint8_t mask) {
-    // mask=0xFF 全OFF, mask=0xFE CLK0のみON, etc.
-    (void)wr8(REG_OE, mask);
-}
+#include "si5351_engine.h"
+#include "si5351_plan.h"
+#include "si5351_chip.h"
+#include "si5351_mem.h"
+#include "si5351_edit.h"
+#include "si5351_macro.h"
+#include "si5351_wdt.h"
+#include "si5351_boot.h"
+#include "si5351_trace.h"
+#include "si5351_sna.h"
+#include "si5351_fm.h"
+
+// ===== 入力行（アリーナ上）=====
+static char *g_line;
+static int   g_mem_line = -1;
 
 // ===== 初期化 =====
 void si5351_cli_init(i2c_inst_t *port, uint8_t addr) {
-    g_i2c = port;
-    g_addr = addr & 0x7F;
-    serial_printf("[CLI] I2C addr=0x%02X", 1, g_addr);
-}
-
-static void si5351_init_basic(void) {
-    // 1) まず全出力OFF（OE全閉）
-    oe_mask_all(0xFF);
-
-    // 2) 水晶負荷キャパシタ（8 pF）
-    wr8(REG_CRYSTAL_LOAD, 0b10000000); //wr8(REG_CRYSTAL_LOAD, 0b11000000);
-
-    // 3) PLLA=800MHz (整数: a=32)
-    {
-        uint32_t a=32,b=0,c=1;
-        uint32_t P1=128*a-512, P2=0, P3=1;
-        uint8_t d[8]={(P3>>8)&0xFF,(uint8_t)(P3&0xFF),
-                      (uint8_t)((P1>>16)&0x03),(uint8_t)((P1>>8)&0xFF),(uint8_t)(P1&0xFF),
-                      (uint8_t)(((P3>>12)&0xF0)|((P2>>16)&0x0F)),
-                      (uint8_t)((P2>>8)&0xFF),(uint8_t)(P2&0xFF)};
-        int rc = i2c_write(g_i2c, g_addr, REG_PLLA_BASE, d, 8);
-        if (rc != 0) serial_printf("[I2C] WR FAIL PLLA", 1);
-        wr8(REG_PLL_RESET, 0xA0); // PLLA/Bリセット
-    }
-
-    // 4) CLK0=100MHz → 800/8
-    set_ms_intdiv(REG_MS0_BASE, 8);
-    clk_ctrl_set(REG_CLK0_CTRL, 0x4F); // Power ON / PLLA / integer
-
-    // 5) CLK1/2は停止構成にしておく
-    clk_ctrl_set(REG_CLK1_CTRL, 0x8F); // bit7=1(PD)
-    clk_ctrl_set(REG_CLK2_CTRL, 0x8F);
-
-    // 6) CLK0のみ出力ON
-    oe_mask_all(0xFE); // bit0=0 → CLK0有効
-
-    serial_printf("Si5351A initialized (PLLA=800 MHz, CLK0=100 MHz, CLK1/2 off)", 1);
+    // エンジンはアリーナの残りを掃引列に回すので、行バッファと履歴を先に取る
+    g_line = si5351_mem_alloc("line", SI5351_LINE_LEN, &g_mem_line);
+    (void)si5351_edit_init(g_line, SI5351_LINE_LEN, si5351_cli_command);
+    if (si5351_macro_init() < 0) serial_printf("[MACRO] arena too small, macros disabled",1);
+    si5351_engine_init(port, addr);
 }
 
-// ===== 周波数設定（整数） =====
-static void si5351_set_freq_ch(unsigned ch, unsigned freq_mhz) {
-    if (ch > 2) { serial_printf("ERR: ch=%u (use 0..2)", 1, ch); return; }
+char *si5351_cli_line(void) {
+    return g_line;
+}
 
-    if (freq_mhz == 0) {
-        // 停止：OEビットを立てる
-        uint8_t oe=0xFF; rd8(REG_OE,&oe);
-        oe |= (1u<<ch); wr8(REG_OE, oe);
-        serial_printf("CLK%u disabled", 1, ch);
+// ===== 操作投入 =====
+// at <us> <command> の解析中は、組み立てた操作を即時実行ではなく予約として投入する
+static bool     g_at_active;
+static uint64_t g_at_us;
+static unsigned g_at_ops;
+
+// macro define の間は投入せずにマクロへ積む
+static void submit_op(const si5351_op_t *op) {
+    if (si5351_macro_recording()) {
+        int rc = si5351_macro_put(op);
+        if (rc == -1) serial_printf("ERR: macro full (%u ops)",1,(unsigned)SI5351_MACRO_OPS);
+        else if (rc < 0) serial_printf("ERR: op %u cannot be recorded",1,op->code);
         return;
     }
+    if (g_at_active) { si5351_engine_submit_at(g_at_us, op); g_at_ops++; }
+    else si5351_engine_submit_wait(op);
+}
 
-    unsigned long freq_hz = (unsigned long)freq_mhz * 1000000UL;
-    if (freq_hz > 150000000UL) { serial_printf("Freq too high (<150 MHz)", 1); return; }
-
-    // 分周器（整数）
-    double divf = (double)PLLA_FREQ / (double)freq_hz;
-    unsigned div = (unsigned)(divf + 0.5);
-    if (div < 4) div = 4;
-
-    set_ms_intdiv(k_ms_base[ch], (uint16_t)div);
-
-    // CLKコントロール: 電源ON/PLLA/整数/非反転/8mA
-    clk_ctrl_set(k_clk_ctrl[ch], 0x4F);
+static void submit(uint8_t code, uint8_t ch, uint8_t b0, uint8_t b1, uint32_t v) {
+    si5351_op_t op = { .code = code, .ch = ch, .b0 = b0, .b1 = b1 };
+    op.v.u = v;
+    submit_op(&op);
+}
 
-    // OEで ch を有効化
-    uint8_t oe=0xFF; rd8(REG_OE,&oe);
-    oe &= ~(1u<<ch); wr8(REG_OE, oe);
+static void cmd_queue_show(void) {
+    si5351_engine_stats_t st;
+    si5351_engine_get_stats(&st);
+    serial_printf("op ring: depth=%lu/%lu hwm=%lu pushed=%lu done=%lu", 1,
+                  (unsigned long)st.depth, (unsigned long)st.capacity, (unsigned long)st.hwm,
+                  (unsigned long)st.pushed, (unsigned long)st.popped);
+    serial_printf("backpressure: full=%lu stall=%lu us dropped=%lu", 1,
+                  (unsigned long)st.full_events, (unsigned long)st.stall_us, (unsigned long)st.dropped);
+}
 
-    serial_printf("CLK%u = %u MHz (div=%u)", 1, ch, freq_mhz, div);
+// アリーナの領域ごとの確保量・使用量・最大値
+static void cmd_mem_show(void) {
+    si5351_engine_mem_sync();
+    uint32_t fixed = 0;
+    serial_printf("arena: %lu B, allocated %lu B", 1, (unsigned long)SI5351_ARENA_BYTES,
+                  (unsigned long)si5351_mem_allocated());
+    serial_printf("  %-13s %8s %8s %8s", 1, "region", "size", "used", "hwm");
+    for (unsigned i = 0; i < si5351_mem_count(); i++) {
+        const si5351_mem_region_t *r = si5351_mem_region(i);
+        serial_printf("  %-13s %8lu %8lu %8lu", 1, r->name, (unsigned long)r->size,
+                      (unsigned long)r->used, (unsigned long)r->hwm);
+        if (strcmp(r->name, "seq")) fixed += r->size;
+    }
+    serial_printf("fixed %lu B; everything else goes to seq (raise SI5351_ARENA_BYTES for longer sweeps)", 1,
+                  (unsigned long)fixed);
 }
 
 // ===== ヘルプ =====
 static void cmd_help(void){
+    const si5351_chip_t *chip = si5351_engine_chip();
     serial_printf("",1);
     serial_printf("==================  HELP MENU (Si5351A)  ==================",1);
     serial_printf(" help / h / H / ?           : show this help",1);
-    serial_printf(" scan                       : I2C scan (quiet)",1);
-    serial_printf(" status                     : show STAT0/OE/CLK0_CTRL",1);
+    serial_printf(" scan                       : I2C scan (strict, 0x03..0x77)",1);
+    serial_printf(" ping                       : check ACK from the Si5351 address",1);
+    serial_printf(" status                     : show boot state, STAT0/OE/CLK0_CTRL",1);
     serial_printf(" peek <hexReg>              : read  1 byte from reg",1);
     serial_printf(" poke <hexReg> <hexVal>     : write 1 byte to reg",1);
     serial_printf(" init                       : re-init (PLLA=800MHz, CLK0=100MHz)",1);
     serial_printf(" force_on                   : OE/CLK0 を強制有効化",1);
     serial_printf(" freq=<MHz>                 : set CLK0 (compat)",1);
-    serial_printf(" clk <ch> <MHz>             : set CLKch (MHz=0 disables)",1);
-    serial_printf(" clk0=<MHz> / clk1=<MHz> / clk2=<MHz>",1);
-    serial_printf(" ch0=<MHz>  / ch1=<MHz>  / ch2=<MHz>",1);
+    serial_printf(" clk <ch> <MHz>             : set CLKch (MHz=0 disables, 小数可)",1);
+    serial_printf(" plan                       : show PLL/MS plan",1);
+    serial_printf(" plan explain <ch>          : show runner-up candidates",1);
+    serial_printf(" plan budget <us>           : solver time budget per channel",1);
+    serial_printf(" fine <ch> <offset_Hz>      : PLL-only fine tune (MS fixed, no reset)",1);
+    serial_printf(" drive <ch> <2|4|6|8>       : output drive strength (mA)",1);
+    serial_printf(" invert <ch> on|off         : invert output",1);
+    serial_printf(" idle <ch> low|high|hiz|never : state while OE disabled",1);
+    serial_printf(" cfg                        : show per-channel output config",1);
+    serial_printf(" power [auto|oe]            : power policy / current estimate",1);
+    serial_printf(" chip [a3|a8|b|c]           : select Si5351 variant (outputs/VCXO/CLKIN)",1);
+    serial_printf(" ref [xtal | clkin <Hz>]    : PLL reference source (CLKIN: Si5351C)",1);
+    serial_printf(" bench cf [n]               : CF solver cost (random vs 1Hz steps)",1);
+    serial_printf(" bench isr [n]              : IRQ entry / commit latency, warm vs cold XIP",1);
+    serial_printf(" queue                      : parser->engine op ring stats",1);
+    serial_printf(" mem                        : RAM arena usage and high-water marks",1);
+    serial_printf(" at <us|+us> <command>      : run command at time (us since boot)",1);
+    serial_printf(" at / at clear              : list / cancel scheduled commands",1);
+    serial_printf(" trig <ch> <MHz> [MHz ...]  : preload list stepped by GPIO edge (trig add ...)",1);
+    serial_printf(" trig arm <gpio> [rise|fall] / trig off / trig : arm, disarm, latency stats",1);
+    serial_printf(" dma sweep <ch> <MHz> <MHz> <points> [steps/s] : chained-DMA sweep (0 CPU/step)",1);
+    serial_printf(" dma play [steps/s] / dma stop / dma bench / dma : replay, abort, bus rates, status",1);
+    serial_printf(" hop <ch> <MHz>             : retune via the idle PLL (PLLA/PLLB ping-pong)",1);
+    serial_printf(" hop prep <ch> <MHz> / hop go / hop : lock idle PLL ahead, switch, hop log",1);
+    serial_printf(" track <m> <s> <offset_Hz>  : CLKs follows CLKm + offset (solved & written together)",1);
+    serial_printf(" track off [<s>] / track    : remove tracking / list relations",1);
+    serial_printf(" sna <MHz> <MHz> <points> [samples] [settle_us] : CLK0 sweep + ADC detector, binary out",1);
+    serial_printf(" sna sim <MHz> <kHz> [order] / sna sim off / sna stop / sna : simulated filter, abort, status",1);
+    serial_printf(" fm <ch> <MHz> <dev_kHz> [updates/s] : FM from ADC0 via MS P2 (0/omit = max rate)",1);
+    serial_printf(" fm pm <ch> <MHz> <peak_rad> [updates/s] / fm stop / fm : PM, end + report, status",1);
+    serial_printf(" fm sim <tone_Hz> [level_%%] / fm sim off : synthetic modulation instead of ADC",1);
+    serial_printf(" macro define <name> ... end : record commands as ops (flash)",1);
+    serial_printf(" run <name> / macro [list|show|delete] : replay, manage ('autorun' runs at boot)",1);
+    serial_printf(" wdt [<ms>|off|hang]        : watchdog, snapshot/restore report, last ops before reset",1);
+    serial_printf(" trace on|off|clear / trace : record I2C transactions, utilisation, per-command",1);
+    serial_printf(" trace dump|csv|bin [n]     : last n transactions as table / CSV / binary",1);
+    serial_printf(" clk0=<MHz> / clk1=<MHz> / ... / clk%u=<MHz>",1,chip->n_out-1u);
+    serial_printf(" ch0=<MHz>  / ch1=<MHz>  / ... / ch%u=<MHz>",1,chip->n_out-1u);
     serial_printf("==========================================================",1);
     serial_printf("",1);
 }
@@ -169,121 +155,553 @@ static void cmd_help(void){
 // ===== 文字列ヘルパ =====
 static void to_lower_inplace(char *s){ for(char*p=s;*p;++p)*p=(char)tolower(*p); }
 static void replace_char(char *s, char from, char to){ for(char*p=s;*p;++p) if(*p==from)*p=to; }
+static uint32_t mhz_to_hz(const char *s){ double v=strtod(s,NULL); return (v<=0.0)?0U:(uint32_t)(v*1e6+0.5); }
+
+// 末尾が数字だけのチャネル付きキー（clk1, ch2, freq0, cll1）なら ch を返す
+static int key_channel(const char *key) {
+    static const char *const prefix[] = { "freq", "clk", "cll", "ch" };   // cll: typo tolerant
+    for (unsigned i = 0; i < sizeof(prefix) / sizeof(prefix[0]); i++) {
+        size_t n = strlen(prefix[i]);
+        if (strncmp(key, prefix[i], n) || !isdigit((unsigned char)key[n])) continue;
+        char *end;
+        unsigned long ch = strtoul(key + n, &end, 10);
+        if (*end == '\0' && ch < SI5351_MAX_OUT) return (int)ch;
+    }
+    return -1;
+}
 
-// ===== CLIハンドラ =====
-void si5351_cli_handle(const char *cmd){
-    if(!cmd || !*cmd) return;
+// ===== コマンド処理（key 以降の引数は strtok(NULL, ...) で取る）=====
+static void cmd_help_k(const char *key){ (void)key; cmd_help(); }
+static void cmd_queue_k(const char *key){ (void)key; cmd_queue_show(); }
+static void cmd_mem_k(const char *key){ (void)key; cmd_mem_show(); }
+
+// at <us_since_boot | +us> <command> / at / at clear
+static void cmd_at(const char *key){
+    char*ts=strtok(NULL," \t\r\n");
+    if(!ts){ submit(SI5351_OP_AT_LIST,0,0,0,0); return; }
+    if(!strcmp(ts,"clear")){ submit(SI5351_OP_AT_CLEAR,0,0,0,0); return; }
+    char*rest=strtok(NULL,"");
+    if(si5351_macro_recording()){ serial_printf("ERR: at cannot be recorded in a macro",1); return; }
+    if(g_at_active || !rest){ serial_printf("usage: at <us_since_boot|+us> <command>",1); return; }
+    uint64_t t=strtoull(ts+(ts[0]=='+'),NULL,10);
+    if(ts[0]=='+') t+=time_us_64();
+    if(t>=(1ULL<<48)){ serial_printf("ERR: time out of range",1); return; }
+    g_at_active=true; g_at_us=t; g_at_ops=0;
+    si5351_cli_handle(rest);
+    g_at_active=false;
+    if(!g_at_ops) serial_printf("at: nothing scheduled",1);
+}
 
-    char buf[128];
-    strncpy(buf,cmd,sizeof(buf)); buf[sizeof(buf)-1]='\0';
-    replace_char(buf,'=',' ');
+// trig <ch> <MHz>... / trig add <MHz>... / trig arm <gpio> [rise|fall] / trig off
+static void cmd_trig(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ submit(SI5351_OP_TRIG_SHOW,0,0,0,0); return; }
+    to_lower_inplace(a);
+    if(!strcmp(a,"off")){ submit(SI5351_OP_TRIG_OFF,0,0,0,0); return; }
+    if(!strcmp(a,"arm")){
+        char*pin=strtok(NULL," \t\r\n");
+        char*e=strtok(NULL," \t\r\n");
+        if(!pin || (e && strcmp(e,"rise") && strcmp(e,"fall"))){ serial_printf("usage: trig arm <gpio> [rise|fall]",1); return; }
+        submit(SI5351_OP_TRIG_ARM,0,(uint8_t)atoi(pin),(e && !strcmp(e,"fall")) ? 1 : 0,0);
+        return;
+    }
+    bool add=!strcmp(a,"add");
+    if(!add && !isdigit((unsigned char)a[0])){ serial_printf("usage: trig <ch> <MHz> [MHz ...] | add <MHz> ... | arm <gpio> [rise|fall] | off",1); return; }
+    uint8_t ch=add ? 0 : (uint8_t)atoi(a);
+    unsigned n=0;
+    for(char*f; (f=strtok(NULL," \t\r\n"))!=NULL; n++)
+        submit(SI5351_OP_TRIG_LOAD,ch,(!add && n==0) ? 1 : 0,0,mhz_to_hz(f));
+    if(n==0) serial_printf("usage: trig <ch> <MHz> [MHz ...]",1);
+}
 
-    char *tok = strtok(buf," \t\r\n");
-    if(!tok) return;
+// dma sweep <ch> <start> <stop> <points> [rate] / dma play [rate] / dma stop / dma bench
+static void cmd_dma(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ submit(SI5351_OP_DMA_SHOW,0,0,0,0); return; }
+    to_lower_inplace(a);
+    // stop は再生中（エンジンが後続操作を待たせている間）にも効くようリングを経由しない
+    if(!strcmp(a,"stop")) { si5351_engine_dma_stop(); return; }
+    if(!strcmp(a,"bench")){ submit(SI5351_OP_DMA_BENCH,0,0,0,0); return; }
+    if(!strcmp(a,"play")){
+        char*r=strtok(NULL," \t\r\n");
+        submit(SI5351_OP_DMA_PLAY,0,r ? 0 : SI5351_OP_ARG_NONE,0,r ? (uint32_t)strtoul(r,NULL,10) : 0);
+        return;
+    }
+    char*cs=strtok(NULL," \t\r\n");
+    char*f0=strtok(NULL," \t\r\n");
+    char*f1=strtok(NULL," \t\r\n");
+    char*np=strtok(NULL," \t\r\n");
+    char*r=strtok(NULL," \t\r\n");
+    if(strcmp(a,"sweep") || !cs || !f0 || !f1 || !np){
+        serial_printf("usage: dma sweep <ch> <startMHz> <stopMHz> <points> [steps/s] | play [steps/s] | stop | bench",1);
+        return;
+    }
+    submit(SI5351_OP_DMA_PARAM,0,SI5351_DMA_P_STOP_HZ,0,mhz_to_hz(f1));
+    submit(SI5351_OP_DMA_PARAM,0,SI5351_DMA_P_POINTS,0,(uint32_t)strtoul(np,NULL,10));
+    submit(SI5351_OP_DMA_PARAM,0,SI5351_DMA_P_RATE_HZ,0,r ? (uint32_t)strtoul(r,NULL,10) : 0);
+    submit(SI5351_OP_DMA_SWEEP,(uint8_t)atoi(cs),0,0,mhz_to_hz(f0));
+}
 
-    char key[32]; strncpy(key,tok,sizeof(key)); key[sizeof(key)-1]='\0';
-    to_lower_inplace(key);
+// 引数なしの操作
+static void cmd_scan(const char *key)    { (void)key; submit(SI5351_OP_SCAN,0,0,0,0); }
+static void cmd_ping(const char *key)    { (void)key; submit(SI5351_OP_PING,0,0,0,0); }
+static void cmd_status(const char *key)  {
+    (void)key;
+    si5351_boot_show();
+    if(si5351_boot_state()==SI5351_BOOT_READY) submit(SI5351_OP_STATUS,0,0,0,0);
+}
+static void cmd_init(const char *key)    { (void)key; submit(SI5351_OP_INIT,0,0,0,0); }
+static void cmd_force_on(const char *key){ (void)key; submit(SI5351_OP_FORCE_ON,0,0,0,0); }
+static void cmd_cfg(const char *key)     { (void)key; submit(SI5351_OP_CFG,0,0,0,0); }
+
+// peek
+static void cmd_peek(const char *key){
+    char*ra=strtok(NULL," \t\r\n");
+    if(!ra){ serial_printf("usage: peek <hexReg>",1); return; }
+    submit(SI5351_OP_PEEK,0,(uint8_t)strtoul(ra,NULL,16),0,0);
+}
+
+// poke
+static void cmd_poke(const char *key){
+    char*ra=strtok(NULL," \t\r\n");
+    char*va=strtok(NULL," \t\r\n");
+    if(!ra||!va){ serial_printf("usage: poke <hexReg> <hexVal>",1); return; }
+    submit(SI5351_OP_POKE,0,(uint8_t)strtoul(ra,NULL,16),(uint8_t)strtoul(va,NULL,16),0);
+}
 
-    // ---- help ----
-    if(!strcmp(key,"help") || !strcmp(key,"h") || !strcmp(key,"?")){
-        cmd_help(); return;
+// oe on/off
+static void cmd_oe(const char *key){
+    char*m=strtok(NULL," \t\r\n");
+    if(m) to_lower_inplace(m);
+    if(!m || (strcmp(m,"on") && strcmp(m,"off"))){ serial_printf("usage: oe on|off",1); return; }
+    submit(SI5351_OP_OE,0,!strcmp(m,"on"),0,0);
+}
+
+// plan / plan explain <ch> / plan budget <us>
+static void cmd_plan(const char *key){
+    char*sub=strtok(NULL," \t\r\n");
+    if(!sub){ submit(SI5351_OP_PLAN_SHOW,0,0,0,0); return; }
+    to_lower_inplace(sub);
+    char*arg=strtok(NULL," \t\r\n");
+    if(!strcmp(sub,"explain")){
+        submit(SI5351_OP_PLAN_EXPLAIN,arg ? (uint8_t)atoi(arg) : 0U,0,0,0);
+    } else if(!strcmp(sub,"budget")){
+        submit(SI5351_OP_PLAN_BUDGET,0,arg ? 0 : SI5351_OP_ARG_NONE,0,
+               arg ? (uint32_t)strtoul(arg,NULL,10) : 0U);
+    } else {
+        serial_printf("usage: plan [explain <ch> | budget <us>]",1);
     }
+}
 
-    // ---- scan ----
-    if(!strcmp(key,"scan")){
-        scan_i2c_quick(g_i2c);
-        return;
+// drive / invert / idle
+static void cmd_out_cfg(const char *key){
+    char*ch=strtok(NULL," \t\r\n");
+    char*v=strtok(NULL," \t\r\n");
+    if(!ch||!v){ serial_printf("usage: %s <ch> <value>",1,key); return; }
+    uint8_t c=(uint8_t)atoi(ch);
+    to_lower_inplace(v);
+    if(!strcmp(key,"drive")){
+        unsigned ma=(unsigned)atoi(v);
+        if(ma!=2&&ma!=4&&ma!=6&&ma!=8){ serial_printf("usage: drive <ch> <2|4|6|8>",1); return; }
+        submit(SI5351_OP_DRIVE,c,(uint8_t)ma,0,0);
+    } else if(!strcmp(key,"invert")){
+        if(strcmp(v,"on")&&strcmp(v,"off")){ serial_printf("usage: invert <ch> on|off",1); return; }
+        submit(SI5351_OP_INVERT,c,!strcmp(v,"on"),0,0);
+    } else {
+        int st=-1;
+        for(int i=0;i<4;i++) if(!strcmp(v,si5351_dis_state_name[i])) st=i;
+        if(st<0){ serial_printf("usage: idle <ch> low|high|hiz|never",1); return; }
+        submit(SI5351_OP_IDLE,c,(uint8_t)st,0,0);
     }
+}
 
-    // ---- status ----
-    if(!strcmp(key,"status")){
-        uint8_t s=0, oe=0, c0=0;
-        rd8(REG_STAT0,&s); rd8(REG_OE,&oe); rd8(REG_CLK0_CTRL,&c0);
-        serial_printf("STAT0=0x%02X  OE=0x%02X  CLK0_CTRL=0x%02X",1,s,oe,c0);
-        // 参考: STAT0 bits: SYS_INIT=bit7, LOL_B=6, LOL_A=5, LOS=4
-        return;
+// chip [a3|a8|b|c]
+static void cmd_chip(const char *key){
+    char*m=strtok(NULL," \t\r\n");
+    uint8_t id=SI5351_OP_ARG_NONE;
+    if(m){
+        const si5351_chip_t *c = si5351_chip_find(m);
+        if(!c){ serial_printf("usage: chip [a3|a8|b|c]",1); return; }
+        id=(uint8_t)(c - si5351_chips);
     }
+    submit(SI5351_OP_CHIP,0,id,0,0);
+}
 
-    // ---- peek ----
-    if(!strcmp(key,"peek")){
-        char*ra=strtok(NULL," \t\r\n");
-        if(!ra){ serial_printf("usage: peek <hexReg>",1); return; }
-        unsigned reg=strtoul(ra,NULL,16);
-        uint8_t v=0xFF;
-        if (i2c_read(g_i2c,g_addr,(uint8_t)reg,&v,1)==0)
-            serial_printf("REG[0x%02X]=0x%02X",1,(unsigned)reg,v);
-        else
-            serial_printf("READ FAIL reg=0x%02X",1,(unsigned)reg);
-        return;
+// ref [xtal | clkin <Hz>]
+static void cmd_ref(const char *key){
+    char*m=strtok(NULL," \t\r\n");
+    if(!m){ submit(SI5351_OP_REF,0,SI5351_OP_ARG_NONE,0,0); return; }
+    to_lower_inplace(m);
+    if(!strcmp(m,"xtal")) submit(SI5351_OP_REF,0,0,0,0);
+    else if(!strcmp(m,"clkin")){
+        char*hz=strtok(NULL," \t\r\n");
+        submit(SI5351_OP_REF,0,1,0,hz ? (uint32_t)strtoul(hz,NULL,10) : 0U);
     }
+    else serial_printf("usage: ref [xtal | clkin <Hz>]",1);
+}
 
-    // ---- poke ----
-    if(!strcmp(key,"poke")){
-        char*ra=strtok(NULL," \t\r\n");
-        char*va=strtok(NULL," \t\r\n");
-        if(!ra||!va){ serial_printf("usage: poke <hexReg> <hexVal>",1); return; }
-        unsigned reg=strtoul(ra,NULL,16);
-        unsigned val=strtoul(va,NULL,16);
-        (void)wr8((uint8_t)reg,(uint8_t)val);
-        return;
+// power [auto|oe]
+static void cmd_power(const char *key){
+    char*m=strtok(NULL," \t\r\n");
+    uint8_t pol=SI5351_OP_ARG_NONE;
+    if(m){
+        to_lower_inplace(m);
+        if(!strcmp(m,"auto"))    pol=SI5351_PWR_AUTO;
+        else if(!strcmp(m,"oe")) pol=SI5351_PWR_OE_ONLY;
+        else { serial_printf("usage: power [auto|oe]",1); return; }
     }
+    submit(SI5351_OP_POWER,0,pol,0,0);
+}
+
+// fine <ch> <offset_Hz>
+static void cmd_fine(const char *key){
+    char*ch=strtok(NULL," \t\r\n");
+    char*off=strtok(NULL," \t\r\n");
+    if(!ch||!off){ serial_printf("usage: fine <ch> <offset_Hz>",1); return; }
+    double hz=strtod(off,NULL);
+    if(hz>2e6||hz<-2e6){ serial_printf("ERR: offset out of range (|offset| <= 2 MHz)",1); return; }
+    si5351_op_t op = { .code = SI5351_OP_FINE, .ch = (uint8_t)atoi(ch) };
+    op.v.i = (int32_t)(hz*1000.0 + (hz<0 ? -0.5 : 0.5));   // mHz
+    submit_op(&op);
+}
 
-    // ---- init ----
-    if(!strcmp(key,"init")){
-        si5351_init_basic();
+// bench cf [n] / bench isr [n]
+static void cmd_bench(const char *key){
+    char*sub=strtok(NULL," \t\r\n");
+    char*arg=strtok(NULL," \t\r\n");
+    bool isr = sub && !strcmp(sub,"isr");
+    if(!sub||(strcmp(sub,"cf")&&!isr)){ serial_printf("usage: bench cf [n] | bench isr [n]",1); return; }
+    uint32_t n = arg ? (uint32_t)strtoul(arg,NULL,10) : (isr ? 100U : 1000U);
+    if(n==0) n=1;
+    submit(isr ? SI5351_OP_BENCH_ISR : SI5351_OP_BENCH_CF,0,0,0,n);
+}
+
+// wdt: エンジンを止めて再起動・復元を確かめる（ウォッチドッグが止めるまで戻らない）
+static void wdt_hang(void){ for(;;) tight_loop_contents(); }
+
+// wdt / wdt <ms> / wdt off / wdt hang
+static void cmd_wdt(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ si5351_wdt_show(); si5351_engine_restore_show(); return; }
+    if(!strcmp(a,"hang")){
+        if(!si5351_wdt_timeout_ms()){ serial_printf("ERR: watchdog is off",1); return; }
+        serial_printf("wdt: engine stalled, reset in %lu ms",1,(unsigned long)si5351_wdt_timeout_ms());
+        si5351_engine_call(wdt_hang);
         return;
     }
+    bool off=!strcmp(a,"off");
+    if(!off && !isdigit((unsigned char)a[0])){ serial_printf("usage: wdt [<ms> | off | hang]",1); return; }
+    uint32_t ms=off ? 0U : (uint32_t)strtoul(a,NULL,10);
+    if(ms && ms<100){ serial_printf("ERR: timeout must be >= 100 ms",1); return; }
+    si5351_wdt_start(ms);
+    if(si5351_wdt_timeout_ms()) serial_printf("wdt: timeout %lu ms",1,(unsigned long)si5351_wdt_timeout_ms());
+    else serial_printf("wdt: off",1);
+}
+
+// trace [on|off|clear] / trace dump|csv|bin [n]
+static void cmd_trace(const char *key){
+    static const char *const k_sub[]={ "", "on", "off", "clear", "dump", "csv", "bin" };
+    char*a=strtok(NULL," \t\r\n");
+    char*n=strtok(NULL," \t\r\n");
+    uint8_t sub=SI5351_TR_SHOW;
+    if(a){
+        to_lower_inplace(a);
+        for(sub=SI5351_TR_ON; sub<=SI5351_TR_BIN && strcmp(a,k_sub[sub]); sub++) ;
+        if(sub>SI5351_TR_BIN){ serial_printf("usage: trace [on|off|clear] | trace dump|csv|bin [n]",1); return; }
+    }
+    submit(SI5351_OP_TRACE,0,sub,0,n ? (uint32_t)strtoul(n,NULL,10) : 0);
+}
+
+// hop <ch> <MHz> / hop prep <ch> <MHz> / hop go / hop
+static void cmd_hop(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ submit(SI5351_OP_HOP_SHOW,0,0,0,0); return; }
+    to_lower_inplace(a);
+    if(!strcmp(a,"go")){ submit(SI5351_OP_HOP_GO,0,0,0,0); return; }
+    bool prep=!strcmp(a,"prep");
+    char*ch=prep ? strtok(NULL," \t\r\n") : a;
+    char*mhz=strtok(NULL," \t\r\n");
+    if(!ch||!mhz||!isdigit((unsigned char)ch[0])){ serial_printf("usage: hop <ch> <MHz> | hop prep <ch> <MHz> | hop go | hop",1); return; }
+    uint32_t hz=mhz_to_hz(mhz);
+    if(!hz){ serial_printf("ERR: hop needs a frequency > 0",1); return; }
+    submit(SI5351_OP_HOP_PREP,(uint8_t)atoi(ch),0,0,hz);
+    if(!prep) submit(SI5351_OP_HOP_GO,0,0,0,0);
+}
 
-    // ---- force_on（強制有効化）----
-    if(!strcmp(key,"force_on")){
-        // 1) 全閉 → 2) CLK0だけ開 → 3) CLK0_CTRL=0x4F
-        oe_mask_all(0xFF);
-        oe_mask_all(0xFE);
-        clk_ctrl_set(REG_CLK0_CTRL, 0x4F);
-        // 読みバック
-        uint8_t oe=0, c0=0; rd8(REG_OE,&oe); rd8(REG_CLK0_CTRL,&c0);
-        serial_printf("FORCE: OE=0x%02X CLK0_CTRL=0x%02X",1,oe,c0);
+// track <master> <slave> <offset_Hz> / track off [<slave>] / track
+static void cmd_track(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ submit(SI5351_OP_TRACK_SHOW,0,0,0,0); return; }
+    to_lower_inplace(a);
+    if(!strcmp(a,"off")){
+        char*sl=strtok(NULL," \t\r\n");
+        submit(SI5351_OP_TRACK,sl ? (uint8_t)atoi(sl) : SI5351_OP_ARG_NONE,SI5351_OP_ARG_NONE,0,0);
         return;
     }
+    char*sl=strtok(NULL," \t\r\n");
+    char*off=strtok(NULL," \t\r\n");
+    if(!sl||!off||!isdigit((unsigned char)a[0])||!isdigit((unsigned char)sl[0])){
+        serial_printf("usage: track <master_ch> <slave_ch> <offset_Hz> | track off [<slave_ch>] | track",1);
+        return;
+    }
+    double hz=strtod(off,NULL);
+    if(hz>2e8||hz<-2e8){ serial_printf("ERR: offset out of range (|offset| <= 200 MHz)",1); return; }
+    si5351_op_t op = { .code = SI5351_OP_TRACK, .ch = (uint8_t)atoi(sl), .b0 = (uint8_t)atoi(a) };
+    op.v.i = (int32_t)(hz + (hz<0 ? -0.5 : 0.5));
+    submit_op(&op);
+}
 
-    // ---- oe on/off ----
-    if(!strcmp(key,"oe")){
-        char*m=strtok(NULL," \t\r\n");
-        if(!m){ serial_printf("usage: oe on|off",1); return; }
-        to_lower_inplace(m);
-        if(!strcmp(m,"on"))  { oe_mask_all(0x00); serial_printf("OE: ON (all enabled)",1); }
-        else if(!strcmp(m,"off")) { oe_mask_all(0xFF); serial_printf("OE: OFF (all disabled)",1); }
-        else serial_printf("usage: oe on|off",1);
+// sna <start> <stop> <points> [samples] [settle_us] / sna sim <MHz> <kHz> [order] / sna sim off / sna stop / sna
+static void cmd_sna(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ submit(SI5351_OP_SNA_SHOW,0,0,0,0); return; }
+    to_lower_inplace(a);
+    // stop は掃引中にも効くようリングを経由しない
+    if(!strcmp(a,"stop")) { si5351_engine_sna_stop(); return; }
+    if(!strcmp(a,"sim")){
+        char*f=strtok(NULL," \t\r\n");
+        char*bw=strtok(NULL," \t\r\n");
+        char*o=strtok(NULL," \t\r\n");
+        if(f) to_lower_inplace(f);
+        if(f && !strcmp(f,"off")){ submit(SI5351_OP_SNA_SIM,0,0,0,0); return; }
+        if(!f||!bw){ serial_printf("usage: sna sim <centerMHz> <bw_kHz> [order] | sna sim off",1); return; }
+        int n=o ? atoi(o) : 2;
+        if(n<1||n>10){ serial_printf("ERR: order 1..10",1); return; }
+        submit(SI5351_OP_SNA_PARAM,0,SI5351_SNA_P_SIM_BW_HZ,0,(uint32_t)(strtod(bw,NULL)*1e3+0.5));
+        submit(SI5351_OP_SNA_SIM,0,(uint8_t)n,0,mhz_to_hz(f));
+        return;
+    }
+    char*f1=strtok(NULL," \t\r\n");
+    char*np=strtok(NULL," \t\r\n");
+    char*ns=strtok(NULL," \t\r\n");
+    char*st=strtok(NULL," \t\r\n");
+    if(!f1||!np){
+        serial_printf("usage: sna <startMHz> <stopMHz> <points> [samples] [settle_us] | sim ... | stop",1);
         return;
     }
+    submit(SI5351_OP_SNA_PARAM,0,SI5351_SNA_P_STOP_HZ,0,mhz_to_hz(f1));
+    submit(SI5351_OP_SNA_PARAM,0,SI5351_SNA_P_POINTS,0,(uint32_t)strtoul(np,NULL,10));
+    submit(SI5351_OP_SNA_PARAM,0,SI5351_SNA_P_SAMPLES,0,ns ? (uint32_t)strtoul(ns,NULL,10) : SI5351_SNA_SAMPLES_DEF);
+    submit(SI5351_OP_SNA_PARAM,0,SI5351_SNA_P_SETTLE_US,0,st ? (uint32_t)strtoul(st,NULL,10) : SI5351_SNA_SETTLE_DEF);
+    submit(SI5351_OP_SNA,0,0,0,mhz_to_hz(a));
+}
 
-    // ---- freq（互換）: freq <MHz> → CLK0 ----
-    if(!strcmp(key,"freq")){
-        char*p=strtok(NULL," \t\r\n");
-        if(!p){ serial_printf("usage: freq <MHz>",1); return; }
-        si5351_set_freq_ch(0,(unsigned)atoi(p));
+// fm <ch> <MHz> <dev_kHz> [rate] / fm pm <ch> <MHz> <peak_rad> [rate] / fm sim <Hz> [level%] / fm sim off / fm stop / fm
+static void cmd_fm(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    if(!a){ submit(SI5351_OP_FM_SHOW,0,0,0,0); return; }
+    to_lower_inplace(a);
+    // stop は変調中にも効くようリングを経由しない
+    if(!strcmp(a,"stop")) { si5351_engine_fm_stop(); return; }
+    if(!strcmp(a,"sim")){
+        char*t=strtok(NULL," \t\r\n");
+        char*l=strtok(NULL," \t\r\n");
+        if(!t){ serial_printf("usage: fm sim <tone_Hz> [level_%%] | fm sim off",1); return; }
+        to_lower_inplace(t);
+        if(l) submit(SI5351_OP_FM_PARAM,0,SI5351_FM_P_SIM_LEVEL,0,(uint32_t)strtoul(l,NULL,10));
+        submit(SI5351_OP_FM_SIM,0,0,0,strcmp(t,"off") ? (uint32_t)strtoul(t,NULL,10) : 0);
+        return;
+    }
+    uint8_t mode=SI5351_FM_MODE_FM;
+    char*ch=a;
+    if(!strcmp(a,"pm")){ mode=SI5351_FM_MODE_PM; ch=strtok(NULL," \t\r\n"); }
+    char*f=strtok(NULL," \t\r\n");
+    char*d=strtok(NULL," \t\r\n");
+    char*r=strtok(NULL," \t\r\n");
+    if(!ch||!f||!d||!isdigit((unsigned char)ch[0])){
+        serial_printf("usage: fm [pm] <ch> <MHz> <dev_kHz | peak_rad> [updates/s] | sim ... | stop",1);
         return;
     }
+    double dv=strtod(d,NULL)*1e3;                 // kHz → Hz / rad → mrad
+    if(dv<1.0){ serial_printf("ERR: deviation must be > 0",1); return; }
+    submit(SI5351_OP_FM_PARAM,0,SI5351_FM_P_DEV,0,(uint32_t)(dv+0.5));
+    submit(SI5351_OP_FM_PARAM,0,SI5351_FM_P_RATE,0,r ? (uint32_t)strtoul(r,NULL,10) : 0);
+    submit(SI5351_OP_FM,(uint8_t)atoi(ch),mode,0,mhz_to_hz(f));
+}
+
+// freq（互換）: freq <MHz> → CLK0
+static void cmd_freq(const char *key){
+    char*p=strtok(NULL," \t\r\n");
+    if(!p){ serial_printf("usage: freq <MHz>",1); return; }
+    submit(SI5351_OP_FREQ,0,0,0,mhz_to_hz(p));
+}
 
-    // ---- 汎用: clk <ch> <MHz> ----
-    if(!strcmp(key,"clk")){
-        char*ch=strtok(NULL," \t\r\n");
-        char*mhz=strtok(NULL," \t\r\n");
-        if(!ch||!mhz){ serial_printf("usage: clk <ch:0|1|2> <MHz>",1); return; }
-        si5351_set_freq_ch((unsigned)atoi(ch),(unsigned)atoi(mhz));
+// 汎用: clk <ch> <MHz>
+static void cmd_clk(const char *key){
+    char*ch=strtok(NULL," \t\r\n");
+    char*mhz=strtok(NULL," \t\r\n");
+    if(!ch||!mhz){ serial_printf("usage: clk <ch:0..%u> <MHz>",1,si5351_engine_chip()->n_out-1u); return; }
+    submit(SI5351_OP_FREQ,(uint8_t)atoi(ch),0,0,mhz_to_hz(mhz));
+}
+
+// macro define <name> / macro delete <name> / macro show <name> / macro cancel / macro
+static void cmd_macro(const char *key){
+    char*a=strtok(NULL," \t\r\n");
+    char*name=strtok(NULL," \t\r\n");
+    if(a) to_lower_inplace(a);
+    if(!a || !strcmp(a,"list")){
+        unsigned n;
+        const char *nm;
+        for(unsigned i=0;(nm=si5351_macro_name(i,&n))!=NULL;i++) serial_printf("  %-12s %3u ops",1,nm,n);
+        serial_printf("macro store: %u/%u ops (flash, 1 sector)",1,si5351_macro_ops_used(),(unsigned)SI5351_MACRO_OPS);
+        return;
+    }
+    if(!strcmp(a,"cancel")){
+        if(si5351_macro_recording()) serial_printf("macro %s: discarded",1,si5351_macro_recording_name());
+        si5351_macro_cancel();
         return;
     }
+    if(!name){ serial_printf("usage: macro [list] | define <name> ... end | delete <name> | show <name> | cancel",1); return; }
+    if(!strcmp(a,"define")){
+        int rc=si5351_macro_begin(name);
+        if(rc==-1) serial_printf("ERR: name must be 1..%u chars of [A-Za-z0-9_-]",1,(unsigned)SI5351_MACRO_NAME-1u);
+        else if(rc==-2) serial_printf("ERR: macro table full (%u)",1,(unsigned)SI5351_MACRO_MAX);
+        else if(rc==-3) serial_printf("ERR: already defining %s",1,si5351_macro_recording_name());
+        else serial_printf("macro %s: recording until 'end' (macro cancel to discard)",1,name);
+        return;
+    }
+    if(!strcmp(a,"delete")){
+        if(si5351_macro_recording()){ serial_printf("ERR: finish the definition first",1); return; }
+        si5351_engine_flush();      // フラッシュ消去中はもう一方のコアも止まるので、書込みを済ませておく
+        int rc=si5351_macro_delete(name);
+        if(rc==-1) serial_printf("ERR: no macro %s",1,name);
+        else if(rc<0) serial_printf("ERR: flash write failed",1);
+        else serial_printf("macro %s: deleted",1,name);
+        return;
+    }
+    if(!strcmp(a,"show")){
+        unsigned n;
+        const si5351_op_t *op=si5351_macro_find(name,&n);
+        if(!op){ serial_printf("ERR: no macro %s",1,name); return; }
+        for(unsigned i=0;i<n;i++)
+            serial_printf("  %3u: op=%-3u ch=%u b0=%u b1=%u v=%lu",1,i,op[i].code,op[i].ch,op[i].b0,op[i].b1,
+                          (unsigned long)op[i].v.u);
+        return;
+    }
+    serial_printf("usage: macro [list] | define <name> ... end | delete <name> | show <name> | cancel",1);
+}
+
+// end（macro define の終わり）
+static void cmd_end(const char *key){
+    if(!si5351_macro_recording()){ serial_printf("ERR: not defining a macro",1); return; }
+    char name[SI5351_MACRO_NAME];
+    strncpy(name,si5351_macro_recording_name(),sizeof(name));
+    si5351_engine_flush();
+    int rc=si5351_macro_end();
+    if(rc==-2) serial_printf("macro %s: empty, discarded",1,name);
+    else if(rc==-3) serial_printf("ERR: macro %s exceeded the store, discarded",1,name);
+    else if(rc==-4) serial_printf("ERR: flash write failed (macro %s kept in RAM until reboot)",1,name);
+    else serial_printf("macro %s: %d ops saved (%u/%u used)",1,name,rc,si5351_macro_ops_used(),(unsigned)SI5351_MACRO_OPS);
+}
+
+// run <name>: 解析済みの操作をそのままリングへ流す（エンジンは前の操作の書込み中に次を受け取れる）
+static void run_ops(const si5351_op_t *op, unsigned n){
+    for(unsigned i=0;i<n;i++) submit_op(&op[i]);
+}
+
+static void cmd_run(const char *key){
+    char*name=strtok(NULL," \t\r\n");
+    if(!name){ serial_printf("usage: run <name>",1); return; }
+    unsigned n;
+    const si5351_op_t *op=si5351_macro_find(name,&n);
+    if(!op){ serial_printf("ERR: no macro %s",1,name); return; }
+    run_ops(op,n);
+}
+
+void si5351_cli_autorun(void){
+    unsigned n;
+    const si5351_op_t *op=si5351_macro_find("autorun",&n);
+    if(!op) return;
+    serial_printf("[BOOT] autorun: %u ops",1,n);
+    // 起動状態機械から非同期に呼ばれるので, 定義中のマクロへは積まずに直接投入する
+    for(unsigned i=0;i<n;i++) si5351_engine_submit_wait(&op[i]);
+}
+
+// ===== コマンド表（ディスパッチと行エディタの補完で共用）=====
+typedef struct {
+    const char *name;
+    void      (*fn)(const char *key);
+    bool        alias;                  // 補完候補には出さない別名
+} cli_cmd_t;
+
+static const cli_cmd_t k_cmds[] = {
+    { "help",     cmd_help_k,   false },
+    { "h",        cmd_help_k,   true  },
+    { "?",        cmd_help_k,   true  },
+    { "queue",    cmd_queue_k,  false },
+    { "mem",      cmd_mem_k,    false },
+    { "at",       cmd_at,       false },
+    { "trig",     cmd_trig,     false },
+    { "dma",      cmd_dma,      false },
+    { "scan",     cmd_scan,     false },
+    { "ping",     cmd_ping,     false },
+    { "status",   cmd_status,   false },
+    { "init",     cmd_init,     false },
+    { "force_on", cmd_force_on, false },
+    { "cfg",      cmd_cfg,      false },
+    { "peek",     cmd_peek,     false },
+    { "poke",     cmd_poke,     false },
+    { "oe",       cmd_oe,       false },
+    { "plan",     cmd_plan,     false },
+    { "drive",    cmd_out_cfg,  false },
+    { "invert",   cmd_out_cfg,  false },
+    { "idle",     cmd_out_cfg,  false },
+    { "chip",     cmd_chip,     false },
+    { "ref",      cmd_ref,      false },
+    { "power",    cmd_power,    false },
+    { "fine",     cmd_fine,     false },
+    { "bench",    cmd_bench,    false },
+    { "freq",     cmd_freq,     false },
+    { "clk",      cmd_clk,      false },
+    { "macro",    cmd_macro,    false },
+    { "end",      cmd_end,      false },
+    { "run",      cmd_run,      false },
+    { "wdt",      cmd_wdt,      false },
+    { "trace",    cmd_trace,    false },
+    { "hop",      cmd_hop,      false },
+    { "track",    cmd_track,    false },
+    { "sna",      cmd_sna,      false },
+    { "fm",       cmd_fm,       false },
+};
+#define N_CMDS  (sizeof(k_cmds) / sizeof(k_cmds[0]))
+
+const char *si5351_cli_command(unsigned i){
+    for(unsigned k=0;k<N_CMDS;k++){
+        if(k_cmds[k].alias) continue;
+        if(i--==0) return k_cmds[k].name;
+    }
+    return NULL;
+}
+
+// ===== CLIハンドラ =====
+void si5351_cli_handle(const char *cmd){
+    if(!cmd || !*cmd) return;
+
+    // 行バッファ上の文字列（main の受信行・at の残り部分）はその場で解析し、それ以外は行バッファへ写す
+    char *buf = (char*)cmd;
+    if((uintptr_t)cmd < (uintptr_t)g_line || (uintptr_t)cmd >= (uintptr_t)g_line + SI5351_LINE_LEN){
+        buf = g_line;
+        strncpy(buf,cmd,SI5351_LINE_LEN); buf[SI5351_LINE_LEN-1]='\0';
+    }
+    si5351_mem_use(g_mem_line,(uint32_t)((buf - g_line) + strlen(buf) + 1));
+    replace_char(buf,'=',' ');
+
+    char *tok = strtok(buf," \t\r\n");
+    if(!tok) return;
+
+    char key[32]; strncpy(key,tok,sizeof(key)); key[sizeof(key)-1]='\0';
+    to_lower_inplace(key);
+
+    for(unsigned i=0;i<N_CMDS;i++){
+        if(!strcmp(key,k_cmds[i].name)){ k_cmds[i].fn(key); return; }
+    }
 
     // ---- 個別: freqX / chX / clkX / cllX ----
-    for(int i=0;i<3;i++){
-        char pat1[8],pat2[8],pat3[8],pat4[8];
-        sprintf(pat1,"freq%d",i); sprintf(pat2,"ch%d",i);
-        sprintf(pat3,"clk%d",i);  sprintf(pat4,"cll%d",i); // typo tolerant
-        if(!strcmp(key,pat1) || !strcmp(key,pat2) || !strcmp(key,pat3) || !strcmp(key,pat4)){
-            char*p=strtok(NULL," \t\r\n");
-            si5351_set_freq_ch((unsigned)i, p ? (unsigned)atoi(p) : 0U);
-            return;
-        }
+    int kc = key_channel(key);
+    if(kc >= 0){
+        char*p=strtok(NULL," \t\r\n");
+        submit(SI5351_OP_FREQ,(uint8_t)kc,0,0,p ? mhz_to_hz(p) : 0U);
+        return;
     }
 
     // ---- 不明コマンド ----
@@ -38,6 +38,27 @@ void si5351_cli_init(i2c_inst_t *i2c_port, uint8_t i2c_addr);
  */
 void si5351_cli_handle(const char *cmd);
 
+#ifndef SI5351_LINE_LEN
+#define SI5351_LINE_LEN     128     // 入力行（アリーナ上, 受信と解析で共用）
+#endif
+
+/**
+ * @brief 入力行バッファ（SI5351_LINE_LEN バイト, si5351_cli_init() 後に有効）
+ *
+ * ここに受信した行は si5351_cli_handle() がコピーせずにその場で解析する。
+ */
+char *si5351_cli_line(void);
+
+/**
+ * @brief コマンド表の i 番目の名前（別名を除く, 範囲外なら NULL）
+ *
+ * si5351_cli_handle() のディスパッチと同じ表で、行エディタの Tab 補完が使う。
+ */
+const char *si5351_cli_command(unsigned i);
+
+/** マクロ "autorun" があれば実行する（起動時の出力設定の後に呼ぶ） */
+void si5351_cli_autorun(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
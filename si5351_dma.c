@@ -0,0 +1,194 @@
+/**
+ * @file    si5351_dma.c
+ * @brief   チェーン DMA による I2C レジスタ列の再生（ステップごとの CPU 介入なし）
+ * @date    2025-11-08
+ * @version 1.0
+ */
+
+#include "si5351_dma.h"
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+// ===== シーケンス作成 =====
+void si5351_dma_seq_init(si5351_dma_seq_t *q, uint16_t *words, uint32_t cap_words,
+                         uint32_t (*ctrl)[2], uint32_t cap_steps) {
+    memset(q, 0, sizeof(*q));
+    q->words = words;
+    q->cap_words = cap_words;
+    q->ctrl = ctrl;
+    q->cap_steps = cap_steps;
+}
+
+void si5351_dma_seq_begin(si5351_dma_seq_t *q) {
+    q->step_start = q->n_words;
+    q->cur_xfers = 0;
+}
+
+bool si5351_dma_seq_write(si5351_dma_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len) {
+    if (len == 0) return true;
+    if (q->n_words + 1u + len > q->cap_words) { q->overflow = true; return false; }
+    q->words[q->n_words++] = reg;                       // CMD=0（書込み）, START は自動
+    for (uint8_t i = 0; i < len; i++)
+        q->words[q->n_words++] = (uint16_t)(d[i] | ((i + 1u == len) ? SI5351_DMA_CMD_STOP : 0u));
+    q->cur_xfers++;
+    return true;
+}
+
+bool si5351_dma_seq_end(si5351_dma_seq_t *q) {
+    // 終端のヌルブロック 1 個分を常に残す
+    if (q->n_steps + 1u >= q->cap_steps) { q->overflow = true; q->n_words = q->step_start; return false; }
+    uint32_t n = q->n_words - q->step_start;
+    q->ctrl[q->n_steps][0] = n;
+    q->ctrl[q->n_steps][1] = (uint32_t)(uintptr_t)&q->words[q->step_start];
+    q->n_steps++;
+    q->n_xfers += q->cur_xfers;
+    if (n > q->max_step_words) q->max_step_words = n;
+    if (q->cur_xfers > q->max_step_xfers) q->max_step_xfers = q->cur_xfers;
+    return true;
+}
+
+void si5351_dma_seq_cancel(si5351_dma_seq_t *q) {
+    q->n_words = q->step_start;
+    q->cur_xfers = 0;
+    q->overflow = false;
+}
+
+// ===== 再生 =====
+static int      g_ch_pacer = -1, g_ch_ctrl = -1, g_ch_data = -1;
+static int      g_timer = -1;
+static uint32_t g_dummy;
+static i2c_inst_t        *g_i2c;
+static si5351_dma_seq_t  *g_seq;
+static bool               g_playing;
+static uint64_t           g_t_start;
+static si5351_dma_result_t g_last;
+
+static bool claim_all(void) {
+    if (g_ch_pacer < 0) g_ch_pacer = dma_claim_unused_channel(false);
+    if (g_ch_ctrl  < 0) g_ch_ctrl  = dma_claim_unused_channel(false);
+    if (g_ch_data  < 0) g_ch_data  = dma_claim_unused_channel(false);
+    if (g_timer    < 0) g_timer    = dma_claim_unused_timer(false);
+    return g_ch_pacer >= 0 && g_ch_ctrl >= 0 && g_ch_data >= 0 && g_timer >= 0;
+}
+
+int si5351_dma_play(i2c_inst_t *i2c, uint8_t addr, si5351_dma_seq_t *q, uint32_t step_hz, bool paced_first) {
+    if (g_playing) return -3;
+    if (q->n_steps == 0) return -1;
+    if (!claim_all()) return -2;
+
+    // 終端ヌルブロック（data の READ_ADDR_TRIG に 0 を書く → 起動されない）
+    q->ctrl[q->n_steps][0] = 0;
+    q->ctrl[q->n_steps][1] = 0;
+
+    // ステップ周期 = ダミー N 語 × タイマ周期（タイマは 1/Y × clk_sys, Y <= 65535）
+    uint32_t n_tick = 1, y = 1;
+    if (step_hz) {
+        uint32_t period = clock_get_hz(clk_sys) / step_hz;
+        if (period == 0) period = 1;
+        n_tick = (period + 65534u) / 65535u;
+        y = period / n_tick;
+        if (y == 0) y = 1;
+    }
+    dma_timer_set_fraction((uint)g_timer, 1, (uint16_t)y);
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS;
+    (void)hw->clr_tx_abrt;
+
+    // data: コマンド語 → IC_DATA_CMD（I2C TX FIFO の空きで進む）→ 終了で pacer へ
+    dma_channel_config c = dma_channel_get_default_config((uint)g_ch_data);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+    channel_config_set_chain_to(&c, step_hz ? (uint)g_ch_pacer : (uint)g_ch_ctrl);
+    dma_channel_configure((uint)g_ch_data, &c, &hw->data_cmd, NULL, 0, false);
+
+    // ctrl: 制御ブロック 2 語 → data の AL3（TRANS_COUNT, READ_ADDR_TRIG）
+    c = dma_channel_get_default_config((uint)g_ch_ctrl);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, 3);               // 8 バイトで折り返し
+    dma_channel_configure((uint)g_ch_ctrl, &c, &dma_hw->ch[g_ch_data].al3_transfer_count,
+                          q->ctrl, 2, false);
+
+    // pacer: DMA タイマの DREQ でダミー語を N 回 → ctrl へ
+    c = dma_channel_get_default_config((uint)g_ch_pacer);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, dma_get_timer_dreq((uint)g_timer));
+    channel_config_set_chain_to(&c, (uint)g_ch_ctrl);
+    dma_channel_configure((uint)g_ch_pacer, &c, &g_dummy, &g_dummy, n_tick, false);
+
+    g_i2c = i2c;
+    g_seq = q;
+    g_playing = true;
+    g_last.steps = q->n_steps;
+    g_last.tx_aborts = 0;
+    g_t_start = time_us_64();
+    // 先頭ステップは即時（区間の継ぎ目では 1 周期待って間隔をそろえる）
+    dma_channel_start((paced_first && step_hz) ? (uint)g_ch_pacer : (uint)g_ch_ctrl);
+    return 0;
+}
+
+static void finish(void) {
+    i2c_hw_t *hw = i2c_get_hw(g_i2c);
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        g_last.tx_aborts++;
+        (void)hw->clr_tx_abrt;
+    }
+    (void)hw->clr_stop_det;     // 再生の STOP を残すと, 次の i2c_xfer_regs が自分の STOP の前に終わったと見なす
+    hw->dma_cr = 0;
+    g_last.elapsed_us = (uint32_t)(time_us_64() - g_t_start);
+    g_playing = false;
+}
+
+bool si5351_dma_busy(void) {
+    if (!g_playing) return false;
+    // 制御ブロックを終端まで読み切り, 全チャネル停止, TX FIFO が空でバスも停止
+    const uint32_t *end = &g_seq->ctrl[g_seq->n_steps + 1][0];
+    if (dma_hw->ch[g_ch_ctrl].read_addr != (uint32_t)(uintptr_t)end) return true;
+    if (dma_channel_is_busy((uint)g_ch_ctrl) || dma_channel_is_busy((uint)g_ch_data) ||
+        dma_channel_is_busy((uint)g_ch_pacer)) return true;
+    i2c_hw_t *hw = i2c_get_hw(g_i2c);
+    if (!(hw->status & I2C_IC_STATUS_TFE_BITS) || (hw->status & I2C_IC_STATUS_ACTIVITY_BITS)) return true;
+    finish();
+    return false;
+}
+
+void si5351_dma_abort(void) {
+    if (!g_playing) return;
+    dma_channel_abort((uint)g_ch_pacer);
+    dma_channel_abort((uint)g_ch_ctrl);
+    dma_channel_abort((uint)g_ch_data);
+    // FIFO に入っている分は送り切る。STOP 付きの語の前で止まった場合はバスを保持したままに
+    // なるので、IC_ENABLE.ABORT で STOP を出させる
+    i2c_hw_t *hw = i2c_get_hw(g_i2c);
+    uint64_t t0 = time_us_64();
+    while (!(hw->status & I2C_IC_STATUS_TFE_BITS) && time_us_64() - t0 < 2000)
+        tight_loop_contents();
+    if (hw->status & I2C_IC_STATUS_ACTIVITY_BITS) {
+        hw->enable |= I2C_IC_ENABLE_ABORT_BITS;
+        while (hw->enable & I2C_IC_ENABLE_ABORT_BITS) tight_loop_contents();
+    }
+    finish();
+}
+
+void si5351_dma_last_result(si5351_dma_result_t *r) {
+    *r = g_last;
+}
+
+uint32_t si5351_dma_est_step_ns(uint32_t bytes, uint32_t xfers, uint32_t bus_hz) {
+    if (bus_hz == 0) return 0;
+    // tBUF（STOP→START）: Standard 4.7us, Fast 1.3us, Fast-mode Plus 0.5us
+    uint32_t t_buf_ns = (bus_hz <= 100000u) ? 4700u : (bus_hz <= 400000u) ? 1300u : 500u;
+    uint64_t bits = (uint64_t)xfers * (1u + 9u + 1u) + 9ull * bytes;
+    return (uint32_t)(bits * 1000000000ull / bus_hz) + xfers * t_buf_ns;
+}
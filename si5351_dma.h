@@ -0,0 +1,105 @@
+/**
+ * @file    si5351_dma.h
+ * @brief   チェーン DMA による I2C レジスタ列の再生（ステップごとの CPU 介入なし）
+ * @date    2025-11-08
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * シーケンスは IC_DATA_CMD にそのまま書く 16bit コマンド語（データ + STOP/RESTART ビット）の列と、
+ * ステップごとの制御ブロック {語数, 先頭アドレス} の列からなる。
+ *
+ *   pacer  (DMA タイマ DREQ, ダミー N 語) ──chain──▶ ctrl
+ *   ctrl   (制御ブロック 2 語 → data の AL3 TRANS_COUNT / READ_ADDR_TRIG)
+ *   data   (I2C TX DREQ, コマンド語 → IC_DATA_CMD) ──chain──▶ pacer
+ *
+ * 最後の制御ブロックは {0, 0}（ヌルトリガ）で、data が起動されずに連鎖が止まる。
+ */
+
+#ifndef SI5351_DMA_H
+#define SI5351_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_DMA_STEPS
+#define SI5351_DMA_STEPS    512         // 制御ブロック数（2 区間の合計）
+#endif
+#ifndef SI5351_DMA_WORDS
+#define SI5351_DMA_WORDS    4096        // コマンド語数（2 区間の合計）
+#endif
+
+// IC_DATA_CMD のビット
+#define SI5351_DMA_CMD_STOP     0x0200u
+#define SI5351_DMA_CMD_RESTART  0x0400u
+
+typedef struct {
+    uint16_t *words;
+    uint32_t  n_words, cap_words;
+    uint32_t (*ctrl)[2];                // {語数, 先頭アドレス}
+    uint32_t  n_steps, cap_steps;
+    uint32_t  step_start;               // 作成中ステップの先頭語
+    // 統計
+    uint32_t  n_xfers;                  // I2C トランザクション数（全ステップ）
+    uint32_t  max_step_words, max_step_xfers;
+    uint32_t  cur_xfers;
+    bool      overflow;
+} si5351_dma_seq_t;
+
+/** 再生結果 */
+typedef struct {
+    uint32_t steps;
+    uint32_t elapsed_us;
+    uint32_t tx_aborts;                 // NACK 等で I2C が送信を中断した回数
+} si5351_dma_result_t;
+
+void si5351_dma_seq_init(si5351_dma_seq_t *q, uint16_t *words, uint32_t cap_words,
+                         uint32_t (*ctrl)[2], uint32_t cap_steps);
+
+/** ステップ開始（以降の si5351_dma_seq_write() が 1 ステップにまとまる） */
+void si5351_dma_seq_begin(si5351_dma_seq_t *q);
+
+/** 1 トランザクション [reg][d0]..[dn-1|STOP] を追加。容量不足なら false */
+bool si5351_dma_seq_write(si5351_dma_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len);
+
+/** ステップを確定（書込みのないステップも 0 語のステップとして残す） */
+bool si5351_dma_seq_end(si5351_dma_seq_t *q);
+
+/** 作成中ステップを捨てる（容量不足で次の区間へ回すとき） */
+void si5351_dma_seq_cancel(si5351_dma_seq_t *q);
+
+/**
+ * @brief 再生開始
+ * @param step_hz ステップ周期 [Hz]（0 ならバスの許す限り連続）
+ * @param paced_first true なら先頭ステップも 1 周期待ってから送る（区間の継ぎ目用）
+ * @return 0=開始, -1=空, -2=DMA チャネル／タイマ確保失敗, -3=再生中
+ */
+int  si5351_dma_play(i2c_inst_t *i2c, uint8_t addr, si5351_dma_seq_t *q, uint32_t step_hz, bool paced_first);
+
+/** 再生中なら true（完了したら結果を確定して false） */
+bool si5351_dma_busy(void);
+
+/** 中断（I2C の TX FIFO も空になるまで待つ） */
+void si5351_dma_abort(void);
+
+/** 直近の再生結果 */
+void si5351_dma_last_result(si5351_dma_result_t *r);
+
+/**
+ * @brief バス速度 bus_hz での 1 ステップの所要時間見積り [ns]
+ * @param bytes ステップ内の全ペイロード（レジスタ番号を含む）
+ * @param xfers ステップ内のトランザクション数
+ *
+ * START + アドレス 9 bit + 9 bit/バイト + STOP, トランザクション間にバス解放時間 tBUF を加える。
+ */
+uint32_t si5351_dma_est_step_ns(uint32_t bytes, uint32_t xfers, uint32_t bus_hz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_DMA_H
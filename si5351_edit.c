@@ -0,0 +1,213 @@
+/**
+ * @file    si5351_edit.c
+ * @brief   CLI 行エディタ（USB 受信コールバックで溜め, メインループで編集, バックスペース・Ctrl-U・履歴・Tab 補完）
+ * @date    2025-11-11
+ * @version 1.0
+ */
+
+#include "si5351_edit.h"
+#include <string.h>
+#include <ctype.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "serial_comm.h"
+#include "si5351_mem.h"
+
+#define PROMPT  "> "
+
+// ===== 内部状態 =====
+static char                *g_buf;
+static unsigned             g_cap, g_len;
+static volatile bool        g_ready;        // 確定行あり（メインループが処理中）
+static si5351_edit_names_fn g_names;
+static uint8_t              g_esc;          // 0=通常, 1=ESC 受信, 2=ESC [ / ESC O 受信
+static bool                 g_last_cr;      // CR+LF の LF を読み捨てる
+
+// ===== 受信リング（IRQ が書き, メインループが読む）=====
+static uint8_t              g_rxq[SI5351_EDIT_RXQ];
+static volatile uint32_t    g_rxq_head, g_rxq_tail;
+
+// ===== 履歴（アリーナ上, SI5351_HIST_LEN × g_cap）=====
+static char    *g_hist;
+static unsigned g_hist_n, g_hist_head;      // 件数, 次に書くスロット
+static int      g_hist_pos = -1;            // 表示中の履歴（0=最新, -1=編集中の行）
+static int      g_mem_hist = -1;
+
+int si5351_edit_init(char *line, unsigned cap, si5351_edit_names_fn names) {
+    g_buf = line;
+    g_cap = cap;
+    g_len = 0;
+    g_names = names;
+    g_hist = si5351_mem_alloc("hist", SI5351_HIST_LEN * cap, &g_mem_hist);
+    return g_hist ? 0 : -1;
+}
+
+static const char *hist_at(unsigned age) {
+    return &g_hist[((g_hist_head + SI5351_HIST_LEN - 1u - age) % SI5351_HIST_LEN) * g_cap];
+}
+
+static void hist_push(void) {
+    if (!g_hist) return;
+    if (g_hist_n && !strcmp(hist_at(0), g_buf)) return;     // 直前と同じ行は積まない
+    memcpy(&g_hist[g_hist_head * g_cap], g_buf, g_len + 1u);
+    g_hist_head = (g_hist_head + 1u) % SI5351_HIST_LEN;
+    if (g_hist_n < SI5351_HIST_LEN) g_hist_n++;
+    si5351_mem_use(g_mem_hist, g_hist_n * g_cap);
+}
+
+// ===== 表示 =====
+// 行全体を s で置き換えて出し直す
+static void set_line(const char *s) {
+    size_t n = strlen(s);
+    if (n > g_cap - 1u) n = g_cap - 1u;
+    memmove(g_buf, s, n);
+    g_len = (unsigned)n;
+    g_buf[g_len] = '\0';
+    serial_printf("\r\033[K" PROMPT "%s", 0, g_buf);
+}
+
+static void append(const char *s, size_t n) {
+    unsigned from = g_len;
+    for (size_t i = 0; i < n && g_len < g_cap - 1u; i++) g_buf[g_len++] = s[i];
+    g_buf[g_len] = '\0';
+    serial_printf("%s", 0, &g_buf[from]);
+}
+
+// ===== Tab 補完（先頭の語のみ, 大文字小文字は区別しない）=====
+static bool prefix_match(const char *name) {
+    for (unsigned i = 0; i < g_len; i++)
+        if (tolower((unsigned char)g_buf[i]) != name[i]) return false;
+    return true;
+}
+
+static void complete(void) {
+    if (!g_names || memchr(g_buf, ' ', g_len)) return;
+    g_buf[g_len] = '\0';
+
+    const char *first = NULL, *name;
+    unsigned n_match = 0;
+    size_t common = 0;
+    for (unsigned i = 0; (name = g_names(i)) != NULL; i++) {
+        if (!prefix_match(name)) continue;
+        if (!first) { first = name; common = strlen(name); }
+        else {
+            size_t k = g_len;
+            while (k < common && name[k] == first[k]) k++;
+            common = k;
+        }
+        n_match++;
+    }
+    if (n_match == 0) { serial_printf("\a", 0); return; }
+
+    if (common > g_len) append(&first[g_len], common - g_len);
+    if (n_match == 1) { append(" ", 1); return; }
+    if (common > g_len) return;
+
+    // これ以上伸ばせない: 候補を並べて行を出し直す
+    serial_printf("", 1);
+    for (unsigned i = 0; (name = g_names(i)) != NULL; i++)
+        if (prefix_match(name)) serial_printf("%s  ", 0, name);
+    serial_printf("", 1);
+    serial_printf(PROMPT "%s", 0, g_buf);
+}
+
+// ===== 1 文字処理 =====
+void si5351_edit_feed(int c) {
+    if (g_ready) return;
+
+    // エスケープシーケンス（↑ = ESC [ A, ↓ = ESC [ B。ESC O A 形式も受ける）
+    if (g_esc == 1) { g_esc = (c == '[' || c == 'O') ? 2 : 0; return; }
+    if (g_esc == 2) {
+        if ((c >= '0' && c <= '9') || c == ';') return;     // 修飾付き（ESC [ 1 ; 5 A など）
+        g_esc = 0;
+        if (c == 'A' && g_hist_pos + 1 < (int)g_hist_n) {
+            g_hist_pos++;
+            set_line(hist_at((unsigned)g_hist_pos));
+        } else if (c == 'B' && g_hist_pos >= 0) {
+            g_hist_pos--;
+            set_line(g_hist_pos >= 0 ? hist_at((unsigned)g_hist_pos) : "");
+        }
+        return;
+    }
+
+    bool cr = false;
+    switch (c) {
+    case 0x1B:
+        g_esc = 1;
+        break;
+    case '\r':
+    case '\n':
+        if (c == '\n' && g_last_cr) break;
+        cr = (c == '\r');
+        serial_printf("", 1);
+        g_hist_pos = -1;
+        if (g_len == 0) { serial_printf(PROMPT, 0); break; }
+        g_buf[g_len] = '\0';
+        hist_push();                    // 解析で行が書き換わる前に積む
+        __dmb();
+        g_ready = true;
+        break;
+    case 0x08:
+    case 0x7F:
+        if (g_len) { g_len--; serial_printf("\b \b", 0); }
+        break;
+    case 0x15:                          // Ctrl-U
+        set_line("");
+        break;
+    case '\t':
+        complete();
+        break;
+    default:
+        if (c >= 0x20 && c <= 0x7E && g_len < g_cap - 1u) {
+            g_buf[g_len++] = (char)c;
+            serial_printf("%c", 0, c);
+        }
+        break;
+    }
+    g_last_cr = cr;
+}
+
+void si5351_edit_rx_callback(void *param) {
+    (void)param;
+    // リングが満杯なら読まない（続きは USB 側に残り, si5351_edit_take() が直接読む）
+    while (g_rxq_head - g_rxq_tail < SI5351_EDIT_RXQ) {
+        int c = getchar_timeout_us(0);
+        if (c == PICO_ERROR_TIMEOUT) break;
+        g_rxq[g_rxq_head % SI5351_EDIT_RXQ] = (uint8_t)c;
+        __dmb();
+        g_rxq_head++;
+    }
+}
+
+char *si5351_edit_take(void) {
+    // 溜まった文字 → USB 側に残った文字の順に処理する（エコーはここで出る）
+    while (!g_ready) {
+        int c;
+        if (g_rxq_tail != g_rxq_head) {
+            __dmb();
+            c = g_rxq[g_rxq_tail % SI5351_EDIT_RXQ];
+            g_rxq_tail++;
+        } else {
+            uint32_t irq = save_and_disable_interrupts();   // コールバックと同時に読まない
+            c = getchar_timeout_us(0);
+            restore_interrupts(irq);
+            if (c == PICO_ERROR_TIMEOUT) break;
+        }
+        si5351_edit_feed(c);
+    }
+    if (!g_ready) return NULL;
+    __dmb();
+    return g_buf;
+}
+
+void si5351_edit_done(void) {
+    g_len = 0;
+    g_buf[0] = '\0';
+    __dmb();
+    g_ready = false;
+}
+
+void si5351_edit_prompt(void) {
+    serial_printf("", 1);
+    serial_printf(PROMPT "%.*s", 0, (int)g_len, g_buf);
+}
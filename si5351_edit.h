@@ -0,0 +1,66 @@
+/**
+ * @file    si5351_edit.h
+ * @brief   CLI 行エディタ（USB 受信コールバックで溜め, メインループで編集, バックスペース・Ctrl-U・履歴・Tab 補完）
+ * @date    2025-11-11
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * stdio の chars-available コールバック（USB の低優先度 IRQ）は受信文字を SI5351_EDIT_RXQ 文字のリングへ
+ * 溜めるだけで、何も出力しない（USB stdio の出力は IRQ から使えない）。エコー・行の出し直し・補完候補の表示は
+ * メインループが si5351_edit_take() の中で溜まった文字を処理するときに行う。
+ * 行が確定してから si5351_edit_done() までは処理しない（後続の入力はリングと USB 側に溜まる）。
+ *
+ *   BS / DEL : 1 文字削除      Ctrl-U : 行を消去
+ *   ↑ / ↓    : 履歴（SI5351_HIST_LEN 行のリング）
+ *   Tab      : 先頭の語をコマンド表から補完（候補が複数なら共通部分まで, それ以上は一覧）
+ */
+
+#ifndef SI5351_EDIT_H
+#define SI5351_EDIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_EDIT_RXQ
+#define SI5351_EDIT_RXQ     64          // 受信文字のリング（2 のべき）
+#endif
+
+#ifndef SI5351_HIST_LEN
+#define SI5351_HIST_LEN     8           // 履歴の行数（アリーナ上, 1 行 = 行バッファ長）
+#endif
+
+/** 補完候補: i 番目のコマンド名（範囲外なら NULL） */
+typedef const char *(*si5351_edit_names_fn)(unsigned i);
+
+/**
+ * @brief 初期化（履歴をアリーナから確保する）
+ * @param line  編集・確定行のバッファ（cap バイト）
+ * @param names 補完に使うコマンド表（NULL なら補完なし）
+ * @return 0=OK, -1=アリーナ不足（履歴なしで動く）
+ */
+int  si5351_edit_init(char *line, unsigned cap, si5351_edit_names_fn names);
+
+/** stdio_set_chars_available_callback() に渡す受信コールバック（IRQ 文脈, リングへ溜めるだけ） */
+void si5351_edit_rx_callback(void *param);
+
+/** 1 文字処理する（エコーを出すのでメインループ文脈から呼ぶ） */
+void si5351_edit_feed(int c);
+
+/** 溜まった文字を処理し, 確定した行を返す（なければ NULL）。処理が終わったら si5351_edit_done() を呼ぶ */
+char *si5351_edit_take(void);
+
+/** 確定行の処理完了（次の行の受信を再開する） */
+void si5351_edit_done(void);
+
+/** プロンプトと編集中の行を出し直す */
+void si5351_edit_prompt(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_EDIT_H
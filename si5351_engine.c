@@ -0,0 +1,2930 @@
+/**
+ * @file    si5351_engine.c
+ * @brief   Si5351 レジスタエンジン（操作リングの消費者: プラン・シャドウ・I2C 書込み）
+ * @date    2025-11-06
+ * @version 1.0
+ */
+
+#include "si5351_engine.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "pico/stdio.h"
+#include "i2c_comm.h"
+#include "serial_comm.h"
+#include "si5351_plan.h"
+#include "si5351_chip.h"
+#include "si5351_ring.h"
+#include "si5351_sched.h"
+#include "si5351_dma.h"
+#include "si5351_seq.h"
+#include "si5351_mem.h"
+#include "si5351_hot.h"
+#include "si5351_wdt.h"
+#include "si5351_trace.h"
+#include "si5351_adc.h"
+#include "si5351_sna.h"
+#include "si5351_fm.h"
+#include "si5351_boot.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/regs/m0plus.h"
+#if SI5351_ENGINE_CORE1
+#include "pico/multicore.h"
+#include "pico/flash.h"
+#endif
+
+#ifndef SI5351_CHIP_DEFAULT
+#define SI5351_CHIP_DEFAULT       SI5351_CHIP_A3   // AE-Si5351A（MSOP-10）
+#endif
+
+// ===== 内部状態 =====
+static i2c_inst_t *g_i2c = NULL;
+static uint8_t g_addr = 0x60;   // AE-Si5351A 固定（7-bit）
+static si5351_plan_t *g_plan;                 // アリーナ上（si5351_engine_init で確保）
+static const si5351_chip_t *g_chip = &si5351_chips[SI5351_CHIP_DEFAULT];
+
+// ===== チャネル出力設定（CLKx_CTRL と DIS_STATE の元データ）=====
+typedef struct {
+    uint8_t drive_ma;   // 2/4/6/8
+    bool    invert;
+    uint8_t dis_state;  // OE 無効時の状態: 0=LOW 1=HIGH 2=Hi-Z 3=常時有効
+    bool    powered;    // false → CLKx_CTRL bit7(PD)=1
+} clk_cfg_t;
+
+#define CLK_CFG_DEFAULT { 8, false, 0, false }
+static clk_cfg_t g_clk_cfg[SI5351_MAX_OUT] = {
+    CLK_CFG_DEFAULT, CLK_CFG_DEFAULT, CLK_CFG_DEFAULT, CLK_CFG_DEFAULT,
+    CLK_CFG_DEFAULT, CLK_CFG_DEFAULT, CLK_CFG_DEFAULT, CLK_CFG_DEFAULT,
+};
+static uint32_t g_ctrl_writes, g_ctrl_skips;   // CLKx_CTRL 書込／省略回数
+
+// ===== 電源ポリシー =====
+typedef enum {
+    PWR_OE_ONLY = SI5351_PWR_OE_ONLY,   // 従来動作: OE ビットのみ（MS/ドライバは動作継続）
+    PWR_AUTO    = SI5351_PWR_AUTO,      // 停止チャネルは CLKx_CTRL.PD=1 で MS/ドライバも停止
+} power_policy_t;
+
+static power_policy_t g_power_policy = PWR_AUTO;
+static si5351_cand_t  g_parked[SI5351_MAX_OUT];   // 停止直前の採用候補（再有効化で再利用）
+static bool           g_parked_valid[SI5351_MAX_OUT];
+static uint32_t       g_bus_bytes;        // 書き込んだペイロードバイト数（累計）
+
+// ===== 基準入力（XTAL / CLKIN）=====
+typedef enum { REF_XTAL = 0, REF_CLKIN } ref_src_t;
+
+static ref_src_t g_ref_src = REF_XTAL;
+static uint32_t  g_clkin_hz = 10000000UL;  // CLKIN 入力周波数
+static uint8_t   g_clkin_div_log2;         // CLKIN_DIV: 1/2/4/8
+
+// ===== アリーナ領域（mem 表示用の番号）=====
+static int g_mem_opq = -1, g_mem_at = -1, g_mem_trig = -1, g_mem_seq = -1, g_mem_dma = -1, g_mem_dmac = -1;
+static int g_mem_sna = -1, g_mem_fm = -1;
+
+// ===== 実行文脈 =====
+static volatile bool g_busy;        // エンジンが操作を実行中（アラーム IRQ は書込みを見送る）
+static volatile bool g_in_irq;      // アラーム IRQ から書込み中（エラー表示を抑止）
+static uint32_t      g_i2c_errors;
+
+static volatile uint32_t g_beat;    // si5351_engine_poll の呼び出し回数（ウォッチドッグの心拍）
+
+// 割り込み文脈では表示せず数えるだけ（USB stdio は IRQ から使えない）
+#define ENG_ERR(...) do { g_i2c_errors++; if (!g_in_irq) serial_printf(__VA_ARGS__); } while (0)
+
+// 1 つの操作の中で長く回るループ（dma sweep の求解・dma bench の再生待ち）から呼ぶ:
+// 心拍を進めてウォッチドッグを更新する（単一コアではメインループが回らず, core1 構成では心拍が止まるため）
+static inline void engine_alive(void) {
+    g_beat++;
+    si5351_wdt_kick();
+}
+
+// ===== レジスタシャドウ（最後に書いた／読んだ値）=====
+static uint8_t  *g_shadow;                      // 256 バイト（アリーナ上）
+static uint32_t *g_shadow_valid;                // 256 ビット
+static volatile bool g_keep_dirty;              // 保持領域へ写していない変更あり（si5351_wdt.h）
+
+// ===== レジスタ定義 =====
+#define REG_STAT0                 0x00   // SYS_INIT/LOL_A/LOL_B/LOS 等
+#define REG_OE                    0x03
+#define REG_CLK0_CTRL             0x10
+#define REG_CLK1_CTRL             0x11
+#define REG_CLK2_CTRL             0x12
+#define REG_MS0_BASE              0x2A   // 0x2A..0x31
+#define REG_CRYSTAL_LOAD          0xB7
+#define REG_PLLA_BASE             0x1A   // 0x1A..0x21
+#define REG_PLLB_BASE             0x22   // 0x22..0x29
+#define REG_FBA_INT               0x16   // bit6=FBA_INT（0x17 bit6=FBB_INT）
+#define REG_PLL_RESET             0xB1
+
+// CLKx_CTRL / MSx はチップ記述子（si5351_chip.h）から算出
+static const uint8_t k_pll_base[2] = { REG_PLLA_BASE, REG_PLLB_BASE };
+
+// ===== シャドウ操作 =====
+static inline bool shadow_has(uint8_t reg) {
+    return (g_shadow_valid[reg >> 5] >> (reg & 31)) & 1u;
+}
+static inline void shadow_put(uint8_t reg, const uint8_t *d, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++, reg++) {
+        g_shadow[reg] = d[i];
+        g_shadow_valid[reg >> 5] |= 1u << (reg & 31);
+    }
+    g_keep_dirty = true;
+}
+static void shadow_invalidate(void) {
+    memset(g_shadow_valid, 0, 256 / 8);
+    g_keep_dirty = true;
+}
+
+// ===== I2C（trace on の間は 1 件ずつ記録）=====
+static inline int SI5351_HOT(bus_write)(uint8_t reg, uint8_t *d, uint8_t n) {
+    uint32_t t0 = timer_hw->timerawl;
+    int rc = i2c_write(g_i2c, g_addr, reg, d, n);
+    if (si5351_trace_active) si5351_trace_put(SI5351_TR_WR, g_addr, reg, d, n, t0, rc);
+    return rc;
+}
+static inline int SI5351_HOT(bus_read)(uint8_t reg, uint8_t *d, uint8_t n) {
+    uint32_t t0 = timer_hw->timerawl;
+    int rc = i2c_read(g_i2c, g_addr, reg, d, n);
+    if (si5351_trace_active) si5351_trace_put(SI5351_TR_RD, g_addr, reg, d, n, t0, rc);
+    return rc;
+}
+
+// ===== ラッパ =====
+static inline int SI5351_HOT(wr8)(uint8_t reg, uint8_t v) {
+    int rc = bus_write(reg, &v, 1);
+    if (rc != 0) ENG_ERR("[I2C] WR FAIL reg=0x%02X val=0x%02X", 1, reg, v);
+    else { shadow_put(reg, &v, 1); g_bus_bytes++; }
+    return rc;
+}
+static inline int SI5351_HOT(rd8)(uint8_t reg, uint8_t *v) {
+    int rc = bus_read(reg, v, 1);
+    if (rc != 0) ENG_ERR("[I2C] RD FAIL reg=0x%02X", 1, reg);
+    return rc;
+}
+// シャドウがあれば I2C を使わずに返す
+static inline int SI5351_HOT(rd8_cached)(uint8_t reg, uint8_t *v) {
+    if (shadow_has(reg)) { *v = g_shadow[reg]; return 0; }
+    int rc = rd8(reg, v);
+    if (rc == 0) shadow_put(reg, v, 1);
+    return rc;
+}
+
+// 変化したバイト範囲だけを書く（len は MS 像 SI5351_MAX_OUT 個分まで。戻り値: 書いたバイト数, 負=失敗）
+// i2c_write は 1 回 WR_CHUNK バイトまでなので, 長い範囲は WR_CHUNK ずつのバーストに分ける
+#define WR_CHUNK    8
+static int SI5351_HOT(wr_delta)(uint8_t reg, const uint8_t *d, uint8_t len) {
+    int lo = -1, hi = -1;
+    for (int i = 0; i < len; i++) {
+        uint8_t r = (uint8_t)(reg + i);
+        if (!shadow_has(r) || g_shadow[r] != d[i]) { if (lo < 0) lo = i; hi = i; }
+    }
+    if (lo < 0) return 0;
+
+    uint8_t buf[WR_CHUNK];
+    for (int i = lo; i <= hi;) {
+        uint8_t n = (uint8_t)((hi - i + 1) < WR_CHUNK ? (hi - i + 1) : WR_CHUNK);
+        memcpy(buf, &d[i], n);
+        if (bus_write((uint8_t)(reg + i), buf, n) != 0) {
+            ENG_ERR("[I2C] WR FAIL reg=0x%02X len=%u", 1, (unsigned)(reg + i), n);
+            return -1;
+        }
+        shadow_put((uint8_t)(reg + i), &d[i], n);
+        g_bus_bytes += n;
+        i += n;
+    }
+    return hi - lo + 1;
+}
+
+// ===== 内部ユーティリティ =====
+static inline bool frac_eq(const si5351_frac_t *x, const si5351_frac_t *y) {
+    return x->a == y->a && x->b == y->b && x->c == y->c;
+}
+
+static bool ch_ok(unsigned ch) {
+    if (ch < g_chip->n_out) return true;
+    serial_printf("ERR: ch=%u (use 0..%u)", 1, ch, g_chip->n_out - 1u);
+    return false;
+}
+
+// FBx_INT（整数帰還なら低ジッタモード）
+static void SI5351_HOT(fb_int_set)(uint8_t k, bool on) {
+    uint8_t reg = (uint8_t)(REG_FBA_INT + k), v = 0;
+    if (rd8_cached(reg, &v) != 0) return;
+    uint8_t nv = on ? (uint8_t)(v | 0x40) : (uint8_t)(v & ~0x40);
+    if (nv != v) wr8(reg, nv);
+}
+
+// ===== PLL リセットとロック待ち =====
+// リセットした PLL は STAT0 の LOL が落ちるまで待ち, リセットからの時間を PLL ごとに記録する。
+// IRQ（at / trig）からのリセットは待たずに印だけ付け, 次のエンジン周回で確かめる。
+#ifndef SI5351_LOCK_BUDGET_US
+#define SI5351_LOCK_BUDGET_US   10000u      // リセット後にロックを待つ上限
+#endif
+
+typedef struct {
+    uint32_t n, timeouts;
+    uint32_t last_us, min_us, max_us;
+    uint64_t sum_us;
+} lock_stats_t;
+
+static lock_stats_t      g_lock[SI5351_NUM_PLL];
+static volatile uint32_t g_lock_t_reset[SI5351_NUM_PLL];   // リセットを書き終えた時刻
+static volatile uint8_t  g_lock_pending;                    // IRQ でリセットし, まだ確かめていない PLL（bit k）
+
+static inline uint8_t pll_rst_bit(uint8_t k) { return k ? 0x80 : 0x20; }   // REG_PLL_RESET
+static inline uint8_t pll_lol_bit(uint8_t k) { return k ? 0x40 : 0x20; }   // STAT0
+
+static void lock_record(uint8_t k, uint32_t us) {
+    lock_stats_t *l = &g_lock[k];
+    if (!l->n || us < l->min_us) l->min_us = us;
+    if (us > l->max_us) l->max_us = us;
+    l->last_us = us;
+    l->sum_us += us;
+    l->n++;
+}
+
+// mask（bit k）の PLL のロックを待つ。timed=false（IRQ でのリセットを後から確かめる）なら
+// LOL が立っているのを一度見た PLL だけ時間を記録する。戻り値: ロックを確かめた PLL の mask
+static uint8_t pll_settle(uint8_t mask, bool timed) {
+    uint8_t wait = mask, locked = 0, seen = 0, st = 0;
+    while (wait) {
+        if (rd8(REG_STAT0, &st) != 0) break;
+        uint32_t now = time_us_32();
+        for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+            if (!((wait >> k) & 1u)) continue;
+            uint32_t dt = now - g_lock_t_reset[k];
+            if (st & pll_lol_bit(k)) {
+                seen |= (uint8_t)(1u << k);
+                if (dt < SI5351_LOCK_BUDGET_US) continue;
+            } else {
+                locked |= (uint8_t)(1u << k);
+                if (timed || ((seen >> k) & 1u)) lock_record(k, dt);
+            }
+            wait &= (uint8_t)~(1u << k);
+        }
+    }
+    g_lock_pending &= (uint8_t)~mask;
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+        if (!((mask >> k) & 1u) || ((locked >> k) & 1u)) continue;
+        g_lock[k].timeouts++;
+        serial_printf("WARN: PLL%c not locked %lu us after reset", 1, 'A' + k,
+                      (unsigned long)(time_us_32() - g_lock_t_reset[k]));
+    }
+    return locked;
+}
+
+// REG_PLL_RESET の bits（bit5=PLLA, bit7=PLLB）でリセットし, エンジン文脈ならロックまで待つ。
+// 戻り値: ロックを確かめた PLL の mask（bit k, IRQ 内では 0）
+static uint8_t SI5351_HOT(pll_reset)(uint8_t bits) {
+    if (wr8(REG_PLL_RESET, bits) != 0) return 0;
+    uint32_t t = timer_hw->timerawl;
+    uint8_t mask = 0;
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+        if (!(bits & pll_rst_bit(k))) continue;
+        g_lock_t_reset[k] = t;
+        mask |= (uint8_t)(1u << k);
+    }
+    if (g_in_irq) { g_lock_pending |= mask; return 0; }
+    return pll_settle(mask, true);
+}
+
+// 実測したロック時間の最大（未測定なら待ち上限）: 掃引・hop の最短滞在時間
+static uint32_t lock_dwell_us(void) {
+    uint32_t d = 0;
+    bool any = false;
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+        if (!g_lock[k].n) continue;
+        any = true;
+        if (g_lock[k].max_us > d) d = g_lock[k].max_us;
+    }
+    return any ? d : SI5351_LOCK_BUDGET_US;
+}
+
+static void lock_show(void) {
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+        const lock_stats_t *l = &g_lock[k];
+        if (!l->n && !l->timeouts) { serial_printf("PLL%c lock: no reset measured", 1, 'A' + k); continue; }
+        serial_printf("PLL%c lock: %lu reset(s), last %lu us, min/avg/max %lu/%lu/%lu us, %lu timeout(s)", 1,
+                      'A' + k, (unsigned long)l->n, (unsigned long)l->last_us, (unsigned long)l->min_us,
+                      (unsigned long)(l->n ? l->sum_us / l->n : 0), (unsigned long)l->max_us,
+                      (unsigned long)l->timeouts);
+    }
+    serial_printf("min dwell after a PLL reset: %lu us (%s)", 1, (unsigned long)lock_dwell_us(),
+                  (g_lock[0].n || g_lock[1].n) ? "measured" : "not measured yet, using lock budget");
+}
+
+// PLL 帰還像 d を書き込み、変化があった PLL だけリセットする
+static void SI5351_HOT(pll_apply_img)(uint8_t k, const uint8_t d[8], bool force) {
+    int n = wr_delta(k_pll_base[k], d, 8);
+    if (n < 0) { ENG_ERR("[I2C] WR FAIL PLL%c", 1, 'A' + k); return; }
+    if (n == 0 && !force) return;
+
+    fb_int_set(k, g_plan->pll[k].fb.b == 0);
+    (void)pll_reset(pll_rst_bit(k));
+}
+
+static void SI5351_HOT(pll_apply)(uint8_t k, bool force) {
+    uint8_t d[8];
+    si5351_encode_pll(&g_plan->pll[k].fb, d);
+    pll_apply_img(k, d, force);
+}
+
+// MS 像 d を書き込む（MS6/MS7 は 1 バイト形式なので採用候補から組み直す）
+static void ms_apply(unsigned ch);
+static void SI5351_HOT(ms_apply_img)(unsigned ch, const uint8_t d[8]) {
+    if (si5351_ms_is_compact(ch)) { ms_apply(ch); return; }
+    uint8_t base = si5351_reg_ms_base(ch);
+    if (wr_delta(base, d, 8) < 0) ENG_ERR("[I2C] WR FAIL MS@0x%02X", 1, base);
+}
+
+static void SI5351_HOT(ms_apply)(unsigned ch) {
+    const si5351_cand_t *c = &g_plan->ch[ch].sel;
+    uint8_t base = si5351_reg_ms_base(ch);
+
+    if (si5351_ms_is_compact(ch)) {
+        // MS6/MS7: 分周比そのもの 1 バイト + R6/R7 は 0x5C に同居
+        uint8_t div = (uint8_t)c->ms.a, r = 0;
+        if (wr_delta(base, &div, 1) < 0) return;
+        if (rd8_cached(SI5351_REG_R67_DIV, &r) != 0) return;
+        unsigned sh = (ch == 6) ? 0 : 4;
+        r = (uint8_t)((r & ~(0x07u << sh)) | ((c->r_log2 & 0x07u) << sh));
+        (void)wr_delta(SI5351_REG_R67_DIV, &r, 1);
+        return;
+    }
+
+    uint8_t d[8];
+    si5351_encode_ms(&c->ms, c->r_log2, (c->flags & SI5351_CF_DIVBY4) != 0, d);
+    ms_apply_img(ch, d);
+}
+
+// CLKx_CTRL = PD | MS_INT | MS_SRC | INV | CLK_SRC(=MultiSynth) | IDRV
+static uint8_t SI5351_HOT(clk_ctrl_compose)(unsigned ch) {
+    const clk_cfg_t *cf = &g_clk_cfg[ch];
+    uint8_t v = 0x0C;                                   // CLK_SRC=11（MultiSynth）
+    v |= (uint8_t)((cf->drive_ma / 2u - 1u) & 0x03);    // 2/4/6/8mA → 0..3
+    if (cf->invert)   v |= 0x10;
+    if (!cf->powered) v |= 0x80;
+    if (g_plan->ch[ch].active) {
+        const si5351_cand_t *c = &g_plan->ch[ch].sel;
+        if ((c->flags & SI5351_CF_EVEN_MS) && !si5351_ms_is_compact(ch)) v |= 0x40;
+        if (c->pll) v |= 0x20;
+    }
+    // CLK6/7_CTRL の bit6 は FBA_INT/FBB_INT なので現在値を保持
+    if (si5351_ms_is_compact(ch)) {
+        uint8_t cur = 0;
+        if (rd8_cached(si5351_reg_clk_ctrl(ch), &cur) == 0) v |= (uint8_t)(cur & 0x40);
+    }
+    return v;
+}
+
+// 変化したときだけ CLKx_CTRL を書く
+static void SI5351_HOT(clk_ctrl_update)(unsigned ch) {
+    uint8_t v = clk_ctrl_compose(ch);
+    int n = wr_delta(si5351_reg_clk_ctrl(ch), &v, 1);
+    if (n > 0) g_ctrl_writes++;
+    else if (n == 0) g_ctrl_skips++;
+}
+
+static void dis_state_update(void) {
+    for (unsigned base = 0; base < g_chip->n_out; base += 4) {
+        uint8_t reg = si5351_reg_dis_state(base), v = 0;
+        if (rd8_cached(reg, &v) != 0) return;
+        for (unsigned ch = base; ch < base + 4 && ch < g_chip->n_out; ch++) {
+            unsigned sh = 2 * (ch & 3);
+            v = (uint8_t)(v & ~(0x03u << sh));
+            v = (uint8_t)(v | ((g_clk_cfg[ch].dis_state & 0x03u) << sh));
+        }
+        (void)wr_delta(reg, &v, 1);
+    }
+}
+
+static void clk_ctrl_set(uint8_t reg_clk_ctrl, uint8_t val) {
+    // 0x4F: Power ON / PLLA / integer / 非反転 / 8mA
+    (void)wr8(reg_clk_ctrl, val);
+}
+
+static void oe_mask_all(uint8_t mask) {
+    // mask=0xFF 全OFF, mask=0xFE CLK0のみON, etc.
+    (void)wr8(REG_OE, mask);
+}
+
+// ===== 基準入力 =====
+static uint32_t ref_pfd_hz(void) {
+    return (g_ref_src == REF_CLKIN) ? (g_clkin_hz >> g_clkin_div_log2) : SI5351_XTAL_HZ;
+}
+
+// レジスタ 15: CLKIN_DIV(7:6) / PLLB_SRC(3) / PLLA_SRC(2)
+static void ref_apply_regs(void) {
+    uint8_t v = 0;
+    if (g_ref_src == REF_CLKIN) v = (uint8_t)((g_clkin_div_log2 << 6) | 0x0C);
+    (void)wr_delta(SI5351_REG_PLL_SRC, &v, 1);
+}
+
+// ===== チップ初期化 =====
+static void si5351_init_basic(void) {
+    // 0) チップ側の状態は不明なのでシャドウを破棄
+    shadow_invalidate();
+
+    // 1) まず全出力OFF（OE全閉）
+    oe_mask_all(0xFF);
+
+    // 2) 水晶負荷キャパシタ（8 pF）
+    wr8(REG_CRYSTAL_LOAD, 0b10000000); //wr8(REG_CRYSTAL_LOAD, 0b11000000);
+
+    // 3) プランを白紙に戻し CLK0=100MHz を計画（偶数整数 MS → PLLA=800MHz）
+    si5351_plan_init(g_plan);
+    si5351_plan_set_chip(g_plan, g_chip);
+    (void)si5351_plan_set_ref(g_plan, ref_pfd_hz());
+    ref_apply_regs();
+    if (si5351_plan_channel(g_plan, 0, 100000000UL) != 0) {
+        serial_printf("[PLAN] CLK0=100MHz failed", 1);
+        return;
+    }
+    const si5351_cand_t *c0 = &g_plan->ch[0].sel;
+
+    // 4) PLL 書き込み（シャドウを破棄したので全バイト書かれ, 使う PLL だけリセット）→ MS0 → CLK0_CTRL
+    pll_apply(c0->pll, false);
+    ms_apply(0);
+    g_clk_cfg[0].powered = true;
+    clk_ctrl_update(0);
+
+    // 5) CLK1以降は停止構成にしておく（PD=1）
+    for (unsigned ch = 1; ch < g_chip->n_out; ch++) {
+        g_clk_cfg[ch].powered = false;
+        g_parked_valid[ch] = false;
+        clk_ctrl_update(ch);
+    }
+    dis_state_update();
+
+    // 6) CLK0のみ出力ON
+    oe_mask_all(0xFE); // bit0=0 → CLK0有効
+
+    serial_printf("Si5351%s initialized (PLL%c=%lu MHz, CLK0=100 MHz, CLK1..%u off)", 1,
+                  g_chip->name, 'A' + c0->pll, (unsigned long)(g_plan->pll[c0->pll].vco_hz / 1e6 + 0.5),
+                  g_chip->n_out - 1u);
+}
+
+// ===== 周波数設定（プランナ経由, Hz 単位） =====
+// 停止：OEビットを立て、プランから外す（AUTO なら PD=1 で MS/ドライバも停止）。表示なし
+static void SI5351_HOT(freq_off)(unsigned ch) {
+    uint8_t oe=0xFF; rd8_cached(REG_OE,&oe);
+    oe |= (1u<<ch); wr8(REG_OE, oe);
+    if (g_plan->ch[ch].active) {
+        g_parked[ch] = g_plan->ch[ch].sel;
+        g_parked_valid[ch] = true;
+    }
+    si5351_plan_release(g_plan, ch);
+    if (g_power_policy == PWR_AUTO) {
+        g_clk_cfg[ch].powered = false;
+        clk_ctrl_update(ch);
+    }
+}
+
+// 採用済みプランを書き込んで ch を有効化する。像が NULL ならプランから組み立てる。表示なし
+static void SI5351_HOT(freq_commit)(unsigned ch, const uint8_t *pll_img, const uint8_t *ms_img) {
+    const si5351_cand_t *c = &g_plan->ch[ch].sel;
+    g_parked_valid[ch] = false;
+    if (pll_img) pll_apply_img(c->pll, pll_img, false); else pll_apply(c->pll, false);
+    if (ms_img)  ms_apply_img(ch, ms_img);              else ms_apply(ch);
+    g_clk_cfg[ch].powered = true;
+    clk_ctrl_update(ch);
+
+    // OEで ch を有効化
+    uint8_t oe=0xFF; rd8_cached(REG_OE,&oe);
+    oe &= ~(1u<<ch); wr8(REG_OE, oe);
+}
+
+// ===== 追従（track <master> <slave> <offset_Hz>） =====
+// master を設定し直すたびに slave = master + offset を一緒に解き、まとめて書く。
+// slave は 1 つの master にだけ従い, master は他の slave にならない（連鎖なし）。
+#define TRACK_NONE  0xFF
+
+static uint8_t g_track_master[SI5351_MAX_OUT] = {
+    TRACK_NONE, TRACK_NONE, TRACK_NONE, TRACK_NONE, TRACK_NONE, TRACK_NONE, TRACK_NONE, TRACK_NONE,
+};
+static int32_t g_track_off[SI5351_MAX_OUT];
+
+// 複数チャネルをまとめて解き直す間の退避（エンジン文脈のみ, 失敗したら戻す）
+static si5351_pll_plan_t g_save_pll[SI5351_NUM_PLL];
+static si5351_ch_plan_t  g_save_ch[SI5351_MAX_OUT];
+
+static void plan_save(void) {
+    memcpy(g_save_pll, g_plan->pll, sizeof(g_save_pll));
+    memcpy(g_save_ch, g_plan->ch, sizeof(g_save_ch));
+}
+
+static void plan_restore(void) {
+    memcpy(g_plan->pll, g_save_pll, sizeof(g_save_pll));
+    memcpy(g_plan->ch, g_save_ch, sizeof(g_save_ch));
+}
+
+// plan_save() 以降に PLL/MS/R が変わった ch 以外の使用中チャネル
+static uint8_t plan_moved(unsigned ch) {
+    uint8_t mask = 0;
+    for (unsigned c = 0; c < g_chip->n_out; c++) {
+        if (c == ch || !g_plan->ch[c].active) continue;
+        const si5351_cand_t *a = &g_plan->ch[c].sel, *b = &g_save_ch[c].sel;
+        if (a->pll != b->pll || a->r_log2 != b->r_log2 ||
+            memcmp(&a->fb, &b->fb, sizeof(a->fb)) != 0 || memcmp(&a->ms, &b->ms, sizeof(a->ms)) != 0)
+            mask |= (uint8_t)(1u << c);
+    }
+    return mask;
+}
+
+static uint8_t track_slaves(unsigned m) {
+    uint8_t mask = 0;
+    for (unsigned s = 0; s < g_chip->n_out; s++)
+        if (g_track_master[s] == m) mask |= (uint8_t)(1u << s);
+    return mask;
+}
+
+static bool track_hz(unsigned s, uint32_t master_hz, uint32_t *hz) {
+    int64_t f = (int64_t)master_hz + g_track_off[s];
+    if (f < (int64_t)SI5351_OUT_MIN_HZ || f > (int64_t)SI5351_OUT_MAX_HZ) return false;
+    *hz = (uint32_t)f;
+    return true;
+}
+
+// mask のチャネルをまとめて書く: 使う PLL → MS（隣り合うチャネルは 1 バースト）→ CLKx_CTRL（同）→ OE
+// 戻り値: 0=成功, 負=PLL/MS の書込み失敗（そのときは CLKx_CTRL・OE を書かない）
+static int group_commit(uint8_t mask) {
+    uint8_t plls = 0;
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++)
+        if ((mask >> ch) & 1u) plls |= (uint8_t)(1u << g_plan->ch[ch].sel.pll);
+    uint32_t err0 = g_i2c_errors;
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++)
+        if ((plls >> k) & 1u) pll_apply(k, false);
+
+    uint8_t img[8 * SI5351_MAX_OUT];
+    for (unsigned ch = 0; ch < g_chip->n_out;) {
+        if (!((mask >> ch) & 1u)) { ch++; continue; }
+        g_parked_valid[ch] = false;
+        g_clk_cfg[ch].powered = true;
+        if (si5351_ms_is_compact(ch)) { ms_apply(ch); ch++; continue; }
+        unsigned n = 0;
+        while (ch + n < g_chip->n_out && ((mask >> (ch + n)) & 1u) && !si5351_ms_is_compact(ch + n)) {
+            const si5351_cand_t *c = &g_plan->ch[ch + n].sel;
+            g_parked_valid[ch + n] = false;
+            g_clk_cfg[ch + n].powered = true;
+            si5351_encode_ms(&c->ms, c->r_log2, (c->flags & SI5351_CF_DIVBY4) != 0, &img[8 * n]);
+            n++;
+        }
+        if (wr_delta(si5351_reg_ms_base(ch), img, (uint8_t)(8 * n)) < 0)
+            ENG_ERR("[I2C] WR FAIL MS@0x%02X", 1, si5351_reg_ms_base(ch));
+        ch += n;
+    }
+    if (g_i2c_errors != err0) return -1;        // 古い分周比のまま出力を有効にしない
+    for (unsigned ch = 0; ch < g_chip->n_out;) {
+        if (!((mask >> ch) & 1u)) { ch++; continue; }
+        unsigned n = 0;
+        while (ch + n < g_chip->n_out && ((mask >> (ch + n)) & 1u)) { img[n] = clk_ctrl_compose(ch + n); n++; }
+        int w = wr_delta(si5351_reg_clk_ctrl(ch), img, (uint8_t)n);
+        if (w > 0) g_ctrl_writes++;
+        else if (w == 0) g_ctrl_skips++;
+        ch += n;
+    }
+
+    uint8_t oe = 0xFF;
+    rd8_cached(REG_OE, &oe);
+    oe &= (uint8_t)~mask;
+    return wr_delta(REG_OE, &oe, 1) < 0 ? -1 : 0;
+}
+
+// master と全 slave を一緒に解いて書く。解けなければプランを戻して何も書かない
+static void track_retune(unsigned m, uint32_t hz) {
+    uint8_t slaves = track_slaves(m), mask = (uint8_t)(slaves | (1u << m));
+    uint32_t shz[SI5351_MAX_OUT];
+    for (unsigned s = 0; s < g_chip->n_out; s++) {
+        if (!((slaves >> s) & 1u)) continue;
+        if (!track_hz(s, hz, &shz[s])) {
+            serial_printf("ERR: CLK%u would be %lld Hz (track offset %+ld Hz)", 1, s,
+                          (long long)hz + g_track_off[s], (long)g_track_off[s]);
+            return;
+        }
+    }
+
+    // slave を外してから master を解く（master は slave と共有していた PLL も動かせる）
+    plan_save();
+    for (unsigned s = 0; s < g_chip->n_out; s++)
+        if ((slaves >> s) & 1u) si5351_plan_release(g_plan, s);
+    int rc = si5351_plan_channel(g_plan, m, hz);
+    unsigned bad = m;
+    for (unsigned s = 0; s < g_chip->n_out && rc == 0; s++)
+        if ((slaves >> s) & 1u) { rc = si5351_plan_channel(g_plan, s, shz[s]); bad = s; }
+    if (rc != 0) {
+        plan_restore();
+        serial_printf("ERR: no plan for CLK%u (rc=%d), tracking group unchanged", 1, bad, rc);
+        return;
+    }
+
+    uint32_t bytes0 = g_bus_bytes, t0 = time_us_32();
+    int wr = group_commit(mask);
+    uint32_t dt = time_us_32() - t0;
+    if (wr < 0) {
+        serial_printf("ERR: track write failed, CLKx_CTRL/OE left unchanged (run clk again)", 1);
+        return;
+    }
+    unsigned n = 0;
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        if (!((mask >> ch) & 1u)) continue;
+        n++;
+        const si5351_cand_t *c = &g_plan->ch[ch].sel;
+        if (ch == m) serial_printf("CLK%u = %lu Hz (PLL%c, err=%.3f ppb)", 1, ch, (unsigned long)c->target_hz,
+                                   'A' + c->pll, c->err_ppb);
+        else serial_printf("CLK%u = %lu Hz (PLL%c, err=%.3f ppb, track CLK%u %+ld Hz)", 1, ch,
+                           (unsigned long)c->target_hz, 'A' + c->pll, c->err_ppb, m, (long)g_track_off[ch]);
+    }
+    serial_printf("track: %u channel(s), %lu byte(s) in %lu us", 1, n,
+                  (unsigned long)(g_bus_bytes - bytes0), (unsigned long)dt);
+}
+
+static void track_show(void) {
+    bool any = false;
+    for (unsigned s = 0; s < g_chip->n_out; s++) {
+        if (g_track_master[s] == TRACK_NONE) continue;
+        any = true;
+        serial_printf("track: CLK%u = CLK%u %+ld Hz", 1, s, g_track_master[s], (long)g_track_off[s]);
+    }
+    if (!any) serial_printf("track: none", 1);
+}
+
+// slave=NONE なら全解除, master=NONE なら slave の解除
+static void track_set(uint8_t m, uint8_t s, int32_t off) {
+    if (s == SI5351_OP_ARG_NONE) {
+        memset(g_track_master, TRACK_NONE, sizeof(g_track_master));
+        track_show();
+        return;
+    }
+    if (!ch_ok(s)) return;
+    if (m == SI5351_OP_ARG_NONE) { g_track_master[s] = TRACK_NONE; track_show(); return; }
+    if (!ch_ok(m)) return;
+    if (m == s) { serial_printf("ERR: a channel cannot track itself", 1); return; }
+    if (g_track_master[m] != TRACK_NONE) { serial_printf("ERR: CLK%u already tracks CLK%u (no chains)", 1, m, g_track_master[m]); return; }
+    if (track_slaves(s)) { serial_printf("ERR: CLK%u is a track master (no chains)", 1, s); return; }
+    g_track_master[s] = m;
+    g_track_off[s] = off;
+    track_show();
+    if (g_plan->ch[m].active) track_retune(m, g_plan->ch[m].sel.target_hz);
+}
+
+static void si5351_set_freq_ch(unsigned ch, uint32_t freq_hz) {
+    if (ch >= g_chip->n_out) { serial_printf("ERR: ch=%u (use 0..%u)", 1, ch, g_chip->n_out - 1u); return; }
+
+    uint8_t slaves = track_slaves(ch);
+    if (slaves && freq_hz == 0) {
+        for (unsigned s = 0; s < g_chip->n_out; s++)
+            if ((slaves >> s) & 1u) freq_off(s);
+        freq_off(ch);
+        serial_printf("CLK%u and its tracking channel(s) disabled", 1, ch);
+        return;
+    }
+    if (slaves && freq_hz >= SI5351_OUT_MIN_HZ && freq_hz <= SI5351_OUT_MAX_HZ) { track_retune(ch, freq_hz); return; }
+
+    if (freq_hz == 0) {
+        freq_off(ch);
+        serial_printf("CLK%u disabled%s", 1, ch, (g_power_policy == PWR_AUTO) ? " (powered down)" : "");
+        return;
+    }
+
+    if (freq_hz > SI5351_OUT_MAX_HZ) { serial_printf("Freq too high (<150 MHz)", 1); return; }
+    if (freq_hz < SI5351_OUT_MIN_HZ) { serial_printf("Freq too low (>=2.5 kHz)", 1); return; }
+
+    // 停止前と同じ周波数なら保存済み候補を再利用（シャドウ上の MS 像がそのまま使える）
+    uint32_t bytes0 = g_bus_bytes;
+    bool reused = !g_plan->ch[ch].active && g_parked_valid[ch] &&
+                  g_parked[ch].target_hz == freq_hz &&
+                  si5351_plan_adopt(g_plan, ch, &g_parked[ch]) == 0;
+    uint8_t moved = 0;
+    if (!reused) {
+        int rc = si5351_plan_channel(g_plan, ch, freq_hz);
+        if (rc == -2) {
+            // 両 PLL が他チャネルの VCO で埋まっている: 他チャネルごと解き直し, 変わったチャネルも書く
+            plan_save();
+            rc = si5351_plan_replan(g_plan, ch, freq_hz);
+            if (rc != 0) plan_restore();
+            else moved = plan_moved(ch);
+        }
+        if (rc != 0) { serial_printf("ERR: no plan for %lu Hz (rc=%d)", 1, (unsigned long)freq_hz, rc); return; }
+    }
+    if (moved) {
+        if (group_commit((uint8_t)(moved | (1u << ch))) < 0) {
+            serial_printf("ERR: re-plan write failed, CLKx_CTRL/OE left unchanged (run clk again)", 1);
+            return;
+        }
+        serial_printf("re-planned to fit CLK%u, moved:", 0, ch);
+        for (unsigned m = 0; m < g_chip->n_out; m++) {
+            if (!((moved >> m) & 1u)) continue;
+            const si5351_cand_t *c = &g_plan->ch[m].sel;
+            serial_printf(" CLK%u(PLL%c)", 0, m, 'A' + c->pll);
+        }
+        serial_printf("", 1);
+    } else {
+        freq_commit(ch, NULL, NULL);
+    }
+
+    const si5351_cand_t *c = &g_plan->ch[ch].sel;
+    if (reused) serial_printf("CLK%u re-enabled from cached image (%lu byte(s) written)", 1, ch,
+                              (unsigned long)(g_bus_bytes - bytes0));
+    serial_printf("CLK%u = %lu Hz (PLL%c, MS=%lu+%lu/%lu, R=%u, err=%.3f ppb)", 1, ch,
+                  (unsigned long)freq_hz, 'A' + c->pll,
+                  (unsigned long)c->ms.a, (unsigned long)c->ms.b, (unsigned long)c->ms.c,
+                  1u << c->r_log2, c->err_ppb);
+}
+
+// プランを失ったチャネルを止めて電源を切り, 名前を続けて表示する（行頭は呼び出し側）
+static void stop_lost(uint8_t lost) {
+    uint8_t oe = 0xFF;
+    rd8_cached(REG_OE, &oe);
+    oe |= lost;
+    (void)wr_delta(REG_OE, &oe, 1);
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        if (!((lost >> ch) & 1u)) continue;
+        g_parked_valid[ch] = false;
+        g_clk_cfg[ch].powered = false;
+        clk_ctrl_update(ch);
+        serial_printf(" CLK%u", 0, ch);
+    }
+    serial_printf("", 1);
+}
+
+// ===== 基準入力の切替（プランは基準ごとにキャッシュ） =====
+static void si5351_set_ref(ref_src_t src, uint32_t clkin_hz) {
+    if (src == REF_CLKIN) {
+        if (!g_chip->has_clkin) { serial_printf("ERR: CLKIN needs Si5351C (chip c)", 1); return; }
+        if (clkin_hz < SI5351_CLKIN_MIN_HZ || clkin_hz > SI5351_CLKIN_MAX_HZ) {
+            serial_printf("ERR: CLKIN %lu Hz out of range (10..100 MHz)", 1, (unsigned long)clkin_hz);
+            return;
+        }
+        // PLL 入力が 40 MHz 以下になる最小の CLKIN_DIV
+        uint8_t div = 0;
+        while (div < 3 && (clkin_hz >> div) > SI5351_PFD_MAX_HZ) div++;
+        g_clkin_hz = clkin_hz;
+        g_clkin_div_log2 = div;
+    }
+    g_ref_src = src;
+
+    uint8_t was = 0, lost = 0, fined = 0;
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        if (g_plan->ch[ch].active) was |= (uint8_t)(1u << ch);
+        if (g_plan->ch[ch].active && g_plan->ch[ch].fine_hz != 0.0) fined |= (uint8_t)(1u << ch);
+    }
+    uint32_t t0 = time_us_32();
+    int rc = si5351_plan_set_ref(g_plan, ref_pfd_hz());
+    uint32_t dt = time_us_32() - t0;
+
+    // 新しい基準で解けなかったチャネルは, PLL を書き換える前に止める（古い MS のまま誤った周波数を出さない）
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++)
+        if (((was >> ch) & 1u) && !g_plan->ch[ch].active) lost |= (uint8_t)(1u << ch);
+    if (lost) {
+        serial_printf("WARN: no plan at new reference (rc=%d), stopped:", 0, rc);
+        stop_lost(lost);
+    }
+    // fine のオフセットをかけ直せなかったチャネル（目標周波数のまま出す）
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        if (!((fined >> ch) & 1u) || !g_plan->ch[ch].active || g_plan->ch[ch].fine_hz != 0.0) continue;
+        serial_printf("WARN: CLK%u fine offset dropped at new reference (PLL shared or VCO out of range)", 1, ch);
+    }
+
+    // 入力源を切り替えてから使用中 PLL を再設定（入力が変わるので必ずリセット）
+    ref_apply_regs();
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++)
+        if (g_plan->pll[k].users) pll_apply(k, true);
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        if (!g_plan->ch[ch].active) continue;
+        ms_apply(ch);
+        clk_ctrl_update(ch);
+    }
+    serial_printf("REF = %s %lu Hz (PLL input %lu Hz), plan %s in %lu us", 1,
+                  (src == REF_CLKIN) ? "CLKIN" : "XTAL",
+                  (unsigned long)((src == REF_CLKIN) ? g_clkin_hz : SI5351_XTAL_HZ),
+                  (unsigned long)ref_pfd_hz(), (rc == 1) ? "restored from cache" : "re-solved",
+                  (unsigned long)dt);
+}
+
+// ===== PLL 微調整（MS 固定, PLL 帰還の分数のみ変更, リセットなし） =====
+static void si5351_fine_ch(unsigned ch, double offset_hz) {
+    if (ch >= g_chip->n_out) { serial_printf("ERR: ch=%u (use 0..%u)", 1, ch, g_chip->n_out - 1u); return; }
+
+    int rc = si5351_plan_fine(g_plan, ch, offset_hz);
+    if (rc == -1) { serial_printf("ERR: CLK%u not planned (use clk first)", 1, ch); return; }
+    if (rc == -3) { serial_printf("ERR: PLL shared with other CLK (fine would move them)", 1); return; }
+    if (rc == -4) { serial_printf("ERR: VCO out of range (600..900 MHz)", 1); return; }
+    if (rc != 0)  { serial_printf("ERR: fine failed (rc=%d)", 1, rc); return; }
+
+    const si5351_cand_t *c = &g_plan->ch[ch].sel;
+    uint8_t d[8];
+    si5351_encode_pll(&c->fb, d);
+    // 分数化するときは先に FB_INT を落とす（旧値は整数なので周波数は変わらない）
+    if (c->fb.b != 0) fb_int_set(c->pll, false);
+    int n = wr_delta(k_pll_base[c->pll], d, 8);
+    if (n < 0) return;
+
+    serial_printf("CLK%u fine %+.3f Hz -> %.3f Hz (PLL%c fb=%lu+%lu/%lu, %d byte(s), no reset)", 1,
+                  ch, offset_hz, c->actual_hz, 'A' + c->pll,
+                  (unsigned long)c->fb.a, (unsigned long)c->fb.b, (unsigned long)c->fb.c, n);
+}
+
+// ===== 出力設定表示 =====
+const char *const si5351_dis_state_name[4] = { "low", "high", "hiz", "never" };
+
+static void cmd_cfg_show(void) {
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        const clk_cfg_t *cf = &g_clk_cfg[ch];
+        uint8_t v = clk_ctrl_compose(ch);
+        serial_printf("CLK%u: drive=%umA invert=%s idle=%s power=%s CTRL=0x%02X%s", 1, ch,
+                      cf->drive_ma, cf->invert ? "on" : "off", si5351_dis_state_name[cf->dis_state & 3],
+                      cf->powered ? "on" : "down", v,
+                      (shadow_has(si5351_reg_clk_ctrl(ch)) && g_shadow[si5351_reg_clk_ctrl(ch)] == v) ? "" : " (pending)");
+    }
+    serial_printf("CTRL writes=%lu skipped=%lu", 1,
+                  (unsigned long)g_ctrl_writes, (unsigned long)g_ctrl_skips);
+}
+
+// ===== 消費電流見積り =====
+// 目安値（VDD=VDDO=3.3V, CL=5pF, 25MHz XTAL）。実測で校正すること。
+#define PWR_CORE_UA        10000u   // XO + PLL 2 系統 + デジタル（Si5351A は PLL 単独停止不可）
+#define PWR_MS_UA          1500u    // MultiSynth 1 個（PD=0）
+#define PWR_DRV_UA_PER_2MA 400u     // 出力ドライバ静的分（2mA 設定あたり）
+#define PWR_CL_PF          5u       // 負荷容量（動的分 C*V*f）
+
+static uint32_t power_estimate_ch_ua(unsigned ch) {
+    const clk_cfg_t *cf = &g_clk_cfg[ch];
+    if (!cf->powered) return 0;
+    uint32_t ua = PWR_MS_UA;
+    bool enabled = shadow_has(REG_OE) ? !((g_shadow[REG_OE] >> ch) & 1u) : true;
+    if (enabled) {
+        ua += PWR_DRV_UA_PER_2MA * (cf->drive_ma / 2u);
+        if (g_plan->ch[ch].active)   // C*V*f [uA] = pF * V * MHz
+            ua += (uint32_t)((double)PWR_CL_PF * 3.3 * g_plan->ch[ch].sel.actual_hz / 1e6);
+    }
+    return ua;
+}
+
+static void cmd_power_show(void) {
+    uint32_t total = PWR_CORE_UA;
+    serial_printf("power policy: %s", 1, (g_power_policy == PWR_AUTO) ? "auto (PD idle outputs)" : "oe (OE only)");
+    serial_printf("  core (XO+PLLA/B): %5lu uA  PLLA users=0x%02X PLLB users=0x%02X%s", 1,
+                  (unsigned long)PWR_CORE_UA, g_plan->pll[0].users, g_plan->pll[1].users,
+                  g_plan->pll[1].users ? "" : " (PLLB idle, not reprogrammed)");
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        uint32_t ua = power_estimate_ch_ua(ch);
+        total += ua;
+        serial_printf("  CLK%u: %5lu uA (%s)", 1, ch, (unsigned long)ua,
+                      !g_clk_cfg[ch].powered ? "powered down" :
+                      g_plan->ch[ch].active ? "running" : "idle, MS on");
+    }
+    serial_printf("  total ~ %.1f mA (estimate)", 1, total / 1000.0);
+}
+
+// ===== プラン表示 =====
+static void print_cand(const char *tag, const si5351_cand_t *c) {
+    serial_printf("%s PLL%c fb=%lu+%lu/%lu MS=%lu+%lu/%lu R=%u f=%.3f Hz err=%.3f ppb score=%lu%s%s%s", 1,
+                  tag, 'A' + c->pll,
+                  (unsigned long)c->fb.a, (unsigned long)c->fb.b, (unsigned long)c->fb.c,
+                  (unsigned long)c->ms.a, (unsigned long)c->ms.b, (unsigned long)c->ms.c,
+                  1u << c->r_log2, c->actual_hz, c->err_ppb, (unsigned long)c->score,
+                  (c->flags & SI5351_CF_EVEN_MS) ? " even-int" :
+                  (c->flags & SI5351_CF_INT_MS)  ? " int"      : " frac-ms",
+                  (c->flags & SI5351_CF_INT_PLL) ? " int-pll"  : " frac-pll",
+                  (c->flags & SI5351_CF_NEW_PLL) ? " new-vco"  : "");
+}
+
+static void cmd_plan_show(void) {
+    for (unsigned k = 0; k < SI5351_NUM_PLL; k++) {
+        const si5351_pll_plan_t *pl = &g_plan->pll[k];
+        if (!pl->users) { serial_printf("PLL%c: free", 1, 'A' + k); continue; }
+        serial_printf("PLL%c: VCO=%.3f Hz fb=%lu+%lu/%lu users=0x%02X", 1, 'A' + k, pl->vco_hz,
+                      (unsigned long)pl->fb.a, (unsigned long)pl->fb.b, (unsigned long)pl->fb.c,
+                      pl->users);
+    }
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        char tag[8];
+        snprintf(tag, sizeof(tag), "CLK%u:", ch);
+        if (!g_plan->ch[ch].active) serial_printf("%s off", 1, tag);
+        else print_cand(tag, &g_plan->ch[ch].sel);
+    }
+    serial_printf("last solve: %lu us, %lu candidates%s, budget=%lu us", 1,
+                  (unsigned long)g_plan->last_elapsed_us, (unsigned long)g_plan->last_evaluated,
+                  g_plan->last_timed_out ? " (budget hit)" : "", (unsigned long)g_plan->budget_us);
+}
+
+static void cmd_plan_explain(unsigned ch) {
+    if (ch >= g_chip->n_out || !g_plan->ch[ch].active) {
+        serial_printf("CLK%u: no plan", 1, ch);
+        return;
+    }
+    serial_printf("CLK%u target=%lu Hz (%u candidates kept)", 1, ch,
+                  (unsigned long)g_plan->ch[ch].sel.target_hz, g_plan->n_runners[ch]);
+    for (unsigned i = 0; i < g_plan->n_runners[ch]; i++) {
+        char tag[8];
+        snprintf(tag, sizeof(tag), " #%u", i);
+        print_cand(tag, &g_plan->runners[ch][i]);
+    }
+}
+
+// ===== 事前準備済み周波数設定（予約・トリガ共通, IRQ から書ける） =====
+typedef struct {
+    uint8_t       ch;
+    uint32_t      hz;           // 0=停止
+    si5351_cand_t cand;
+    uint8_t       pll_img[8], ms_img[8];
+} stage_t;
+
+// エンジン文脈: 現在のプランに対して求解しレジスタ像を作る（プランは変えない）
+static int stage_prepare(stage_t *st, unsigned ch, uint32_t hz) {
+    memset(st, 0, sizeof(*st));
+    if (ch >= g_chip->n_out) return -1;
+    st->ch = (uint8_t)ch;
+    st->hz = hz;
+    if (hz == 0) return 0;
+    int rc = si5351_plan_probe(g_plan, ch, hz, &st->cand);
+    if (rc != 0) return rc;
+    si5351_encode_pll(&st->cand.fb, st->pll_img);
+    si5351_encode_ms(&st->cand.ms, st->cand.r_log2, (st->cand.flags & SI5351_CF_DIVBY4) != 0, st->ms_img);
+    return 0;
+}
+
+// 書き込む（IRQ 文脈可: 表示しない）。戻り値: 0=事前解を書いた, 1=解き直して書いた, STAGE_DEFER=IRQ で事前解が古い（何も書かない）, 負=失敗
+#define STAGE_DEFER 2
+static int SI5351_HOT(stage_commit)(const stage_t *st) {
+    if (st->hz == 0) { freq_off(st->ch); return 0; }
+
+    // 準備後に PLL が動いていれば事前解は使えないのでその場で解き直す。
+    // ソルバ（フラッシュ上, 最大 SI5351_PLAN_BUDGET_US）は IRQ では回さず, 呼び出し側がエンジン文脈へ回す
+    if (si5351_plan_adopt(g_plan, st->ch, &st->cand) == 0) {
+        freq_commit(st->ch, (st->cand.flags & SI5351_CF_NEW_PLL) ? st->pll_img : NULL, st->ms_img);
+        return 0;
+    }
+    if (g_in_irq) return STAGE_DEFER;
+    int rc = si5351_plan_channel(g_plan, st->ch, st->hz);
+    if (rc != 0) return rc;
+    freq_commit(st->ch, NULL, NULL);
+    return 1;
+}
+
+// ===== 予約実行（at <us> <command>） =====
+typedef struct {
+    si5351_op_t   op;
+    uint64_t      t_us;
+    uint32_t      id;
+    bool          staged;       // FREQ: 事前求解・レジスタ像作成済み（アラーム IRQ から書ける）
+    stage_t       st;
+} at_entry_t;
+
+// 実行記録（IRQ で書き, エンジン文脈で表示）
+#define AT_LOG_LEN  8
+enum { AT_HOW_STAGED = 0, AT_HOW_RESOLVED, AT_HOW_ENGINE };
+typedef struct {
+    uint32_t id;
+    uint8_t  code, ch, how;
+    int8_t   rc;
+    uint32_t hz;
+    uint64_t t_sched, t_fire;
+    uint32_t exec_us;
+} at_result_t;
+
+static si5351_sched_t    g_sched;
+static at_entry_t       *g_at;               // SI5351_SCHED_MAX 件（アリーナ上）
+static at_result_t       g_at_log[AT_LOG_LEN];
+static volatile uint32_t g_at_log_head;     // 書いた件数
+static uint32_t          g_at_log_shown;    // 表示済み件数
+static uint32_t          g_at_next_id = 1;
+static int               g_alarm = -1;
+static volatile bool     g_at_due;          // IRQ が見送った期限到来エントリあり
+static uint64_t          g_at_prefix_t;     // 直前の SI5351_OP_AT の時刻
+static bool              g_at_prefix;
+
+static void engine_exec(const si5351_op_t *op);
+
+static void SI5351_HOT(at_fire)(at_entry_t *e) {
+    uint64_t t_fire = si5351_hot_time_us();
+    uint8_t ctx = si5351_trace_ctx;
+    si5351_trace_ctx = SI5351_TR_CTX_AT;
+    uint8_t how = AT_HOW_ENGINE;
+    int rc = 0;
+    uint32_t err0 = g_i2c_errors;
+    if (e->staged) {
+        rc = stage_commit(&e->st);
+        how = (rc == 1) ? AT_HOW_RESOLVED : AT_HOW_STAGED;
+        if (rc > 0) rc = 0;
+    } else {
+        engine_exec(&e->op);
+    }
+    if (rc == 0 && g_i2c_errors != err0) rc = -5;
+
+    at_result_t *r = &g_at_log[g_at_log_head % AT_LOG_LEN];
+    r->id      = e->id;
+    r->code    = e->op.code;
+    r->ch      = e->op.ch;
+    r->how     = how;
+    r->rc      = (int8_t)rc;
+    r->hz      = e->op.v.u;
+    r->t_sched = e->t_us;
+    r->t_fire  = t_fire;
+    r->exec_us = (uint32_t)(si5351_hot_time_us() - t_fire);
+    g_at_log_head++;
+    si5351_trace_ctx = ctx;
+}
+
+// 次の期限でアラームを設定。既に過ぎていれば true
+static bool SI5351_HOT(at_arm)(void) {
+    uint64_t t;
+    if (g_alarm < 0) return false;
+    if (!si5351_sched_peek(&g_sched, &t, NULL)) { hardware_alarm_cancel((uint)g_alarm); return false; }
+    return hardware_alarm_set_target((uint)g_alarm, from_us_since_boot(t));
+}
+
+// 期限到来分を実行。IRQ 文脈では事前準備済み（staged）のものだけ書く
+static void SI5351_HOT(at_service)(bool from_irq) {
+    do {
+        uint64_t t;
+        uint8_t slot;
+        while (si5351_sched_peek(&g_sched, &t, &slot) && t <= si5351_hot_time_us()) {
+            // IRQ では事前解がそのまま使えるものだけ書く（古ければエンジン文脈で解き直す）
+            const at_entry_t *e = &g_at[slot];
+            if (from_irq && (!e->staged || (e->st.hz && si5351_plan_adoptable(g_plan, e->st.ch, &e->st.cand) != 0))) {
+                g_at_due = true;
+                return;
+            }
+            (void)si5351_sched_pop(&g_sched);
+            at_fire(&g_at[slot]);
+            si5351_sched_free(&g_sched, slot);
+        }
+    } while (at_arm());
+}
+
+static void SI5351_HOT(at_alarm_irq)(uint alarm_num) {
+    (void)alarm_num;
+    if (g_busy) { g_at_due = true; return; }   // エンジン実行中は終了後に回す
+    g_in_irq = true;
+    at_service(true);
+    g_in_irq = false;
+}
+
+// エンジン文脈: 予約登録（FREQ はここで求解とレジスタ像作成を済ませる）
+static void at_schedule(const si5351_op_t *op, uint64_t t_us) {
+    if (op->code == SI5351_OP_AT) { serial_printf("ERR: nested at", 1); return; }
+
+    at_entry_t e;
+    memset(&e, 0, sizeof(e));
+    e.op = *op;
+    e.t_us = t_us;
+
+    // track の master は slave と一緒に解くのでエンジン文脈で実行する（IRQ からは書かない）
+    if (op->code == SI5351_OP_FREQ && !(op->ch < g_chip->n_out && track_slaves(op->ch))) {
+        int rc = stage_prepare(&e.st, op->ch, op->v.u);
+        if (rc != 0) {
+            serial_printf("ERR: at CLK%u %lu Hz not schedulable (rc=%d)", 1, op->ch, (unsigned long)op->v.u, rc);
+            return;
+        }
+        e.staged = true;
+    }
+
+    int slot = si5351_sched_push(&g_sched, t_us);
+    if (slot < 0) { serial_printf("ERR: schedule full (%u)", 1, SI5351_SCHED_MAX); return; }
+    e.id = g_at_next_id++;
+    g_at[slot] = e;
+    si5351_mem_use(g_mem_at, g_sched.n * (uint32_t)sizeof(at_entry_t));
+
+    uint64_t now = time_us_64();
+    serial_printf("at#%lu scheduled t=%llu us (%s%llu us)%s", 1, (unsigned long)e.id,
+                  (unsigned long long)t_us, t_us >= now ? "in " : "late by ",
+                  (unsigned long long)(t_us >= now ? t_us - now : now - t_us),
+                  e.staged ? " [pre-staged]" : "");
+    if (at_arm()) g_at_due = true;
+}
+
+static const char *const k_at_how[3] = { "pre-staged", "re-solved", "engine" };
+
+// 未表示の実行記録を出す（エンジン文脈）
+static void at_report(void) {
+    while (g_at_log_shown != g_at_log_head) {
+        if (g_at_log_head - g_at_log_shown > AT_LOG_LEN) g_at_log_shown = g_at_log_head - AT_LOG_LEN;
+        const at_result_t *r = &g_at_log[g_at_log_shown % AT_LOG_LEN];
+        long long late = (long long)(r->t_fire - r->t_sched);
+        if (r->code == SI5351_OP_FREQ)
+            serial_printf("at#%lu CLK%u=%lu Hz sched=%llu actual=%llu (%+lld us) write=%lu us %s%s", 1,
+                          (unsigned long)r->id, r->ch, (unsigned long)r->hz,
+                          (unsigned long long)r->t_sched, (unsigned long long)r->t_fire, late,
+                          (unsigned long)r->exec_us, k_at_how[r->how], r->rc ? " FAILED" : "");
+        else
+            serial_printf("at#%lu op=%u sched=%llu actual=%llu (%+lld us) exec=%lu us %s", 1,
+                          (unsigned long)r->id, r->code, (unsigned long long)r->t_sched,
+                          (unsigned long long)r->t_fire, late, (unsigned long)r->exec_us, k_at_how[r->how]);
+        g_at_log_shown++;
+    }
+}
+
+static void at_list(void) {
+    si5351_sched_t q = g_sched;     // 写しを時刻順に取り出す
+    serial_printf("now=%llu us, %u pending, alarm=%d", 1,
+                  (unsigned long long)time_us_64(), q.n, g_alarm);
+    int slot;
+    while ((slot = si5351_sched_pop(&q)) >= 0) {
+        const at_entry_t *e = &g_at[slot];
+        if (e->op.code == SI5351_OP_FREQ)
+            serial_printf("  at#%lu t=%llu CLK%u=%lu Hz%s", 1, (unsigned long)e->id,
+                          (unsigned long long)e->t_us, e->op.ch, (unsigned long)e->op.v.u,
+                          e->staged ? " [pre-staged]" : "");
+        else
+            serial_printf("  at#%lu t=%llu op=%u", 1, (unsigned long)e->id,
+                          (unsigned long long)e->t_us, e->op.code);
+    }
+}
+
+static void at_clear(void) {
+    unsigned n = g_sched.n;
+    int slot;
+    while ((slot = si5351_sched_pop(&g_sched)) >= 0) si5351_sched_free(&g_sched, (uint8_t)slot);
+    (void)at_arm();
+    serial_printf("at: %u pending cleared", 1, n);
+}
+
+// アラームはエンジンを実行するコアで確保する（IRQ がエンジンと同じコアで走るように）
+static void at_init(void) {
+    si5351_sched_init(&g_sched);
+    if (g_alarm < 0) g_alarm = hardware_alarm_claim_unused(false);
+    if (g_alarm >= 0) hardware_alarm_set_callback((uint)g_alarm, at_alarm_irq);
+}
+
+// ===== 外部トリガによるリスト送り（trig） =====
+// GPIO エッジの IRQ から次ステップの準備済みレジスタ像を直接書く（CLI・操作リングを経由しない）
+#ifndef SI5351_TRIG_STEPS
+#define SI5351_TRIG_STEPS   32
+#endif
+
+static stage_t          *g_trig_step;        // SI5351_TRIG_STEPS 件（アリーナ上）
+static uint8_t           g_trig_n, g_trig_ch;
+static volatile uint8_t  g_trig_idx;        // 次に出すステップ
+static int               g_trig_pin = -1;   // 負=未設定
+static uint32_t          g_trig_edge = GPIO_IRQ_EDGE_RISE;
+static volatile bool     g_trig_pending;    // エンジン実行中に来たエッジ（終了直後に書く）
+static volatile uint64_t g_trig_t_edge;
+
+typedef struct {
+    uint32_t edges, fired, deferred, overrun, resolved, failed;
+    uint32_t lat_last, lat_min, lat_max;
+    uint64_t lat_sum;
+} trig_stats_t;
+static volatile trig_stats_t g_trig_st;
+
+static void trig_stats_reset(void) {
+    memset((void *)&g_trig_st, 0, sizeof(g_trig_st));
+    g_trig_st.lat_min = UINT32_MAX;
+}
+
+// 次ステップを書く（IRQ 文脈可）。遅延はエッジ検出（IRQ 入口）から I2C STOP 検出まで
+static void SI5351_HOT(trig_fire)(uint64_t t_edge) {
+    if (g_trig_n == 0) return;
+    uint32_t err0 = g_i2c_errors;
+    uint8_t ctx = si5351_trace_ctx;
+    si5351_trace_ctx = SI5351_TR_CTX_TRIG;
+    int rc = stage_commit(&g_trig_step[g_trig_idx]);
+    uint32_t lat = (uint32_t)(si5351_hot_time_us() - t_edge);   // i2c_write は STOP 検出後に戻る
+    si5351_trace_ctx = ctx;
+    if (rc == STAGE_DEFER) {
+        // IRQ で事前解が古い: このステップはエンジン文脈で解き直して書く
+        if (g_trig_pending) { g_trig_st.overrun++; return; }
+        g_trig_t_edge = t_edge;
+        g_trig_pending = true;
+        g_trig_st.deferred++;
+        return;
+    }
+
+    if (rc < 0 || g_i2c_errors != err0) g_trig_st.failed++;
+    else if (rc == 1) g_trig_st.resolved++;
+    g_trig_st.fired++;
+    g_trig_st.lat_last = lat;
+    g_trig_st.lat_sum += lat;
+    if (lat < g_trig_st.lat_min) g_trig_st.lat_min = lat;
+    if (lat > g_trig_st.lat_max) g_trig_st.lat_max = lat;
+    g_trig_idx = (uint8_t)((g_trig_idx + 1u < g_trig_n) ? g_trig_idx + 1u : 0u);
+}
+
+static void SI5351_HOT(trig_gpio_irq)(uint gpio, uint32_t events) {
+    uint64_t t = si5351_hot_time_us();
+    if ((int)gpio != g_trig_pin || !(events & g_trig_edge)) return;
+    g_trig_st.edges++;
+    if (g_busy) {
+        // エンジン実行中: 1 エッジだけ保留し、それ以上は取りこぼしとして数える
+        if (g_trig_pending) { g_trig_st.overrun++; return; }
+        g_trig_t_edge = t;
+        g_trig_pending = true;
+        g_trig_st.deferred++;
+        return;
+    }
+    g_in_irq = true;
+    trig_fire(t);
+    g_in_irq = false;
+}
+
+static void trig_load(uint8_t ch, bool clear, uint32_t hz) {
+    if (!clear) ch = g_trig_ch;
+    if (!clear && g_trig_n == 0) { serial_printf("ERR: no trig list (use trig <ch> <MHz> ...)", 1); return; }
+    if (g_trig_n >= SI5351_TRIG_STEPS && !clear) { serial_printf("ERR: trig list full (%u)", 1, SI5351_TRIG_STEPS); return; }
+
+    if (ch < g_chip->n_out && track_slaves(ch)) {
+        serial_printf("ERR: CLK%u is a track master; trig steps it alone (use clk / at / dma sweep)", 1, ch);
+        return;
+    }
+    stage_t st;
+    int rc = stage_prepare(&st, ch, hz);
+    if (rc != 0) { serial_printf("ERR: trig CLK%u %lu Hz (rc=%d)", 1, ch, (unsigned long)hz, rc); return; }
+
+    // IRQ（同じコア）がリストを読むので差し替え中だけ割り込みを止める
+    uint32_t irq = save_and_disable_interrupts();
+    if (clear) { g_trig_n = 0; g_trig_idx = 0; g_trig_ch = ch; }
+    g_trig_step[g_trig_n++] = st;
+    restore_interrupts(irq);
+    si5351_mem_use(g_mem_trig, g_trig_n * (uint32_t)sizeof(stage_t));
+}
+
+static void trig_arm(uint8_t pin, uint8_t falling) {
+    if (g_trig_n == 0) { serial_printf("ERR: no trig list (use trig <ch> <MHz> ...)", 1); return; }
+    if (pin >= 30) { serial_printf("ERR: GPIO%u (use 0..29)", 1, pin); return; }
+    if (g_trig_pin >= 0) gpio_set_irq_enabled((uint)g_trig_pin, g_trig_edge, false);
+    g_trig_pin  = pin;
+    g_trig_edge = falling ? GPIO_IRQ_EDGE_FALL : GPIO_IRQ_EDGE_RISE;
+    g_trig_idx  = 0;
+    g_trig_pending = false;
+    trig_stats_reset();
+    gpio_init(pin);
+    gpio_set_dir(pin, false);
+    gpio_pull_down(pin);
+    gpio_set_irq_enabled_with_callback(pin, g_trig_edge, true, trig_gpio_irq);
+    serial_printf("trig armed: GPIO%u %s edge, CLK%u, %u steps", 1, pin, falling ? "falling" : "rising",
+                  g_trig_ch, g_trig_n);
+}
+
+static void trig_off(void) {
+    if (g_trig_pin >= 0) gpio_set_irq_enabled((uint)g_trig_pin, g_trig_edge, false);
+    g_trig_pin = -1;
+    g_trig_pending = false;
+    serial_printf("trig off", 1);
+}
+
+static void trig_show(void) {
+    serial_printf("trig: CLK%u, %u step(s), next=#%u, %s", 1, g_trig_ch, g_trig_n, g_trig_idx,
+                  (g_trig_pin >= 0) ? "armed" : "off");
+    for (unsigned i = 0; i < g_trig_n; i++) {
+        const stage_t *st = &g_trig_step[i];
+        if (st->hz == 0) { serial_printf("  #%u off", 1, i); continue; }
+        serial_printf("  #%u %lu Hz PLL%c MS=%lu+%lu/%lu R=%u", 1, i, (unsigned long)st->hz,
+                      'A' + st->cand.pll, (unsigned long)st->cand.ms.a, (unsigned long)st->cand.ms.b,
+                      (unsigned long)st->cand.ms.c, 1u << st->cand.r_log2);
+    }
+    trig_stats_t t = g_trig_st;
+    serial_printf("edges=%lu fired=%lu deferred=%lu overrun=%lu re-solved=%lu failed=%lu", 1,
+                  (unsigned long)t.edges, (unsigned long)t.fired, (unsigned long)t.deferred,
+                  (unsigned long)t.overrun, (unsigned long)t.resolved, (unsigned long)t.failed);
+    if (t.fired)
+        serial_printf("edge->STOP latency: last=%lu min=%lu avg=%.1f max=%lu us", 1,
+                      (unsigned long)t.lat_last, (unsigned long)t.lat_min,
+                      (double)t.lat_sum / t.fired, (unsigned long)t.lat_max);
+}
+
+// ===== チェーン DMA 再生（dma sweep / play / bench） =====
+// 掃引は差分圧縮列（si5351_seq.h）で持ち、再生時に 2 区間の I2C コマンド語バッファへ交互に復号する。
+// 区間内はステップごとの CPU 介入なし。片方を再生している間にもう片方を復号しておく
+static uint8_t          *g_seq_buf;                // アリーナの残り全部
+static uint32_t          g_seq_cap;
+static si5351_seq_t      g_seq;
+static uint16_t        (*g_dma_words)[SI5351_DMA_WORDS / 2];          // [2]
+static uint32_t        (*g_dma_ctrl)[SI5351_DMA_STEPS / 2][2];        // [2]
+static si5351_dma_seq_t  g_dma_half[2];
+static uint8_t           g_dma_cur;                 // 再生中の区間
+static uint32_t          g_dma_next_n;              // 復号済みで再生待ちの区間のステップ数
+static uint32_t          g_dma_pos;                 // 次に復号する g_seq の位置
+static uint8_t           g_dma_ch;
+static uint32_t          g_dma_start_hz, g_dma_stop_hz, g_dma_points, g_dma_rate_hz;
+static uint32_t          g_dma_resets;              // PLL リセットを含むステップ数
+static si5351_cand_t     g_dma_last;                // 最終ステップの候補（完了後にプランへ採用）
+static si5351_cand_t     g_dma_last_trk[SI5351_MAX_OUT];   // track の slave の最終候補
+static uint8_t           g_dma_trk;                 // 掃引に含めた slave（bit ch）
+static bool              g_dma_valid, g_dma_active;
+static volatile bool     g_dma_stop_req;            // 生産者側から再生中止を要求
+static uint32_t          g_bus_hz = 100000u;
+
+typedef struct {
+    uint32_t steps, segments, aborts;
+    uint32_t decoded, decode_us;                    // 復号したステップ数と所要時間
+    uint64_t t0;
+    uint32_t elapsed_us;
+} dma_run_t;
+static dma_run_t g_dma_run;
+
+// 1 チャネル分（PLL 像 → FB_INT → PLL リセット → MS 像 → CLKx_CTRL）を開いているステップに加える。先頭ステップは全バイト書く
+static int dma_put(const stage_t *st, bool first) {
+    const si5351_cand_t *c = &st->cand;
+    uint8_t k = c->pll, pll[8], v;
+    const uint8_t *pll_img = pll;
+    si5351_frac_t fb = (c->flags & SI5351_CF_NEW_PLL) ? c->fb : g_plan->pll[k].fb;
+    if (c->flags & SI5351_CF_NEW_PLL) pll_img = st->pll_img;
+    else si5351_encode_pll(&fb, pll);
+
+    int n = si5351_seq_put(&g_seq, k_pll_base[k], pll_img, 8, first);
+    if (n < 0) return -1;
+    if (n > 0) {
+        uint8_t fbr = (uint8_t)(REG_FBA_INT + k);
+        v = (fb.b == 0) ? (uint8_t)(g_seq.img[fbr] | 0x40) : (uint8_t)(g_seq.img[fbr] & ~0x40);
+        if (si5351_seq_put(&g_seq, fbr, &v, 1, false) < 0) return -1;
+        v = pll_rst_bit(k);
+        if (!si5351_seq_raw(&g_seq, REG_PLL_RESET, &v, 1)) return -1;
+        g_dma_resets++;
+    }
+    if (si5351_seq_put(&g_seq, si5351_reg_ms_base(st->ch), st->ms_img, 8, first) < 0) return -1;
+    uint8_t cr = si5351_reg_clk_ctrl(st->ch);
+    v = (uint8_t)(g_seq.img[cr] & ~0x60u);
+    if (c->flags & SI5351_CF_EVEN_MS) v |= 0x40;
+    if (k) v |= 0x20;
+    return si5351_seq_put(&g_seq, cr, &v, 1, first) < 0 ? -1 : 0;
+}
+
+// track の slave を 1 ステップ分: master の採用後に解いて採用し, 差分を加える（ビルド中はプランを動かす）
+static int dma_put_track(uint32_t hz, bool first) {
+    for (unsigned s = 0; s < g_chip->n_out; s++) {
+        if (!((g_dma_trk >> s) & 1u)) continue;
+        uint32_t shz;
+        stage_t st;
+        if (!track_hz(s, hz, &shz)) return -2;
+        int rc = stage_prepare(&st, s, shz);
+        if (rc != 0 || si5351_plan_adopt(g_plan, s, &st.cand) != 0) return -2;
+        if (dma_put(&st, first) != 0) return -1;
+        g_dma_last_trk[s] = st.cand;
+    }
+    return 0;
+}
+
+// 推定ステップ上限 [steps/s]（最長ステップ基準）
+static double dma_est_rate(uint32_t bus_hz) {
+    uint32_t ns = si5351_dma_est_step_ns(g_seq.max_step_payload, g_seq.max_step_runs, bus_hz);
+    return ns ? 1e9 / ns : 0.0;
+}
+
+static void dma_build(uint8_t ch, uint32_t start_hz) {
+    g_dma_valid = false;
+    if (!ch_ok(ch)) return;
+    if (si5351_ms_is_compact(ch)) { serial_printf("ERR: dma sweep needs CLK0..5 (MS6/7 are integer-only)", 1); return; }
+    if (!g_plan->ch[ch].active) { serial_printf("ERR: CLK%u not running (use clk first)", 1, ch); return; }
+    g_dma_trk = track_slaves(ch);
+    for (unsigned s = 0; s < g_chip->n_out; s++)
+        if (((g_dma_trk >> s) & 1u) && si5351_ms_is_compact(s)) { serial_printf("ERR: track CLK%u is MS6/7 (dma needs CLK0..5)", 1, s); return; }
+    uint32_t pts = g_dma_points;
+    if (pts == 0) { serial_printf("ERR: points must be >= 1", 1); return; }
+
+    // 差分の基準をチップの現在値で満たす（未知のレジスタは読む）
+    si5351_seq_init(&g_seq, g_seq_buf, g_seq_cap);
+    const uint8_t regs[3] = { REG_FBA_INT, (uint8_t)(REG_FBA_INT + 1), si5351_reg_clk_ctrl(ch) };
+    for (unsigned i = 0; i < 3; i++)
+        if (rd8_cached(regs[i], &g_seq.img[regs[i]]) != 0) return;
+    for (unsigned r = 0; r < 256; r++)
+        if (shadow_has((uint8_t)r)) g_seq.img[r] = g_shadow[r];
+
+    uint32_t t0 = time_us_32();
+    stage_t st;
+    g_dma_resets = 0;
+
+    // track: ステップごとに master → slave の順で解いて採用する（終わったらプランを戻す）
+    if (g_dma_trk) plan_save();
+    int err = 0;
+    uint32_t i, hz = start_hz;
+    for (i = 0; i < pts && !err; i++) {
+        engine_alive();
+        hz = (pts == 1) ? start_hz
+           : (uint32_t)(start_hz + ((double)g_dma_stop_hz - start_hz) * i / (pts - 1u) + 0.5);
+        if (g_dma_trk)
+            for (unsigned s = 0; s < g_chip->n_out; s++)
+                if ((g_dma_trk >> s) & 1u) si5351_plan_release(g_plan, s);
+        int rc = stage_prepare(&st, ch, hz);
+        if (rc != 0) { err = rc; break; }
+        if (g_dma_trk && si5351_plan_adopt(g_plan, ch, &st.cand) != 0) { err = -3; break; }
+        if (!si5351_seq_begin(&g_seq) || dma_put(&st, i == 0) != 0) { si5351_seq_cancel(&g_seq); err = 1; break; }
+        if (g_dma_trk && (rc = dma_put_track(hz, i == 0)) != 0) { si5351_seq_cancel(&g_seq); err = rc == -1 ? 1 : -3; break; }
+        if (!si5351_seq_end(&g_seq)) { err = 1; break; }
+    }
+    if (g_dma_trk) plan_restore();
+    if (err == 1) {
+        serial_printf("ERR: sequence full at point #%lu (%lu bytes, see mem)", 1, (unsigned long)i, (unsigned long)g_seq_cap);
+        return;
+    }
+    if (err) { serial_printf("ERR: dma point #%lu %lu Hz (rc=%d)", 1, (unsigned long)i, (unsigned long)hz, err); return; }
+    g_dma_last = st.cand;
+    g_dma_ch = ch;
+    g_dma_start_hz = start_hz;
+    g_dma_valid = true;
+    si5351_mem_use(g_mem_seq, g_seq.len);
+    serial_printf("dma: CLK%u %lu..%lu Hz, %lu steps, %lu B compact (%lu B as full images), max step %lu B/%lu xfer (built in %lu us)", 1,
+                  ch, (unsigned long)start_hz, (unsigned long)g_dma_stop_hz, (unsigned long)g_seq.n_steps,
+                  (unsigned long)g_seq.len, (unsigned long)g_seq.raw_bytes,
+                  (unsigned long)g_seq.max_step_payload, (unsigned long)g_seq.max_step_runs,
+                  (unsigned long)(time_us_32() - t0));
+    if (g_dma_trk) serial_printf("dma: tracking channel mask 0x%02X follows in the same steps", 1, g_dma_trk);
+}
+
+static bool dma_sink(void *ctx, uint8_t reg, const uint8_t *d, uint8_t len) {
+    return si5351_dma_seq_write((si5351_dma_seq_t *)ctx, reg, d, len);
+}
+
+// 圧縮列の続きを区間 h のコマンド語に復号する。戻り値: 入ったステップ数
+static uint32_t dma_fill(unsigned h) {
+    si5351_dma_seq_t *q = &g_dma_half[h];
+    si5351_dma_seq_init(q, g_dma_words[h], SI5351_DMA_WORDS / 2, g_dma_ctrl[h], SI5351_DMA_STEPS / 2);
+    uint32_t t0 = time_us_32();
+    while (g_dma_pos < g_seq.len) {
+        uint32_t pos = g_dma_pos;
+        si5351_dma_seq_begin(q);
+        if (!si5351_seq_decode(&g_seq, &pos, dma_sink, q) || !si5351_dma_seq_end(q)) {
+            si5351_dma_seq_cancel(q);
+            break;
+        }
+        g_dma_pos = pos;
+    }
+    g_dma_run.decode_us += time_us_32() - t0;
+    g_dma_run.decoded += q->n_steps;
+    si5351_mem_use(g_mem_dma, q->n_words * 2u);
+    si5351_mem_use(g_mem_dmac, (q->n_steps + 1u) * 8u);
+    return q->n_steps;
+}
+
+// 先頭区間を復号して再生開始し、次の区間も復号しておく
+static int dma_begin(uint32_t rate_hz) {
+    memset(&g_dma_run, 0, sizeof(g_dma_run));
+    g_dma_pos = 0;
+    g_dma_cur = 0;
+    if (dma_fill(0) == 0) return -1;
+    int rc = si5351_dma_play(g_i2c, g_addr, &g_dma_half[0], rate_hz, false);
+    if (rc != 0) return rc;
+    g_dma_run.t0 = time_us_64();
+    g_dma_run.segments = 1;
+    g_dma_next_n = dma_fill(1);
+    return 0;
+}
+
+// 区間の継ぎ目を処理する。再生中なら true
+static bool dma_segment_poll(uint32_t rate_hz) {
+    if (si5351_dma_busy()) return true;
+    si5351_dma_result_t r;
+    si5351_dma_last_result(&r);
+    if (si5351_trace_active)
+        si5351_trace_put(SI5351_TR_DMA, g_addr, 0, NULL, (uint16_t)(r.steps > 0xFFFFu ? 0xFFFFu : r.steps),
+                         timer_hw->timerawl - r.elapsed_us, r.tx_aborts ? -1 : 0);
+    g_dma_run.steps  += r.steps;
+    g_dma_run.aborts += r.tx_aborts;
+    if (g_dma_next_n && r.tx_aborts == 0) {
+        g_dma_cur ^= 1u;
+        if (si5351_dma_play(g_i2c, g_addr, &g_dma_half[g_dma_cur], rate_hz, true) == 0) {
+            g_dma_run.segments++;
+            g_dma_next_n = dma_fill(g_dma_cur ^ 1u);
+            return true;
+        }
+    }
+    g_dma_run.elapsed_us = (uint32_t)(time_us_64() - g_dma_run.t0);
+    return false;
+}
+
+static void dma_start(uint32_t rate_hz) {
+    if (!g_dma_valid) { serial_printf("ERR: no dma sequence (use dma sweep ...)", 1); return; }
+    // PLL をリセットするステップがあれば, 実測のロック時間より短く次へ進めない
+    if (g_dma_resets) {
+        uint32_t dwell = lock_dwell_us(), cap = 1000000u / (dwell ? dwell : 1u);
+        if (!cap) cap = 1;
+        if (!rate_hz || rate_hz > cap) {
+            serial_printf("dma: %lu step(s) reset a PLL, rate limited to %lu steps/s (min dwell %lu us)", 1,
+                          (unsigned long)g_dma_resets, (unsigned long)cap, (unsigned long)dwell);
+            rate_hz = cap;
+        }
+    }
+    double max = dma_est_rate(g_bus_hz);
+    if (rate_hz && rate_hz > max)
+        serial_printf("WARN: %lu steps/s exceeds ~%.0f steps/s at %lu kHz; steps stretch to bus time", 1,
+                      (unsigned long)rate_hz, max, (unsigned long)(g_bus_hz / 1000u));
+    g_dma_stop_req = false;
+    int rc = dma_begin(rate_hz);
+    if (rc != 0) { serial_printf("ERR: dma play failed (rc=%d)", 1, rc); return; }
+    g_dma_rate_hz = rate_hz;
+    g_dma_active = true;
+    g_busy = true;          // 再生中はアラーム・トリガ IRQ の書込みを見送らせる
+}
+
+// 再生終了後: シャドウとプランを実機に合わせる
+static void dma_finish(bool stopped) {
+    const dma_run_t *r = &g_dma_run;
+    g_dma_active = false;
+
+    // DMA が書いたレジスタのシャドウは破棄（完走なら圧縮列の最終像で埋め直す）
+    for (unsigned w = 0; w < 256 / 32; w++) g_shadow_valid[w] &= ~g_seq.touched[w];
+    bool ok = !stopped && r->aborts == 0 && r->steps == g_seq.n_steps;
+    if (ok) {
+        for (unsigned reg = 0; reg < 256; reg++)
+            if ((g_seq.touched[reg >> 5] >> (reg & 31)) & 1u) shadow_put((uint8_t)reg, &g_seq.img[reg], 1);
+        g_bus_bytes += g_seq.payload;
+        plan_save();
+        for (unsigned s = 0; s < g_chip->n_out; s++)
+            if ((g_dma_trk >> s) & 1u) si5351_plan_release(g_plan, s);
+        ok = si5351_plan_adopt(g_plan, g_dma_ch, &g_dma_last) == 0;
+        for (unsigned s = 0; s < g_chip->n_out && ok; s++)
+            if ((g_dma_trk >> s) & 1u) ok = si5351_plan_adopt(g_plan, s, &g_dma_last_trk[s]) == 0;
+        if (!ok) plan_restore();
+    }
+    if (!ok) {
+        // 途中停止・失敗・再生前にプランが変わった場合はプラン側の周波数へ戻す
+        freq_commit(g_dma_ch, NULL, NULL);
+        for (unsigned s = 0; s < g_chip->n_out; s++)
+            if (((g_dma_trk >> s) & 1u) && g_plan->ch[s].active) freq_commit(s, NULL, NULL);
+    }
+
+    double sps = r->elapsed_us ? r->steps * 1e6 / r->elapsed_us : 0.0;
+    serial_printf("dma %s: %lu steps in %lu us (%.0f steps/s, requested %s%lu), %lu segment(s), tx aborts=%lu, CLK%u = %.3f Hz%s", 1,
+                  stopped ? "stopped" : "done", (unsigned long)r->steps, (unsigned long)r->elapsed_us, sps,
+                  g_dma_rate_hz ? "" : "max/", (unsigned long)g_dma_rate_hz, (unsigned long)r->segments,
+                  (unsigned long)r->aborts, g_dma_ch, g_plan->ch[g_dma_ch].sel.actual_hz, ok ? "" : " (restored)");
+}
+
+// 再生中のポーリング（エンジン文脈）。再生中なら true
+static bool dma_poll(void) {
+    if (!g_dma_active) return false;
+    bool stopped = g_dma_stop_req;
+    if (!stopped && dma_segment_poll(g_dma_rate_hz)) return true;
+    g_dma_stop_req = false;
+    if (stopped) {
+        si5351_dma_abort();
+        g_dma_run.elapsed_us = (uint32_t)(time_us_64() - g_dma_run.t0);
+    }
+    dma_finish(stopped);
+    g_busy = false;
+    return false;
+}
+
+// バス速度ごとの上限: 実測（100k/400k）と見積り（1 MHz は Si5351 の規格外なので見積りのみ）
+static void dma_bench(void) {
+    if (!g_dma_valid) { serial_printf("ERR: no dma sequence (use dma sweep ...)", 1); return; }
+    static const uint32_t k_bus[3] = { 100000u, 400000u, 1000000u };
+    uint32_t avg_b = g_seq.payload / g_seq.n_steps;
+    uint32_t avg_x = (g_seq.runs + g_seq.n_steps - 1u) / g_seq.n_steps;
+    serial_printf("dma bench: %lu steps, avg step %lu B/%lu xfer, max %lu B/%lu xfer", 1,
+                  (unsigned long)g_seq.n_steps, (unsigned long)avg_b, (unsigned long)avg_x,
+                  (unsigned long)g_seq.max_step_payload, (unsigned long)g_seq.max_step_runs);
+    bool played = false;
+    for (unsigned i = 0; i < 3; i++) {
+        uint32_t ns_avg = si5351_dma_est_step_ns(avg_b, avg_x, k_bus[i]);
+        double meas = 0.0;
+        if (k_bus[i] <= 400000u) {
+            i2c_set_baudrate(g_i2c, k_bus[i]);
+            if (dma_begin(0) == 0) {
+                played = true;
+                while (dma_segment_poll(0)) engine_alive();
+                if (g_dma_run.elapsed_us) meas = g_dma_run.steps * 1e6 / g_dma_run.elapsed_us;
+            }
+        }
+        if (meas > 0.0)
+            serial_printf("  %4lu kHz: est %7.0f steps/s (worst %7.0f)  measured %7.0f steps/s  segments=%lu aborts=%lu", 1,
+                          (unsigned long)(k_bus[i] / 1000u), ns_avg ? 1e9 / ns_avg : 0.0, dma_est_rate(k_bus[i]),
+                          meas, (unsigned long)g_dma_run.segments, (unsigned long)g_dma_run.aborts);
+        else
+            serial_printf("  %4lu kHz: est %7.0f steps/s (worst %7.0f)  %s", 1,
+                          (unsigned long)(k_bus[i] / 1000u), ns_avg ? 1e9 / ns_avg : 0.0, dma_est_rate(k_bus[i]),
+                          (k_bus[i] > 400000u) ? "(Fm+, beyond Si5351 spec: estimate only)" : "(play failed)");
+    }
+    i2c_set_baudrate(g_i2c, g_bus_hz);
+    // 最後まで再生したのと同じ状態にする
+    g_dma_rate_hz = 0;
+    if (played) dma_finish(false);
+}
+
+static void dma_show(void) {
+    if (!g_dma_valid) { serial_printf("dma: no sequence (%s)", 1, g_dma_active ? "playing" : "idle"); return; }
+    const si5351_seq_t *q = &g_seq;
+    serial_printf("dma: CLK%u %lu..%lu Hz, %lu steps, %s", 1, g_dma_ch,
+                  (unsigned long)g_dma_start_hz, (unsigned long)g_dma_stop_hz, (unsigned long)q->n_steps,
+                  g_dma_active ? "playing" : "idle");
+    // 圧縮率: 全像（PLL/MS 8 バイト + CTRL 等）と DMA コマンド語（2 バイト/バイト）に対して
+    serial_printf("seq: %lu/%lu B compact (%.2f B/step), full images %lu B (%.1fx), DMA words %lu B (%.1fx)", 1,
+                  (unsigned long)q->len, (unsigned long)g_seq_cap, (double)q->len / q->n_steps,
+                  (unsigned long)q->raw_bytes, (double)q->raw_bytes / q->len,
+                  (unsigned long)(2u * q->payload), 2.0 * q->payload / q->len);
+    if (g_dma_run.decoded)
+        serial_printf("decode: %.2f us/step (%lu steps in %lu us, %lu-step segments)", 1,
+                      (double)g_dma_run.decode_us / g_dma_run.decoded, (unsigned long)g_dma_run.decoded,
+                      (unsigned long)g_dma_run.decode_us, (unsigned long)(SI5351_DMA_STEPS / 2 - 1));
+    serial_printf("max step rate at %lu kHz: ~%.0f steps/s", 1, (unsigned long)(g_bus_hz / 1000u),
+                  dma_est_rate(g_bus_hz));
+    if (g_dma_resets)
+        serial_printf("%lu step(s) reset a PLL: min dwell %lu us (measured lock time)", 1,
+                      (unsigned long)g_dma_resets, (unsigned long)lock_dwell_us());
+}
+
+// ===== PLLA/PLLB ピンポン切替（hop） =====
+// 空いている側の PLL を次の周波数へ合わせてロックさせておき、出力を切り替える。
+// MS/R を据え置ける（VCO が範囲内）なら切替は CLKx_CTRL の MS_SRC 1 バイトだけで済む。
+#define HOP_LOG_LEN             8
+
+typedef struct {
+    bool          ready;
+    bool          same_ms;      // MS/R 据え置き（CLKx_CTRL の 1 バイトで切替）
+    bool          locked;
+    uint8_t       ch, pll;
+    uint32_t      hz;
+    si5351_cand_t cand;
+    uint8_t       pll_img[8], ms_img[8];
+    uint32_t      prep_us, lock_us;
+} hop_prep_t;
+
+typedef struct {
+    uint32_t n;
+    uint32_t hz_from, hz_to;
+    uint8_t  ch, pll_from, pll_to;
+    bool     same_ms, locked;
+    uint16_t bytes;
+    uint32_t prep_us, lock_us, switch_us;
+} hop_log_t;
+
+static hop_prep_t g_hop;
+static hop_log_t  g_hop_log[HOP_LOG_LEN];
+static uint32_t   g_hop_n;                  // 実行した hop の総数
+static uint32_t   g_hop_min_us = UINT32_MAX, g_hop_max_us;
+static uint64_t   g_hop_sum_us;
+
+static void hop_prep(unsigned ch, uint32_t hz) {
+    g_hop.ready = false;
+    if (!ch_ok(ch)) return;
+    if (!g_plan->ch[ch].active) { serial_printf("ERR: CLK%u not running (use clk first)", 1, ch); return; }
+    uint32_t t0 = time_us_32();
+    uint8_t  k = (uint8_t)(g_plan->ch[ch].sel.pll ^ 1u);
+    si5351_cand_t c;
+    bool same = true;
+    int rc = si5351_plan_probe_pll(g_plan, ch, hz, k, true, &c);
+    if (rc == -4 || rc == -2) { same = false; rc = si5351_plan_probe_pll(g_plan, ch, hz, k, false, &c); }
+    if (rc == -3) { serial_printf("ERR: PLL%c is in use (hop needs the other PLL free)", 1, 'A' + k); return; }
+    if (rc != 0)  { serial_printf("ERR: no plan for %lu Hz on PLL%c (rc=%d)", 1, (unsigned long)hz, 'A' + k, rc); return; }
+
+    // 出力に繋がっていない PLL だけを書き換えてリセットする（MS は切替時まで触らない）
+    hop_prep_t *h = &g_hop;
+    h->ch = (uint8_t)ch;
+    h->pll = k;
+    h->hz = hz;
+    h->cand = c;
+    h->same_ms = same;
+    si5351_encode_pll(&c.fb, h->pll_img);
+    si5351_encode_ms(&c.ms, c.r_log2, (c.flags & SI5351_CF_DIVBY4) != 0, h->ms_img);
+    if (wr_delta(k_pll_base[k], h->pll_img, 8) < 0) return;
+    fb_int_set(k, c.fb.b == 0);
+    uint32_t n0 = g_lock[k].n;
+    h->locked = pll_reset(pll_rst_bit(k)) != 0;
+    h->lock_us = (g_lock[k].n != n0) ? g_lock[k].last_us : time_us_32() - g_lock_t_reset[k];
+    h->prep_us = time_us_32() - t0;
+    h->ready = true;
+}
+
+static void hop_go(void) {
+    hop_prep_t *h = &g_hop;
+    if (!h->ready) { serial_printf("ERR: nothing prepared (use hop prep <ch> <MHz>)", 1); return; }
+    h->ready = false;
+    // 準備後に PLL が他のチャネルに取られたり書き換えられたりしていないこと
+    bool intact = !g_plan->pll[h->pll].users && g_plan->ch[h->ch].active;
+    for (unsigned i = 0; i < 8 && intact; i++)
+        intact = shadow_has((uint8_t)(k_pll_base[h->pll] + i)) && g_shadow[k_pll_base[h->pll] + i] == h->pll_img[i];
+    if (!intact) { serial_printf("ERR: hop: PLL%c changed since prep, prepare again", 1, 'A' + h->pll); return; }
+    if (!h->locked) {
+        // 準備時にロックを確かめられなかった: 実測の最短滞在時間までは待ってから読み直す
+        uint32_t dwell = lock_dwell_us();
+        while (time_us_32() - g_lock_t_reset[h->pll] < dwell) tight_loop_contents();
+        h->locked = pll_settle((uint8_t)(1u << h->pll), false) != 0;
+    }
+
+    hop_log_t *e = &g_hop_log[g_hop_n % HOP_LOG_LEN];
+    e->n = ++g_hop_n;
+    e->ch = h->ch;
+    e->hz_from = g_plan->ch[h->ch].sel.target_hz;
+    e->pll_from = g_plan->ch[h->ch].sel.pll;
+    if (si5351_plan_adopt(g_plan, h->ch, &h->cand) != 0) { g_hop_n--; serial_printf("ERR: hop: adopt failed", 1); return; }
+
+    uint32_t bytes0 = g_bus_bytes, t0 = time_us_32();
+    if (!h->same_ms) ms_apply_img(h->ch, h->ms_img);
+    clk_ctrl_update(h->ch);
+    uint32_t dt = time_us_32() - t0;
+
+    e->hz_to = h->hz;
+    e->pll_to = h->pll;
+    e->same_ms = h->same_ms;
+    e->locked = h->locked;
+    e->bytes = (uint16_t)(g_bus_bytes - bytes0);
+    e->prep_us = h->prep_us;
+    e->lock_us = h->lock_us;
+    e->switch_us = dt;
+    if (dt < g_hop_min_us) g_hop_min_us = dt;
+    if (dt > g_hop_max_us) g_hop_max_us = dt;
+    g_hop_sum_us += dt;
+
+    if (!g_in_irq) {
+        serial_printf("hop #%lu CLK%u %lu -> %lu Hz: PLL%c->PLL%c, %s (%u byte(s)), prep %lu us, lock %lu us%s, "
+                      "switch %lu us", 1, (unsigned long)e->n, e->ch, (unsigned long)e->hz_from,
+                      (unsigned long)e->hz_to, 'A' + e->pll_from, 'A' + e->pll_to,
+                      e->same_ms ? "same MS" : "new MS", e->bytes, (unsigned long)e->prep_us,
+                      (unsigned long)e->lock_us, e->locked ? "" : " (NOT locked)", (unsigned long)dt);
+    }
+}
+
+static void hop_show(void) {
+    if (g_hop.ready)
+        serial_printf("hop: prepared CLK%u -> %lu Hz on PLL%c (%s, fb=%lu+%lu/%lu, lock %lu us%s)", 1, g_hop.ch,
+                      (unsigned long)g_hop.hz, 'A' + g_hop.pll, g_hop.same_ms ? "same MS" : "new MS",
+                      (unsigned long)g_hop.cand.fb.a, (unsigned long)g_hop.cand.fb.b,
+                      (unsigned long)g_hop.cand.fb.c, (unsigned long)g_hop.lock_us,
+                      g_hop.locked ? "" : ", NOT locked");
+    else
+        serial_printf("hop: nothing prepared", 1);
+    if (!g_hop_n) return;
+    serial_printf("hop: %lu done, switch min/avg/max %lu/%lu/%lu us", 1, (unsigned long)g_hop_n,
+                  (unsigned long)g_hop_min_us, (unsigned long)(g_hop_sum_us / g_hop_n), (unsigned long)g_hop_max_us);
+    serial_printf("  %6s %3s %11s %11s %-9s %-6s %5s %8s %8s %9s", 1, "#", "ch", "from Hz", "to Hz", "PLL", "MS",
+                  "bytes", "prep us", "lock us", "switch us");
+    uint32_t first = g_hop_n > HOP_LOG_LEN ? g_hop_n - HOP_LOG_LEN : 0;
+    for (uint32_t i = first; i < g_hop_n; i++) {
+        const hop_log_t *e = &g_hop_log[i % HOP_LOG_LEN];
+        serial_printf("  %6lu %3u %11lu %11lu PLL%c->%c  %-6s %5u %8lu %7lu%s %9lu", 1, (unsigned long)e->n, e->ch,
+                      (unsigned long)e->hz_from, (unsigned long)e->hz_to, 'A' + e->pll_from, 'A' + e->pll_to,
+                      e->same_ms ? "same" : "new", e->bytes, (unsigned long)e->prep_us, (unsigned long)e->lock_us,
+                      e->locked ? " " : "!", (unsigned long)e->switch_us);
+    }
+}
+
+// ===== スカラーネットワークアナライザ（sna） =====
+// 点 i を書いて整定を待ち, ADC の DMA 取り込みを始めたら, 終わるまでの間に点 i-1 の結果を送って点 i+1 を解く。
+#define SNA_SIM_LEVEL_DBM       0.0         // 模擬: 通過域での検波器入力
+#define SNA_SIM_FLOOR_DBM       (-75.0)     // 模擬: 検波器の下限
+#define SNA_SIM_INTERCEPT_DBM   (-84.0)     // 模擬: 対数検波器（AD8307 相当）0 V の入力
+#define SNA_SIM_MV_PER_DB       25.0
+#define SNA_SIM_VREF            3.3
+
+typedef struct {
+    uint32_t f0_hz, bw_hz;
+    uint8_t  order;                 // 0=模擬なし
+    double   f_hz;                  // 取り込み中の出力周波数（エンジンが書く）
+    uint32_t seed;
+} sna_sim_t;
+
+typedef struct {
+    bool     active;
+    uint32_t start_hz, stop_hz, points, samples, settle_us;
+    uint32_t i;                     // 次に書く点
+    stage_t  next;                  // 点 i のレジスタ像（前の点の取り込み中に作る）
+    int      next_rc;
+    bool     have_prev;
+    si5351_sna_rec_t prev;          // 次の点の取り込み中に送る結果
+    uint32_t sent;
+    uint64_t t0;
+    uint32_t elapsed_us;
+    uint64_t write_us, settle_wait_us, overlap_us, stall_us;
+    uint32_t resets, unlocked, errors;
+} sna_run_t;
+
+static uint16_t         *g_sna_buf;                 // SI5351_SNA_SAMPLES_MAX 語（アリーナ上）
+static sna_run_t         g_sna;
+static sna_sim_t         g_sna_sim = { 10700000u, 300000u, 0, 0.0, 1u };
+static uint32_t          g_sna_stop_hz, g_sna_points, g_sna_samples = SI5351_SNA_SAMPLES_DEF;
+static uint32_t          g_sna_settle_us = SI5351_SNA_SETTLE_DEF;
+static volatile bool     g_sna_stop_req;
+
+// 模擬検波器: n 次 Butterworth 相当の帯域通過フィルタ + 対数検波器 + ±4 LSB の雑音
+static void sna_sim_fill(uint16_t *buf, uint32_t n, void *ctx) {
+    sna_sim_t *m = ctx;
+    double x = (m->f_hz - (double)m->f0_hz) / (0.5 * (double)m->bw_hz);
+    double dbm = SNA_SIM_LEVEL_DBM - 10.0 * log10(1.0 + pow(x * x, m->order));
+    if (dbm < SNA_SIM_FLOOR_DBM) dbm = SNA_SIM_FLOOR_DBM;
+    double code = (dbm - SNA_SIM_INTERCEPT_DBM) * SNA_SIM_MV_PER_DB * 1e-3 / SNA_SIM_VREF * 4095.0;
+    for (uint32_t i = 0; i < n; i++) {
+        m->seed = m->seed * 1664525u + 1013904223u;
+        int v = (int)(code + 0.5) + (int)((m->seed >> 16) % 9u) - 4;
+        buf[i] = (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+    }
+}
+
+static uint32_t sna_hz(uint32_t i) {
+    const sna_run_t *r = &g_sna;
+    if (r->points == 1) return r->start_hz;
+    return (uint32_t)(r->start_hz + ((double)r->stop_hz - r->start_hz) * i / (r->points - 1u) + 0.5);
+}
+
+// 改行変換を通さずに出す（バイナリ）
+static void sna_put_raw(const void *p, uint32_t len) {
+    const uint8_t *b = p;
+    for (uint32_t i = 0; i < len; i++) putchar_raw(b[i]);
+}
+
+static void sna_start(uint32_t start_hz) {
+    sna_run_t *r = &g_sna;
+    const unsigned ch = SI5351_SNA_CH;
+    if (g_dma_active || r->active) { serial_printf("ERR: a sweep is already running", 1); return; }
+    if (ch >= g_chip->n_out) { serial_printf("ERR: sna source CLK%u not on this chip", 1, ch); return; }
+    if (track_slaves(ch)) { serial_printf("ERR: CLK%u is a track master (sna steps it alone)", 1, ch); return; }
+    if (g_sna_points == 0 || g_sna_samples == 0 || g_sna_samples > SI5351_SNA_SAMPLES_MAX) {
+        serial_printf("ERR: points >= 1, samples 1..%u", 1, (unsigned)SI5351_SNA_SAMPLES_MAX);
+        return;
+    }
+    if (!g_sna_sim.order && !si5351_adc_init(SI5351_ADC_GPIO)) {
+        serial_printf("ERR: ADC on GPIO%u unavailable (use sna sim ...)", 1, (unsigned)SI5351_ADC_GPIO);
+        return;
+    }
+    si5351_adc_set_sim(g_sna_sim.order ? sna_sim_fill : NULL, &g_sna_sim);
+
+    memset(r, 0, sizeof(*r));
+    r->start_hz  = start_hz;
+    r->stop_hz   = g_sna_stop_hz;
+    r->points    = g_sna_points;
+    r->samples   = g_sna_samples;
+    r->settle_us = g_sna_settle_us;
+    r->next_rc   = stage_prepare(&r->next, ch, sna_hz(0));
+    if (r->next_rc != 0) {
+        serial_printf("ERR: no plan for %lu Hz (rc=%d)", 1, (unsigned long)start_hz, r->next_rc);
+        r->points = 0;
+        return;
+    }
+    si5351_mem_use(g_mem_sna, r->samples * 2u);
+
+    uint16_t ver = SI5351_SNA_VERSION, sz = (uint16_t)sizeof(si5351_sna_rec_t);
+    uint16_t ns = (uint16_t)r->samples, st = (uint16_t)(r->settle_us > 0xFFFFu ? 0xFFFFu : r->settle_us);
+    serial_printf("sna bin: CLK%u %lu..%lu Hz, %lu points x %u samples%s, %lu B follow", 1, ch,
+                  (unsigned long)r->start_hz, (unsigned long)r->stop_hz, (unsigned long)r->points, ns,
+                  g_sna_sim.order ? " (simulated detector)" : "", (unsigned long)(24u + r->points * sz));
+    sna_put_raw(SI5351_SNA_MAGIC, 4);
+    sna_put_raw(&ver, 2);
+    sna_put_raw(&sz, 2);
+    sna_put_raw(&r->points, 4);
+    sna_put_raw(&ns, 2);
+    sna_put_raw(&st, 2);
+    sna_put_raw(&r->start_hz, 4);
+    sna_put_raw(&r->stop_hz, 4);
+
+    g_sna_stop_req = false;
+    r->t0 = time_us_64();
+    r->active = true;
+    g_busy = true;          // 掃引中はアラーム・トリガ IRQ の書込みを見送らせる
+}
+
+// 1 点: 書込み → 整定 → 取り込み開始 →（取り込み中に前の点を送り, 次の点を解く）→ 平均
+static void sna_step(void) {
+    sna_run_t *r = &g_sna;
+    const unsigned ch = SI5351_SNA_CH;
+    si5351_sna_rec_t rec = { .hz = r->next.hz };
+    uint32_t locks0 = g_lock[0].n + g_lock[1].n, to0 = g_lock[0].timeouts + g_lock[1].timeouts;
+    uint32_t err0 = g_i2c_errors, t0 = time_us_32();
+    if (r->next_rc != 0 || stage_commit(&r->next) < 0) rec.flags |= SI5351_SNA_F_ERROR;
+    uint32_t t1 = time_us_32();
+    uint32_t to1 = g_lock[0].timeouts + g_lock[1].timeouts;
+    if (g_lock[0].n + g_lock[1].n != locks0 || to1 != to0) rec.flags |= SI5351_SNA_F_RESET;
+    if (to1 != to0) rec.flags |= SI5351_SNA_F_UNLOCKED;
+    if (g_i2c_errors != err0) rec.flags |= SI5351_SNA_F_ERROR;
+
+    while (time_us_32() - t1 < r->settle_us) tight_loop_contents();
+    uint32_t t2 = time_us_32();
+    g_sna_sim.f_hz = r->next.cand.actual_hz;
+    bool adc = si5351_adc_start(g_sna_buf, r->samples) == 0;
+    if (!adc) rec.flags |= SI5351_SNA_F_ERROR;
+
+    // 取り込み中の仕事
+    if (r->have_prev) { sna_put_raw(&r->prev, sizeof(r->prev)); r->sent++; }
+    r->i++;
+    if (r->i < r->points) r->next_rc = stage_prepare(&r->next, ch, sna_hz(r->i));
+    uint32_t t3 = time_us_32();
+    while (si5351_adc_busy()) tight_loop_contents();
+    uint32_t t4 = time_us_32();
+
+    uint32_t sum = 0;
+    uint16_t lo = 0xFFFF, hi = 0;
+    for (uint32_t k = 0; adc && k < r->samples; k++) {
+        uint16_t v = g_sna_buf[k] & 0x0FFFu;
+        sum += v;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    rec.mean_x16 = adc ? (uint16_t)((sum * 16u + r->samples / 2u) / r->samples) : 0;
+    rec.min = adc ? lo : 0;
+    rec.max = hi;
+    if (si5351_adc_sim_active()) rec.flags |= SI5351_SNA_F_SIM;
+    r->prev = rec;
+    r->have_prev = true;
+
+    r->write_us       += t1 - t0;
+    r->settle_wait_us += t2 - t1;
+    r->overlap_us     += t3 - t2;
+    r->stall_us       += t4 - t3;
+    if (rec.flags & SI5351_SNA_F_RESET)    r->resets++;
+    if (rec.flags & SI5351_SNA_F_UNLOCKED) r->unlocked++;
+    if (rec.flags & SI5351_SNA_F_ERROR)    r->errors++;
+}
+
+static void sna_finish(bool stopped) {
+    sna_run_t *r = &g_sna;
+    si5351_adc_stop();
+    if (r->have_prev) { sna_put_raw(&r->prev, sizeof(r->prev)); r->sent++; }
+    r->elapsed_us = (uint32_t)(time_us_64() - r->t0);
+    r->active = false;
+    g_busy = false;
+    uint32_t n = r->i ? r->i : 1u;
+    serial_printf("", 1);
+    serial_printf("sna %s: %lu/%lu points in %lu us (%.1f points/s), per point: write %lu us, settle %lu us, "
+                  "capture %lu us (%lu us overlapped with send/solve), %lu PLL reset(s), %lu unlocked, %lu error(s)", 1,
+                  stopped ? "stopped" : "done", (unsigned long)r->sent, (unsigned long)r->points,
+                  (unsigned long)r->elapsed_us, r->elapsed_us ? r->sent * 1e6 / r->elapsed_us : 0.0,
+                  (unsigned long)(r->write_us / n), (unsigned long)(r->settle_wait_us / n),
+                  (unsigned long)((r->overlap_us + r->stall_us) / n), (unsigned long)(r->overlap_us / n),
+                  (unsigned long)r->resets, (unsigned long)r->unlocked, (unsigned long)r->errors);
+}
+
+// 掃引中のポーリング（エンジン文脈, 1 回に 1 点）。掃引中なら true
+static bool sna_poll(void) {
+    if (!g_sna.active) return false;
+    if (!g_sna_stop_req && g_sna.i < g_sna.points) { sna_step(); return true; }
+    sna_finish(g_sna_stop_req);
+    g_sna_stop_req = false;
+    return false;
+}
+
+static void sna_sim_set(uint8_t order, uint32_t f0_hz) {
+    if (g_sna.active) { serial_printf("ERR: sna is running", 1); return; }
+    g_sna_sim.order = order;
+    if (order) g_sna_sim.f0_hz = f0_hz;
+    if (!order) si5351_adc_set_sim(NULL, NULL);
+    if (order)
+        serial_printf("sna sim: band-pass %lu Hz, BW %lu Hz, order %u, log detector %.0f mV/dB", 1,
+                      (unsigned long)g_sna_sim.f0_hz, (unsigned long)g_sna_sim.bw_hz, order, SNA_SIM_MV_PER_DB);
+    else
+        serial_printf("sna sim: off (ADC GPIO%u)", 1, (unsigned)SI5351_ADC_GPIO);
+}
+
+static void sna_show(void) {
+    const sna_run_t *r = &g_sna;
+    serial_printf("sna: CLK%u, %lu samples/point at %lu sps, settle %lu us, detector %s", 1, (unsigned)SI5351_SNA_CH,
+                  (unsigned long)g_sna_samples, (unsigned long)si5351_adc_rate(), (unsigned long)g_sna_settle_us,
+                  g_sna_sim.order ? "simulated" : "ADC");
+    if (r->active)
+        serial_printf("sna: running, point %lu/%lu", 1, (unsigned long)r->i, (unsigned long)r->points);
+    else if (r->points)
+        serial_printf("sna: last run %lu/%lu points in %lu us", 1, (unsigned long)r->sent, (unsigned long)r->points,
+                      (unsigned long)r->elapsed_us);
+}
+
+// ===== ADC 入力による FM / PM（fm） =====
+// ADC をリング取り込みし, 最新の 1 サンプルを MS 値へ写して変化したバイトだけを書く。
+// バスが追いつかずに読み飛ばしたサンプルは取りこぼしとして数える。
+#define FM_POLL_US      2000u       // 1 回のポーリングで変調に使う時間（その後 CLI・停止要求を見る）
+#define FM_RATE_MARGIN  0.9         // 自動レート: 見積りの 9 割（変換・補間・分岐の分）
+#define FM_AUTO_BYTES   5u          // 自動レートの見積りに使う 1 回の書込み（レジスタ番号 + P1 下位・P2 の 4 バイト）
+#define FM_TWO_PI       6.283185307179586
+
+typedef struct {
+    bool          active;
+    uint8_t       ch, mode, base;
+    uint32_t      carrier_hz, dev, rate;
+    double        hz_per_s;         // 入力 s 1 コードあたりの目標偏移 [Hz]
+    double        u_exact;          // 搬送波の MS × 2^26（丸め前）
+    si5351_cand_t saved;            // 変調前の採用候補（終了時に戻す）
+    int64_t       u0;
+    uint8_t       img[8];
+    uint16_t      x_prev;
+    uint32_t      seen;             // 処理した ADC サンプル数（リングの総数と比べる）
+    uint64_t      t0;
+    uint32_t      t_rep, elapsed_us;
+    uint32_t      updates, same, dropped, errors;
+    uint32_t      rep_updates, rep_dropped;
+    uint64_t      bytes, bus_us;
+    int32_t       s_lo, s_hi, du_lo, du_hi;
+} fm_run_t;
+
+typedef struct {
+    uint32_t tone_hz;               // 0=模擬なし
+    uint32_t level;                 // [% of full scale]
+    uint32_t phase, inc;            // Q32
+} fm_sim_t;
+
+static uint16_t        *g_fm_ring;                  // 2^SI5351_FM_RING_LOG2 語（アリーナ上, 同じ大きさの境界）
+static int32_t         *g_fm_lut;                   // SI5351_FM_LUT_N 点の du（s = -4096 + 16i）
+static fm_run_t         g_fm;
+static fm_sim_t         g_fm_sim = { 0, 80u, 0, 0 };
+static int16_t          g_fm_sine[256];
+static uint32_t         g_fm_dev = 5000u, g_fm_rate;
+static volatile bool    g_fm_stop_req;
+
+static void fm_sim_fill(uint16_t *buf, uint32_t n, void *ctx) {
+    fm_sim_t *m = ctx;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t v = 2048 + g_fm_sine[m->phase >> 24] * (int32_t)m->level / 100;
+        buf[i] = (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+        m->phase += m->inc;
+    }
+}
+
+// u（MS × 2^26）の MS 像を作り, 変化した範囲だけを書く（戻り値: 書いたバイト数, 負=失敗）
+static int SI5351_HOT(fm_put)(int64_t u) {
+    si5351_fm_pack(u, g_fm.img);
+    return wr_delta(g_fm.base, g_fm.img, 8);
+}
+
+// 1 サンプル: s → 表の線形補間で du → 書込み
+static void SI5351_HOT(fm_write)(uint16_t x) {
+    fm_run_t *r = &g_fm;
+    if (r->mode == SI5351_FM_MODE_PM && !r->updates) r->x_prev = x;     // 最初の 1 点は位相の基準
+    int32_t s = (r->mode == SI5351_FM_MODE_PM) ? (int32_t)x - (int32_t)r->x_prev : (int32_t)x - 2048;
+    uint32_t i = (uint32_t)(s + 4096), k = i >> SI5351_FM_LUT_SHIFT, fr = i & ((1u << SI5351_FM_LUT_SHIFT) - 1u);
+    int32_t du = g_fm_lut[k] + (((g_fm_lut[k + 1] - g_fm_lut[k]) * (int32_t)fr) >> SI5351_FM_LUT_SHIFT);
+    r->x_prev = x;
+
+    uint32_t t0 = time_us_32();
+    int n = fm_put(r->u0 + du);
+    r->bus_us += time_us_32() - t0;
+    if (n < 0) { r->errors++; return; }
+    r->updates++;
+    r->bytes += (uint32_t)n;
+    if (n == 0) r->same++;
+    if (s > r->s_hi) { r->s_hi = s; r->du_hi = du; }
+    if (s < r->s_lo) { r->s_lo = s; r->du_lo = du; }
+}
+
+// 書いた MS 値 u0+du の出力周波数と搬送波の差 [Hz]
+static double fm_dev_hz(int32_t du) {
+    const fm_run_t *r = &g_fm;
+    return r->saved.actual_hz * r->u_exact / (double)(r->u0 + du) - r->saved.actual_hz;
+}
+
+static void fm_report(bool final) {
+    fm_run_t *r = &g_fm;
+    uint32_t now = time_us_32(), span = now - r->t_rep;
+    if (!final) {
+        uint32_t up = r->updates - r->rep_updates, dr = r->dropped - r->rep_dropped;
+        serial_printf("fm: %lu updates/s, %lu dropped (%.1f %%)", 1, (unsigned long)(span ? up * 1000000ull / span : 0),
+                      (unsigned long)dr, (up + dr) ? 100.0 * dr / (up + dr) : 0.0);
+        r->t_rep = now;
+        r->rep_updates = r->updates;
+        r->rep_dropped = r->dropped;
+        return;
+    }
+    uint32_t n = r->updates ? r->updates : 1u;
+    serial_printf("fm done: %lu update(s) in %lu us (%.0f updates/s of %lu), %lu dropped (%.2f %%), %lu unchanged, "
+                  "%lu error(s), %.1f B and %lu us bus per update", 1, (unsigned long)r->updates,
+                  (unsigned long)r->elapsed_us, r->elapsed_us ? r->updates * 1e6 / r->elapsed_us : 0.0,
+                  (unsigned long)r->rate, (unsigned long)r->dropped,
+                  (r->updates + r->dropped) ? 100.0 * r->dropped / (r->updates + r->dropped) : 0.0,
+                  (unsigned long)r->same, (unsigned long)r->errors, (double)r->bytes / n,
+                  (unsigned long)(r->bus_us / n));
+    if (r->s_hi < r->s_lo) return;
+    double want_hi = r->hz_per_s * r->s_hi, want_lo = r->hz_per_s * r->s_lo;
+    double got_hi = fm_dev_hz(r->du_hi), got_lo = fm_dev_hz(r->du_lo);
+    serial_printf("fm peak: %+.2f / %+.2f Hz (want %+.2f / %+.2f, error %+.3f / %+.3f Hz), carrier %+.3f Hz, "
+                  "step %.3f Hz", 1, got_hi, got_lo, want_hi, want_lo, got_hi - want_hi, got_lo - want_lo,
+                  fm_dev_hz(0), r->saved.actual_hz / (double)r->u0);
+}
+
+static void fm_start(uint8_t ch, uint8_t mode, uint32_t carrier_hz) {
+    fm_run_t *r = &g_fm;
+    if (g_dma_active || g_sna.active || r->active) { serial_printf("ERR: a sweep is already running", 1); return; }
+    if (!ch_ok(ch)) return;
+    if (si5351_ms_is_compact(ch)) { serial_printf("ERR: fm needs CLK0..5 (MS6/7 are integer-only)", 1); return; }
+    if (track_slaves(ch)) { serial_printf("ERR: CLK%u is a track master (slaves would not follow)", 1, ch); return; }
+    if (!g_fm_dev || !carrier_hz) { serial_printf("ERR: carrier and deviation must be > 0", 1); return; }
+
+    uint32_t rate = g_fm_rate;
+    if (!rate) rate = (uint32_t)(FM_RATE_MARGIN * 1e9 / si5351_dma_est_step_ns(FM_AUTO_BYTES, 1, g_bus_hz));
+    rate = si5351_adc_set_rate(rate);
+    double k = (mode == SI5351_FM_MODE_PM) ? g_fm_dev * 1e-3 / 2048.0 * rate / FM_TWO_PI : g_fm_dev / 2048.0;
+    double peak = k * ((mode == SI5351_FM_MODE_PM) ? 4096.0 : 2048.0);    // PM の s は前回との差（±4095）
+    if (peak > carrier_hz * (SI5351_FM_DEV_MAX_PPM * 1e-6)) {
+        serial_printf("ERR: peak deviation %.0f Hz exceeds %u ppm of the carrier", 1, peak,
+                      (unsigned)SI5351_FM_DEV_MAX_PPM);
+        return;
+    }
+
+    // 搬送波を通常の経路で書いてから, その MS を P3=2^19 の形に置き換える
+    stage_t st;
+    int rc = stage_prepare(&st, ch, carrier_hz);
+    if (rc == 0) rc = stage_commit(&st);
+    if (rc != 0) { serial_printf("ERR: no plan for %lu Hz (rc=%d)", 1, (unsigned long)carrier_hz, rc); return; }
+    si5351_cand_t *c = &g_plan->ch[ch].sel;
+    if (c->flags & SI5351_CF_DIVBY4) { serial_printf("ERR: %lu Hz uses MS=4 (fm needs MS >= 8)", 1, (unsigned long)carrier_hz); return; }
+
+    memset(r, 0, sizeof(*r));
+    r->ch = ch;
+    r->mode = mode;
+    r->base = si5351_reg_ms_base(ch);
+    r->carrier_hz = carrier_hz;
+    r->dev = g_fm_dev;
+    r->rate = rate;
+    r->hz_per_s = k;
+    r->saved = *c;
+    r->u_exact = ((double)c->ms.a + (double)c->ms.b / c->ms.c) * (double)(1ull << SI5351_FM_U_SHIFT);
+    r->u0 = (int64_t)(r->u_exact + 0.5);
+    r->s_lo = INT32_MAX;
+    r->s_hi = INT32_MIN;
+    r->x_prev = 2048;
+
+    // du 表（f / (f + Δf) - 1 を MS の分数範囲に収める）
+    const int64_t u_min = ((int64_t)SI5351_MS_FRAC_MIN << SI5351_FM_U_SHIFT) + 1;
+    const int64_t u_max = ((int64_t)SI5351_MS_MAX << SI5351_FM_U_SHIFT) - 1;
+    for (int i = 0; i < SI5351_FM_LUT_N; i++) {
+        double df = k * ((i << SI5351_FM_LUT_SHIFT) - 4096);
+        int64_t u = (int64_t)llround(r->u_exact * c->actual_hz / (c->actual_hz + df));
+        if (u < u_min) u = u_min;
+        if (u > u_max) u = u_max;
+        g_fm_lut[i] = (int32_t)(u - r->u0);
+    }
+
+    c->flags &= (uint8_t)~(SI5351_CF_EVEN_MS | SI5351_CF_INT_MS);     // MS_INT を外す
+    clk_ctrl_update(ch);
+    memset(r->img, 0, sizeof(r->img));
+    r->img[2] = (uint8_t)((c->r_log2 & 0x07) << 4);
+    if (fm_put(r->u0) < 0) { r->errors++; }
+
+    if (g_fm_sim.tone_hz) {
+        for (int i = 0; i < 256; i++) g_fm_sine[i] = (int16_t)lround(2047.0 * sin(FM_TWO_PI * i / 256.0));
+        g_fm_sim.inc = (uint32_t)((double)g_fm_sim.tone_hz * 4294967296.0 / rate);
+        g_fm_sim.phase = 0;
+        si5351_adc_set_sim(fm_sim_fill, &g_fm_sim);
+    } else {
+        si5351_adc_set_sim(NULL, NULL);
+    }
+    if (r->errors || si5351_adc_ring_start(g_fm_ring, SI5351_FM_RING_LOG2) != 0) {
+        serial_printf("ERR: %s", 1, r->errors ? "I2C write failed" : "ADC unavailable");
+        *c = r->saved;
+        ms_apply(ch);
+        clk_ctrl_update(ch);
+        return;
+    }
+    si5351_mem_use(g_mem_fm, (2u << SI5351_FM_RING_LOG2) + SI5351_FM_LUT_N * 4u);
+
+    if (mode == SI5351_FM_MODE_PM)
+        serial_printf("pm: CLK%u %lu Hz, peak %lu mrad (%.1f Hz for a full-scale step)", 0, ch,
+                      (unsigned long)carrier_hz, (unsigned long)r->dev, peak);
+    else
+        serial_printf("fm: CLK%u %lu Hz, deviation %lu Hz", 0, ch, (unsigned long)carrier_hz, (unsigned long)r->dev);
+    serial_printf(", %lu updates/s%s (bus %lu kHz), step %.3f Hz, input %s (fm stop to end)", 1, (unsigned long)rate,
+                  g_fm_rate ? "" : " auto", (unsigned long)(g_bus_hz / 1000u), c->actual_hz / (double)r->u0,
+                  g_fm_sim.tone_hz ? "simulated tone" : "ADC");
+    g_fm_stop_req = false;
+    r->t0 = time_us_64();
+    r->t_rep = (uint32_t)r->t0;
+    r->seen = 0;
+    r->active = true;
+    g_busy = true;          // 変調中はアラーム・トリガ IRQ の書込みを見送らせる
+}
+
+static void fm_finish(void) {
+    fm_run_t *r = &g_fm;
+    si5351_adc_stop();
+    r->elapsed_us = (uint32_t)(time_us_64() - r->t0);
+    r->active = false;
+    g_plan->ch[r->ch].sel = r->saved;       // 搬送波の MS 像と MS_INT に戻す
+    ms_apply(r->ch);
+    clk_ctrl_update(r->ch);
+    g_busy = false;
+    fm_report(true);
+}
+
+// 変調中のポーリング（エンジン文脈, FM_POLL_US ずつ）。変調中なら true
+static bool fm_poll(void) {
+    fm_run_t *r = &g_fm;
+    if (!r->active) return false;
+    uint32_t t0 = time_us_32();
+    while (!g_fm_stop_req && !r->errors && time_us_32() - t0 < FM_POLL_US) {
+        uint32_t cnt = si5351_adc_ring_count();
+        if (cnt == r->seen) continue;
+        r->dropped += cnt - r->seen - 1u;
+        r->seen = cnt;
+        fm_write(g_fm_ring[(cnt - 1u) & ((1u << SI5351_FM_RING_LOG2) - 1u)] & 0x0FFFu);
+    }
+    if (g_fm_stop_req || r->errors) {
+        fm_finish();
+        g_fm_stop_req = false;
+        return false;
+    }
+    if (time_us_32() - r->t_rep >= SI5351_FM_REPORT_US) fm_report(false);
+    return true;
+}
+
+static void fm_sim_set(uint32_t tone_hz) {
+    if (g_fm.active) { serial_printf("ERR: fm is running", 1); return; }
+    g_fm_sim.tone_hz = tone_hz;
+    if (tone_hz) serial_printf("fm sim: %lu Hz tone at %lu %% of full scale", 1, (unsigned long)tone_hz,
+                               (unsigned long)g_fm_sim.level);
+    else         serial_printf("fm sim: off (ADC GPIO%u)", 1, (unsigned)SI5351_ADC_GPIO);
+}
+
+static void fm_show(void) {
+    const fm_run_t *r = &g_fm;
+    serial_printf("fm: deviation %lu (Hz for fm, mrad for pm), rate %s%lu updates/s, input %s", 1,
+                  (unsigned long)g_fm_dev, g_fm_rate ? "" : "auto ~",
+                  (unsigned long)(g_fm_rate ? g_fm_rate
+                                            : (uint32_t)(FM_RATE_MARGIN * 1e9 /
+                                                         si5351_dma_est_step_ns(FM_AUTO_BYTES, 1, g_bus_hz))),
+                  g_fm_sim.tone_hz ? "simulated tone" : "ADC");
+    if (r->updates || r->errors) {
+        serial_printf("fm: last run CLK%u %lu Hz", 1, r->ch, (unsigned long)r->carrier_hz);
+        fm_report(true);
+    }
+}
+
+// ===== 操作リング =====
+static si5351_opq_t g_opq;
+
+static void engine_status(void) {
+    uint8_t s=0, oe=0, c0=0;
+    rd8(REG_STAT0,&s); rd8(REG_OE,&oe); rd8(REG_CLK0_CTRL,&c0);
+    serial_printf("STAT0=0x%02X  OE=0x%02X  CLK0_CTRL=0x%02X",1,s,oe,c0);
+    // 参考: STAT0 bits: SYS_INIT=bit7, LOL_B=6, LOL_A=5, LOS=4
+    lock_show();
+}
+
+static void engine_peek(uint8_t reg) {
+    uint8_t v=0xFF;
+    if (bus_read(reg,&v,1)==0)
+        serial_printf("REG[0x%02X]=0x%02X",1,(unsigned)reg,v);
+    else
+        serial_printf("READ FAIL reg=0x%02X",1,(unsigned)reg);
+}
+
+static void engine_force_on(void) {
+    // 1) 全閉 → 2) CLK0だけ開 → 3) CLK0_CTRL=0x4F
+    oe_mask_all(0xFF);
+    oe_mask_all(0xFE);
+    clk_ctrl_set(REG_CLK0_CTRL, 0x4F);
+    // 読みバック
+    uint8_t oe=0, c0=0; rd8(REG_OE,&oe); rd8(REG_CLK0_CTRL,&c0);
+    serial_printf("FORCE: OE=0x%02X CLK0_CTRL=0x%02X",1,oe,c0);
+}
+
+static void engine_chip(uint8_t id) {
+    bool ref_fallback = false;
+    if (id < SI5351_CHIP_COUNT) {
+        const si5351_chip_t *c = &si5351_chips[id];
+        // 新チップに存在しない出力はプランから外す
+        for (unsigned ch = c->n_out; ch < g_chip->n_out; ch++) {
+            si5351_plan_release(g_plan, ch);
+            g_parked_valid[ch] = false;
+        }
+        g_chip = c;
+        uint8_t released = si5351_plan_set_chip(g_plan, g_chip), moved = 0, lost = 0;
+        // CLKIN のないチップでは水晶に戻す（解き直し・止めたチャネルの表示・reg 15 と PLL の書き直しは set_ref が行う）
+        if (!g_chip->has_clkin && g_ref_src == REF_CLKIN) {
+            si5351_set_ref(REF_XTAL, 0);
+            ref_fallback = true;
+        }
+        // 使えなくなった PLLB に載っていたチャネルは PLLA で解き直す（解けなければ止める）
+        for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+            if (!((released >> ch) & 1u)) continue;
+            g_parked_valid[ch] = false;
+            if (si5351_plan_channel(g_plan, ch, g_plan->ch[ch].sel.target_hz) == 0) moved |= (uint8_t)(1u << ch);
+            else lost |= (uint8_t)(1u << ch);
+        }
+        if (lost) {
+            serial_printf("WARN: no plan without PLLB, stopped:", 0);
+            stop_lost(lost);
+        }
+        if (moved && group_commit(moved) < 0) {
+            serial_printf("ERR: re-plan write failed, CLKx_CTRL/OE left unchanged (run clk again)", 1);
+            moved = 0;
+        }
+        for (unsigned ch = 0; ch < g_chip->n_out; ch++)
+            if ((moved >> ch) & 1u) serial_printf("CLK%u moved to PLLA (err=%.3f ppb)", 1, ch, g_plan->ch[ch].sel.err_ppb);
+    }
+    serial_printf("chip: Si5351%s  outputs=%u  MS6/7 compact=%s  VCXO=%s  CLKIN=%s", 1,
+                  g_chip->name, g_chip->n_out, g_chip->n_out > SI5351_MS_FULL_MAX ? "yes" : "no",
+                  g_chip->has_vcxo ? "yes (PLLB reserved)" : "no",
+                  g_chip->has_clkin ? "yes" : ref_fallback ? "no (reference switched back to XTAL)" : "no");
+}
+
+static void engine_power(uint8_t policy) {
+    if (policy != SI5351_OP_ARG_NONE) {
+        g_power_policy = (power_policy_t)policy;
+        // 既に停止中のチャネルへポリシーを反映（未設定の MS は常に PD のまま）
+        for (unsigned c = 0; c < g_chip->n_out; c++) {
+            if (g_plan->ch[c].active) continue;
+            g_clk_cfg[c].powered = (g_power_policy == PWR_OE_ONLY) && g_parked_valid[c];
+            clk_ctrl_update(c);
+        }
+    }
+    cmd_power_show();
+}
+
+static void engine_bench_cf(uint32_t n) {
+    si5351_cf_bench_t r;
+    si5351_cf_bench(n, &r);
+    serial_printf("bench cf n=%lu (VCO=800MHz, MS ratio, c<=%lu)", 1, (unsigned long)n, (unsigned long)SI5351_FRAC_MAX_DEN);
+    serial_printf("  random      : %7.2f us/solve  %5.2f steps/solve", 1,
+                  (double)r.random_us / n, (double)r.random_steps / n);
+    serial_printf("  1Hz cold    : %7.2f us/solve  %5.2f steps/solve", 1,
+                  (double)r.seq_cold_us / n, (double)r.seq_cold_steps / n);
+    serial_printf("  1Hz warm    : %7.2f us/solve  %5.2f steps/solve  (warm hits %lu/%lu)", 1,
+                  (double)r.seq_warm_us / n, (double)r.seq_warm_steps / n,
+                  (unsigned long)r.seq_warm_hits, (unsigned long)n);
+}
+
+// ===== ISR 遅延ベンチ（bench isr） =====
+// 空きユーザ IRQ をソフトウェアで保留にし、保留→ハンドラ入口と保留→I2C STOP を SysTick（clk_sys）で測る。
+// ハンドラの中身は予約／トリガの IRQ と同じ stage_commit（動作中チャネルの現在値を書き直すだけなので出力は変わらない）。
+typedef struct {
+    uint32_t entry_min, entry_max, done_min, done_max;
+    uint64_t entry_sum, done_sum;
+} isrb_stats_t;
+
+static int               g_isrb_irq = -1;
+static stage_t           g_isrb_st;
+static bool              g_isrb_staged;      // false なら OE を書き直すだけ（動作中チャネルなし）
+static volatile uint32_t g_isrb_t_pend, g_isrb_t_entry, g_isrb_t_done;
+
+static void SI5351_HOT(isrb_irq)(void) {
+    g_isrb_t_entry = systick_hw->cvr;
+    g_in_irq = true;
+    uint8_t ctx = si5351_trace_ctx;
+    si5351_trace_ctx = SI5351_TR_CTX_ISR;
+    if (g_isrb_staged) {
+        (void)stage_commit(&g_isrb_st);
+    } else {
+        uint8_t oe = 0xFF;
+        if (rd8_cached(REG_OE, &oe) == 0) (void)wr8(REG_OE, oe);
+    }
+    si5351_trace_ctx = ctx;
+    g_in_irq = false;
+    g_isrb_t_done = systick_hw->cvr;
+}
+
+// 測定側は構成によらず SRAM に置く（cold ではここで XIP キャッシュを捨ててから保留にする）
+static void __not_in_flash_func(isrb_shot)(uint irq, bool cold) {
+    if (cold) {
+        xip_ctrl_hw->flush = 1;
+        (void)xip_ctrl_hw->flush;                   // 読出しはフラッシュ完了まで待たされる
+    }
+    g_isrb_t_pend = systick_hw->cvr;
+    *(volatile uint32_t *)(PPB_BASE + M0PLUS_NVIC_ISPR_OFFSET) = 1u << irq;
+    __dsb();
+    __isb();
+}
+
+static void isrb_run(uint irq, bool cold, uint32_t n, isrb_stats_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->entry_min = r->done_min = UINT32_MAX;
+    isrb_shot(irq, false);                          // 初回の分岐予測・シャドウを温める
+    for (uint32_t i = 0; i < n; i++) {
+        isrb_shot(irq, cold);
+        uint32_t entry = (g_isrb_t_pend - g_isrb_t_entry) & 0x00FFFFFFu;   // SysTick は減算カウンタ
+        uint32_t done  = (g_isrb_t_pend - g_isrb_t_done)  & 0x00FFFFFFu;
+        r->entry_sum += entry;
+        r->done_sum  += done;
+        if (entry < r->entry_min) r->entry_min = entry;
+        if (entry > r->entry_max) r->entry_max = entry;
+        if (done < r->done_min) r->done_min = done;
+        if (done > r->done_max) r->done_max = done;
+    }
+}
+
+static void isrb_print(const char *tag, const isrb_stats_t *r, uint32_t n, double ns_per_cyc) {
+    serial_printf("  %s entry : %6.2f / %6.2f / %6.2f us   commit %7.1f / %7.1f / %7.1f us", 1, tag,
+                  r->entry_min * ns_per_cyc / 1000.0, (double)r->entry_sum / n * ns_per_cyc / 1000.0,
+                  r->entry_max * ns_per_cyc / 1000.0,
+                  r->done_min * ns_per_cyc / 1000.0, (double)r->done_sum / n * ns_per_cyc / 1000.0,
+                  r->done_max * ns_per_cyc / 1000.0);
+}
+
+static void engine_bench_isr(uint32_t n) {
+    if (g_isrb_irq < 0) g_isrb_irq = user_irq_claim_unused(false);
+    if (g_isrb_irq < 0) { serial_printf("ERR: no spare user IRQ", 1); return; }
+
+    int ch = -1;
+    for (unsigned i = 0; i < g_chip->n_out && ch < 0; i++)
+        if (g_plan->ch[i].active && !si5351_ms_is_compact(i)) ch = (int)i;
+    double fine_hz = 0.0;
+    g_isrb_staged = ch >= 0;
+    if (g_isrb_staged) {
+        // 現在の採用候補をそのまま像にする（fine の PLL 帰還も含む）
+        const si5351_cand_t *c = &g_plan->ch[ch].sel;
+        memset(&g_isrb_st, 0, sizeof(g_isrb_st));
+        g_isrb_st.ch   = (uint8_t)ch;
+        g_isrb_st.hz   = c->target_hz;
+        g_isrb_st.cand = *c;
+        si5351_encode_pll(&c->fb, g_isrb_st.pll_img);
+        si5351_encode_ms(&c->ms, c->r_log2, (c->flags & SI5351_CF_DIVBY4) != 0, g_isrb_st.ms_img);
+        fine_hz = g_plan->ch[ch].fine_hz;
+    }
+
+    systick_hw->rvr = 0x00FFFFFFu;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_ENABLE_BITS | M0PLUS_SYST_CSR_CLKSOURCE_BITS;
+    irq_set_exclusive_handler((uint)g_isrb_irq, isrb_irq);
+    irq_set_enabled((uint)g_isrb_irq, true);
+
+    isrb_stats_t warm, cold;
+    isrb_run((uint)g_isrb_irq, false, n, &warm);
+    isrb_run((uint)g_isrb_irq, true,  n, &cold);
+
+    irq_set_enabled((uint)g_isrb_irq, false);
+    irq_remove_handler((uint)g_isrb_irq, isrb_irq);
+    if (g_isrb_staged) g_plan->ch[ch].fine_hz = fine_hz;   // adopt が 0 に戻すので復元
+
+    double ns_per_cyc = 1e9 / (double)clock_get_hz(clk_sys);
+    serial_printf("bench isr n=%lu  hot path: %s (SI5351_HOT_IN_RAM=%d)  clk_sys=%lu MHz", 1,
+                  (unsigned long)n, SI5351_HOT_IN_RAM ? "SRAM" : "XIP flash", SI5351_HOT_IN_RAM,
+                  (unsigned long)(clock_get_hz(clk_sys) / 1000000u));
+    if (g_isrb_staged)
+        serial_printf("  handler    : CLK%d staged commit (same value: adopt + shadow diff + OE write)", 1, ch);
+    else
+        serial_printf("  handler    : OE rewrite (no running CLK0..5)", 1);
+    serial_printf("                min / avg / max: pend->entry, pend->I2C STOP", 1);
+    isrb_print("warm", &warm, n, ns_per_cyc);
+    isrb_print("cold", &cold, n, ns_per_cyc);
+    serial_printf("  cold = XIP cache flushed before each IRQ (worst case); rebuild with the other", 1);
+    serial_printf("         SI5351_HOT_IN_RAM setting to compare", 1);
+}
+
+// ===== 再起動をまたぐ状態（ウォッチドッグの保持領域, si5351_wdt.h） =====
+// シャドウ・採用候補・出力設定を写す。予約（at）・トリガ表・DMA 列は戻さない。
+typedef struct {
+    uint32_t      version;
+    uint8_t       chip_id, ref_src, clkin_div_log2, power_policy;
+    uint32_t      clkin_hz;
+    uint8_t       active_mask;
+    uint8_t       shadow[256];
+    uint32_t      shadow_valid[256 / 32];
+    clk_cfg_t     cfg[SI5351_MAX_OUT];
+    si5351_cand_t sel[SI5351_MAX_OUT];
+    double        fine_hz[SI5351_MAX_OUT];
+} keep_t;
+
+#define KEEP_VERSION    (0x4B700000u | (uint32_t)sizeof(keep_t))   // 形式が変わったら採用しない
+
+_Static_assert(sizeof(keep_t) <= SI5351_WDT_KEEP_BYTES, "keep_t exceeds the watchdog keep area");
+
+typedef struct {
+    bool     done;
+    int      rc;                // 0=復元, -1=保持内容なし, -2=プラン不整合, -3=I2C 失敗
+    uint8_t  active_mask;
+    bool     pll_reset;         // チップ側が構成を失っていたので PLL をリセットした
+    uint32_t bytes, elapsed_us;
+} restore_t;
+
+static restore_t g_restore;
+
+static void keep_save(void) {
+    keep_t *k = si5351_wdt_keep_buf();
+    g_keep_dirty = false;       // 写している間の IRQ 書込みは次回に回る
+    k->version        = KEEP_VERSION;
+    k->chip_id        = (uint8_t)(g_chip - si5351_chips);
+    k->ref_src        = (uint8_t)g_ref_src;
+    k->clkin_div_log2 = g_clkin_div_log2;
+    k->power_policy   = (uint8_t)g_power_policy;
+    k->clkin_hz       = g_clkin_hz;
+    memcpy(k->shadow, g_shadow, 256);
+    memcpy(k->shadow_valid, g_shadow_valid, 256 / 8);
+    memcpy(k->cfg, g_clk_cfg, sizeof(k->cfg));
+    k->active_mask = 0;
+    for (unsigned ch = 0; ch < SI5351_MAX_OUT; ch++) {
+        if (!g_plan->ch[ch].active) continue;
+        k->active_mask |= (uint8_t)(1u << ch);
+        k->sel[ch]     = g_plan->ch[ch].sel;
+        k->fine_hz[ch] = g_plan->ch[ch].fine_hz;
+    }
+    si5351_wdt_keep_commit(sizeof(*k));
+}
+
+// 書き戻さないレジスタ: 状態（0..2, 読取り専用・スティッキー）, PLL リセット, OE（最後に書く）
+static inline bool keep_skip(unsigned reg) {
+    return reg <= 2u || reg == REG_OE || reg == REG_PLL_RESET;
+}
+
+// シャドウの像を連続区間ごとに 8 バイトずつ書く。チップが構成を保っていれば同じ値の上書きで出力は乱れない
+static int image_rewrite(void) {
+    int bytes = 0;
+    for (unsigned r = 0; r < 256;) {
+        if (!shadow_has((uint8_t)r) || keep_skip(r)) { r++; continue; }
+        unsigned n = 0;
+        while (n < 8 && r + n < 256 && shadow_has((uint8_t)(r + n)) && !keep_skip(r + n)) n++;
+        if (bus_write((uint8_t)r, &g_shadow[r], (uint8_t)n) != 0) return -1;
+        bytes += (int)n;
+        r += n;
+    }
+    if (shadow_has(REG_OE)) {
+        if (bus_write(REG_OE, &g_shadow[REG_OE], 1) != 0) return -1;
+        bytes++;
+    }
+    return bytes;
+}
+
+// 使用中 PLL のリセットビット（REG_PLL_RESET: bit5=PLLA, bit7=PLLB）
+static uint8_t pll_reset_bits(void) {
+    return (uint8_t)((g_plan->pll[0].users ? 0x20 : 0) | (g_plan->pll[1].users ? 0x80 : 0));
+}
+
+// 保持内容をプラン・シャドウ・出力設定へ戻してチップへ書く（エンジン文脈, 起動直後に 1 回）
+static void keep_restore(void) {
+    uint32_t len = 0, t0 = time_us_32();
+    const keep_t *k = si5351_wdt_kept(&len);
+    g_restore.done = true;
+    g_restore.rc = -1;
+    if (!k || len != sizeof(*k) || k->version != KEEP_VERSION || k->chip_id >= SI5351_CHIP_COUNT) return;
+
+    g_chip = &si5351_chips[k->chip_id];
+    g_ref_src = (ref_src_t)k->ref_src;
+    g_clkin_hz = k->clkin_hz;
+    g_clkin_div_log2 = k->clkin_div_log2;
+    g_power_policy = (power_policy_t)k->power_policy;
+    memcpy(g_clk_cfg, k->cfg, sizeof(g_clk_cfg));
+    si5351_plan_init(g_plan);
+    si5351_plan_set_chip(g_plan, g_chip);
+    (void)si5351_plan_set_ref(g_plan, ref_pfd_hz());
+
+    // 採用候補を戻す（PLL 帰還を先に置くので, 共有 PLL の 2 本目以降も同じ帰還として採用される）
+    g_restore.rc = -2;
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++)
+        if ((k->active_mask >> ch) & 1u) g_plan->pll[k->sel[ch].pll & 1u].fb = k->sel[ch].fb;
+    for (unsigned ch = 0; ch < g_chip->n_out; ch++) {
+        if (!((k->active_mask >> ch) & 1u)) continue;
+        if (si5351_plan_adopt(g_plan, ch, &k->sel[ch]) != 0) { si5351_plan_init(g_plan); return; }
+        g_plan->ch[ch].fine_hz = k->fine_hz[ch];
+    }
+    g_restore.active_mask = k->active_mask;
+
+    memcpy(g_shadow, k->shadow, 256);
+    memcpy(g_shadow_valid, k->shadow_valid, 256 / 8);
+    int n = image_rewrite();
+    if (n < 0) { shadow_invalidate(); g_restore.rc = -3; return; }
+    g_restore.bytes = (uint32_t)n;
+
+    // チップが電源を失っていた（SYS_INIT / 使用中 PLL の LOL）ときだけ PLL をリセットする
+    uint8_t st = 0, rst = pll_reset_bits(), lost = 0x80;
+    if (rst & 0x20) lost |= 0x20;
+    if (rst & 0x80) lost |= 0x40;
+    if (rst && rd8(REG_STAT0, &st) == 0 && (st & lost)) {
+        (void)pll_reset(rst);
+        g_restore.pll_reset = true;
+    }
+    g_restore.elapsed_us = time_us_32() - t0;
+    g_restore.rc = 0;
+}
+
+static void restore_show(void) {
+    static const char *const k_why[] = { "restored", "no snapshot", "plan mismatch", "I2C write failed" };
+    if (!g_restore.done) { serial_printf("restore: not attempted (cold boot)", 1); return; }
+    const restore_t *r = &g_restore;
+    serial_printf("restore: %s", 0, k_why[-r->rc]);
+    if (r->rc == 0)
+        serial_printf(", %lu byte(s) in %lu us, active mask 0x%02X%s", 0, (unsigned long)r->bytes,
+                      (unsigned long)r->elapsed_us, r->active_mask,
+                      r->pll_reset ? ", PLL reset (chip had lost its configuration)" : ", no PLL reset");
+    serial_printf("", 1);
+}
+
+// 1 操作を実行（エンジン文脈のみ）
+static void engine_exec(const si5351_op_t *op) {
+    switch ((si5351_opcode_t)op->code) {
+    case SI5351_OP_NOP:      break;
+    case SI5351_OP_CALL:     if (op->v.fn) op->v.fn(); break;
+    case SI5351_OP_INIT:     si5351_init_basic(); break;
+    case SI5351_OP_SCAN:     si5351_boot_scan(); break;
+    case SI5351_OP_STATUS:   engine_status(); break;
+    case SI5351_OP_PEEK:     engine_peek(op->b0); break;
+    case SI5351_OP_POKE:     (void)wr8(op->b0, op->b1); break;
+    case SI5351_OP_FORCE_ON: engine_force_on(); break;
+    case SI5351_OP_OE:
+        oe_mask_all(op->b0 ? 0x00 : 0xFF);
+        serial_printf(op->b0 ? "OE: ON (all enabled)" : "OE: OFF (all disabled)", 1);
+        break;
+    case SI5351_OP_FREQ:     si5351_set_freq_ch(op->ch, op->v.u); break;
+    case SI5351_OP_FINE:     si5351_fine_ch(op->ch, op->v.i / 1000.0); break;
+    case SI5351_OP_DRIVE:
+    case SI5351_OP_INVERT:
+    case SI5351_OP_IDLE:
+        if (!ch_ok(op->ch)) break;
+        if (op->code == SI5351_OP_DRIVE)       g_clk_cfg[op->ch].drive_ma = op->b0;
+        else if (op->code == SI5351_OP_INVERT) g_clk_cfg[op->ch].invert = op->b0 != 0;
+        else                                   g_clk_cfg[op->ch].dis_state = op->b0 & 3u;
+        if (op->code == SI5351_OP_IDLE) dis_state_update();
+        else clk_ctrl_update(op->ch);
+        cmd_cfg_show();
+        break;
+    case SI5351_OP_CFG:      cmd_cfg_show(); break;
+    case SI5351_OP_POWER:    engine_power(op->b0); break;
+    case SI5351_OP_CHIP:     engine_chip(op->b0); break;
+    case SI5351_OP_REF:
+        if (op->b0 == SI5351_OP_ARG_NONE) {
+            serial_printf("REF = %s, PLL input %lu Hz", 1, (g_ref_src == REF_CLKIN) ? "CLKIN" : "XTAL",
+                          (unsigned long)ref_pfd_hz());
+        } else {
+            si5351_set_ref(op->b0 ? REF_CLKIN : REF_XTAL, op->v.u ? op->v.u : g_clkin_hz);
+        }
+        break;
+    case SI5351_OP_PLAN_SHOW:    cmd_plan_show(); break;
+    case SI5351_OP_PLAN_EXPLAIN: cmd_plan_explain(op->ch); break;
+    case SI5351_OP_PLAN_BUDGET:
+        if (op->b0 != SI5351_OP_ARG_NONE) g_plan->budget_us = op->v.u;
+        serial_printf("plan budget=%lu us", 1, (unsigned long)g_plan->budget_us);
+        break;
+    case SI5351_OP_BENCH_CF: engine_bench_cf(op->v.u); break;
+    case SI5351_OP_BENCH_ISR: engine_bench_isr(op->v.u); break;
+    case SI5351_OP_AT:
+        g_at_prefix_t = ((uint64_t)op->b0 << 40) | ((uint64_t)op->b1 << 32) | op->v.u;
+        g_at_prefix = true;
+        break;
+    case SI5351_OP_AT_LIST:  at_list(); break;
+    case SI5351_OP_AT_CLEAR: at_clear(); break;
+    case SI5351_OP_TRIG_LOAD: trig_load(op->ch, op->b0 != 0, op->v.u); break;
+    case SI5351_OP_TRIG_ARM:  trig_arm(op->b0, op->b1); break;
+    case SI5351_OP_TRIG_OFF:  trig_off(); break;
+    case SI5351_OP_TRIG_SHOW: trig_show(); break;
+    case SI5351_OP_DMA_PARAM:
+        if (op->b0 == SI5351_DMA_P_STOP_HZ)     g_dma_stop_hz = op->v.u;
+        else if (op->b0 == SI5351_DMA_P_POINTS) g_dma_points  = op->v.u;
+        else                                    g_dma_rate_hz = op->v.u;
+        break;
+    case SI5351_OP_DMA_SWEEP:
+        dma_build(op->ch, op->v.u);
+        if (g_dma_valid) dma_start(g_dma_rate_hz);
+        break;
+    case SI5351_OP_DMA_PLAY:  dma_start(op->b0 == SI5351_OP_ARG_NONE ? g_dma_rate_hz : op->v.u); break;
+    case SI5351_OP_DMA_SHOW:  dma_show(); break;
+    case SI5351_OP_DMA_BENCH: dma_bench(); break;
+    case SI5351_OP_TRACE:     si5351_trace_op(op->b0, op->v.u); break;
+    case SI5351_OP_HOP_PREP:  hop_prep(op->ch, op->v.u); break;
+    case SI5351_OP_HOP_GO:    hop_go(); break;
+    case SI5351_OP_HOP_SHOW:  hop_show(); break;
+    case SI5351_OP_TRACK:     track_set(op->b0, op->ch, op->v.i); break;
+    case SI5351_OP_TRACK_SHOW: track_show(); break;
+    case SI5351_OP_SNA_PARAM:
+        if (op->b0 == SI5351_SNA_P_STOP_HZ)        g_sna_stop_hz   = op->v.u;
+        else if (op->b0 == SI5351_SNA_P_POINTS)    g_sna_points    = op->v.u;
+        else if (op->b0 == SI5351_SNA_P_SAMPLES)   g_sna_samples   = op->v.u;
+        else if (op->b0 == SI5351_SNA_P_SETTLE_US) g_sna_settle_us = op->v.u;
+        else                                       g_sna_sim.bw_hz = op->v.u ? op->v.u : 1u;
+        break;
+    case SI5351_OP_SNA:       sna_start(op->v.u); break;
+    case SI5351_OP_SNA_SIM:   sna_sim_set(op->b0, op->v.u); break;
+    case SI5351_OP_SNA_SHOW:  sna_show(); break;
+    case SI5351_OP_FM_PARAM:
+        if (op->b0 == SI5351_FM_P_DEV)       g_fm_dev = op->v.u;
+        else if (op->b0 == SI5351_FM_P_RATE) g_fm_rate = op->v.u;
+        else                                 g_fm_sim.level = op->v.u > 100u ? 100u : op->v.u;
+        break;
+    case SI5351_OP_FM:        fm_start(op->ch, op->b0, op->v.u); break;
+    case SI5351_OP_FM_SIM:    fm_sim_set(op->v.u); break;
+    case SI5351_OP_FM_SHOW:   fm_show(); break;
+    case SI5351_OP_PING:      si5351_boot_ping(); break;
+    default:
+        serial_printf("[ENG] unknown op %u", 1, op->code);
+        break;
+    }
+}
+
+// IRQ が見送ったトリガ・予約をエンジン文脈で処理（IRQ なし構成の予約もここ）
+static void SI5351_HOT(engine_service_deferred)(void) {
+    if (g_dma_active) return;       // DMA がバスを使用中
+    if (g_lock_pending) (void)pll_settle(g_lock_pending, false);
+    if (g_trig_pending) {
+        g_busy = true;
+        uint64_t t_edge = g_trig_t_edge;
+        g_trig_pending = false;
+        trig_fire(t_edge);
+        g_busy = false;
+    }
+    uint64_t t;
+    if (g_alarm < 0 && si5351_sched_peek(&g_sched, &t, NULL) && t <= time_us_64()) g_at_due = true;
+    if (!g_at_due) return;
+    g_busy = true;
+    g_at_due = false;
+    at_service(false);
+    g_busy = g_dma_active || g_sna.active || g_fm.active;  // 予約された dma / sna / fm 操作なら続く
+}
+
+unsigned SI5351_HOT(si5351_engine_poll)(unsigned max) {
+    unsigned n = 0;
+    const si5351_op_t *op;
+    g_beat++;
+    if (dma_poll() || sna_poll() || fm_poll()) return 0;    // DMA 再生・sna 掃引・fm 変調中は後続の操作を待たせる
+    engine_service_deferred();
+    while (n < max && !g_dma_active && !g_sna.active && !g_fm.active && (op = si5351_opq_front(&g_opq)) != NULL) {
+        si5351_op_t o = *op;    // 実行中もスロットは占有したまま（idle 判定のため）
+        g_busy = true;
+        si5351_wdt_note(&o);    // 実行前に記録（この操作で止まっても残る）
+        if (g_at_prefix && o.code != SI5351_OP_AT) {
+            g_at_prefix = false;
+            at_schedule(&o, g_at_prefix_t);
+        } else {
+            si5351_trace_ctx = o.code;
+            engine_exec(&o);
+            si5351_trace_ctx = SI5351_TR_CTX_NONE;
+        }
+        g_busy = g_dma_active || g_sna.active || g_fm.active;
+        g_keep_dirty = true;
+        si5351_opq_pop(&g_opq);
+        n++;
+        engine_service_deferred();    // 実行中に期限が来た予約をすぐ処理
+    }
+    at_report();
+    if (g_keep_dirty && !g_dma_active) keep_save();
+    return n;
+}
+
+#if SI5351_ENGINE_CORE1
+static void engine_core1_main(void) {
+    flash_safe_execute_core_init();     // マクロ保存時のフラッシュ書込み中は core1 を止める
+    at_init();
+    for (;;) {
+        if (si5351_engine_poll(1) == 0) tight_loop_contents();
+    }
+}
+#endif
+
+// ===== 初期化 =====
+// 固定サイズの状態をアリーナから切り出し、残りを掃引列に回す
+static bool engine_alloc(void) {
+    int id;
+    si5351_op_t *opq = si5351_mem_alloc("op ring", SI5351_OPQ_LEN * (uint32_t)sizeof(si5351_op_t), &g_mem_opq);
+    g_shadow       = si5351_mem_alloc("shadow", 256, &id);
+    if (g_shadow) si5351_mem_use(id, 256);
+    g_shadow_valid = si5351_mem_alloc("shadow valid", 256 / 8, &id);
+    if (g_shadow_valid) si5351_mem_use(id, 256 / 8);
+    g_plan         = si5351_mem_alloc("plan", (uint32_t)sizeof(si5351_plan_t), &id);
+    if (g_plan) si5351_mem_use(id, (uint32_t)sizeof(si5351_plan_t));
+    g_at           = si5351_mem_alloc("at", SI5351_SCHED_MAX * (uint32_t)sizeof(at_entry_t), &g_mem_at);
+    g_trig_step    = si5351_mem_alloc("trig", SI5351_TRIG_STEPS * (uint32_t)sizeof(stage_t), &g_mem_trig);
+    g_dma_words    = si5351_mem_alloc("dma words", 2u * (uint32_t)sizeof(*g_dma_words), &g_mem_dma);
+    g_dma_ctrl     = si5351_mem_alloc("dma ctrl", 2u * (uint32_t)sizeof(*g_dma_ctrl), &g_mem_dmac);
+    bool trace     = si5351_trace_init();
+    g_sna_buf      = si5351_mem_alloc("sna", SI5351_SNA_SAMPLES_MAX * 2u, &g_mem_sna);
+    g_fm_ring      = si5351_mem_alloc_aligned("fm", (2u << SI5351_FM_RING_LOG2) + SI5351_FM_LUT_N * 4u,
+                                              2u << SI5351_FM_RING_LOG2, &g_mem_fm);
+    g_fm_lut       = g_fm_ring ? (int32_t *)&g_fm_ring[1u << SI5351_FM_RING_LOG2] : NULL;
+    g_seq_buf      = si5351_mem_alloc_rest("seq", 1024u, &g_seq_cap, &g_mem_seq);
+    if (!opq || !g_shadow || !g_shadow_valid || !g_plan || !g_at || !g_trig_step || !g_dma_words || !g_dma_ctrl ||
+        !trace || !g_sna_buf || !g_fm_ring || !g_seq_buf)
+        return false;
+    si5351_opq_init(&g_opq, opq);
+    return true;
+}
+
+// 現在の使用量をアリーナ表へ反映（mem 表示の直前に呼ぶ）
+void si5351_engine_mem_sync(void) {
+    si5351_mem_use(g_mem_opq, g_opq.hwm * (uint32_t)sizeof(si5351_op_t));
+    si5351_mem_use(g_mem_opq, si5351_opq_depth(&g_opq) * (uint32_t)sizeof(si5351_op_t));
+    si5351_mem_use(g_mem_at, g_sched.n * (uint32_t)sizeof(at_entry_t));
+    si5351_mem_use(g_mem_trig, g_trig_n * (uint32_t)sizeof(stage_t));
+}
+
+void si5351_engine_init(i2c_inst_t *port, uint8_t addr) {
+    g_i2c = port;
+    g_addr = addr & 0x7F;
+    if (!engine_alloc()) {
+        serial_printf("[MEM] arena too small (%lu bytes, used %lu)", 1,
+                      (unsigned long)SI5351_ARENA_BYTES, (unsigned long)si5351_mem_allocated());
+        while (1) tight_loop_contents();
+    }
+    si5351_plan_init(g_plan);
+    si5351_plan_set_chip(g_plan, g_chip);
+#if SI5351_ENGINE_CORE1
+    multicore_launch_core1(engine_core1_main);
+#else
+    at_init();
+#endif
+    serial_printf("[ENG] I2C addr=0x%02X, op ring %u, %s", 1, g_addr, SI5351_OPQ_LEN,
+                  SI5351_ENGINE_CORE1 ? "core1" : "polled on core0");
+}
+
+// ===== 投入（生産者側） =====
+bool si5351_engine_submit(const si5351_op_t *op) {
+    if (si5351_opq_push(&g_opq, op)) return true;
+    g_opq.full_events++;
+    g_opq.dropped++;
+    return false;
+}
+
+void si5351_engine_submit_wait(const si5351_op_t *op) {
+    if (si5351_opq_push(&g_opq, op)) return;
+
+    // 背圧: 満杯の間は待つ（単一コアでは自分でエンジンを 1 件進める）
+    g_opq.full_events++;
+    uint32_t t0 = time_us_32();
+    while (!si5351_opq_push(&g_opq, op)) {
+        si5351_wdt_kick();
+#if SI5351_ENGINE_CORE1
+        tight_loop_contents();
+#else
+        (void)si5351_engine_poll(1);
+#endif
+    }
+    g_opq.stall_us += time_us_32() - t0;
+}
+
+void si5351_engine_submit_at(uint64_t t_us, const si5351_op_t *op) {
+    // 時刻（48bit）を前置操作で送り、直後の操作を予約扱いにする（生産者は 1 つなので隣接が保証される）
+    si5351_op_t at = { .code = SI5351_OP_AT, .b0 = (uint8_t)(t_us >> 40), .b1 = (uint8_t)(t_us >> 32) };
+    at.v.u = (uint32_t)t_us;
+    si5351_engine_submit_wait(&at);
+    si5351_engine_submit_wait(op);
+}
+
+void si5351_engine_dma_stop(void) {
+    g_dma_stop_req = true;
+}
+
+void si5351_engine_sna_stop(void) {
+    g_sna_stop_req = true;
+}
+
+void si5351_engine_fm_stop(void) {
+    g_fm_stop_req = true;
+}
+
+void si5351_engine_set_bus_hz(uint32_t hz) {
+    g_bus_hz = hz;
+}
+
+void si5351_engine_call(void (*fn)(void)) {
+    si5351_op_t op = { .code = SI5351_OP_CALL };
+    op.v.fn = fn;
+    si5351_engine_submit_wait(&op);
+}
+
+// 最後に読んだ STAT0 のうち, 今の構成で意味のあるビット（LED 表示用）
+static volatile uint8_t g_alarms;
+
+int si5351_engine_check(void) {
+    uint8_t st = 0, p3[2];
+    if (bus_read(REG_STAT0, &st, 1) != 0) return -1;
+    uint8_t rst = pll_reset_bits(), mask = 0x80;
+    if (rst & 0x20) mask |= 0x20;                   // LOL_A
+    if (rst & 0x80) mask |= 0x40;                   // LOL_B
+    if (rst) mask |= (g_ref_src == REF_CLKIN) ? 0x10 : 0x08;   // LOS_CLKIN / LOS_XTAL
+    g_alarms = st & mask;
+    if (st & 0x80) return 1;                        // SYS_INIT: 電源投入直後の初期化中
+    // 書いた PLL の P3（= 分母 c ≥ 1）が既定値 0 に戻っていれば構成を失っている
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+        uint8_t base = k_pll_base[k];
+        if (!shadow_has(base) || !shadow_has((uint8_t)(base + 1))) continue;
+        if (bus_read(base, p3, 2) != 0) return -1;
+        return (p3[0] != g_shadow[base] || p3[1] != g_shadow[base + 1]) ? 1 : 0;
+    }
+    return 0;
+}
+
+int si5351_engine_reload(void) {
+    int n = image_rewrite();
+    if (n < 0) return -1;
+    uint8_t rst = pll_reset_bits();
+    if (rst) (void)pll_reset(rst);
+    return n;
+}
+
+int si5351_engine_restore(void) {
+    si5351_engine_call(keep_restore);
+    si5351_engine_flush();
+    return g_restore.rc;
+}
+
+void si5351_engine_restore_show(void) {
+    restore_show();
+}
+
+uint32_t si5351_engine_heartbeat(void) {
+    return g_beat;
+}
+
+uint8_t si5351_engine_alarms(void) {
+    return g_alarms;
+}
+
+bool si5351_engine_sweeping(void) {
+    return g_dma_active || g_sna.active || g_fm.active;
+}
+
+bool si5351_engine_idle(void) {
+    return si5351_opq_depth(&g_opq) == 0;
+}
+
+void si5351_engine_flush(void) {
+    while (!si5351_engine_idle()) {
+        si5351_wdt_kick();
+#if SI5351_ENGINE_CORE1
+        tight_loop_contents();
+#else
+        (void)si5351_engine_poll(1);
+#endif
+    }
+}
+
+void si5351_engine_get_stats(si5351_engine_stats_t *st) {
+    st->depth       = si5351_opq_depth(&g_opq);
+    st->capacity    = SI5351_OPQ_LEN;
+    st->hwm         = g_opq.hwm;
+    st->pushed      = g_opq.pushed;
+    st->popped      = g_opq.popped;
+    st->full_events = g_opq.full_events;
+    st->dropped     = g_opq.dropped;
+    st->stall_us    = g_opq.stall_us;
+}
+
+const si5351_chip_t *si5351_engine_chip(void) {
+    return g_chip;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file    si5351_engine.h
+ * @brief   Si5351 レジスタエンジン（操作リングの消費者: プラン・シャドウ・I2C 書込み）
+ * @date    2025-11-06
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * CLI パーサは si5351_engine_submit_wait() で操作を投入するだけで、I2C には触れない。
+ * エンジンは SI5351_ENGINE_CORE1=1 なら core1 で常時、0 ならメインループの
+ * si5351_engine_poll() で協調的に操作を実行する。
+ */
+
+#ifndef SI5351_ENGINE_H
+#define SI5351_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/i2c.h"
+#include "si5351_ops.h"
+#include "si5351_chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_ENGINE_CORE1
+#define SI5351_ENGINE_CORE1     0
+#endif
+
+/** 操作リングの統計 */
+typedef struct {
+    uint32_t depth, capacity, hwm;
+    uint32_t pushed, popped;
+    uint32_t full_events, dropped, stall_us;
+} si5351_engine_stats_t;
+
+/** DIS_STATE 名（low/high/hiz/never） */
+extern const char *const si5351_dis_state_name[4];
+
+/** エンジン初期化（I2C ポートとアドレス, リング初期化。CORE1 構成なら core1 を起動） */
+void si5351_engine_init(i2c_inst_t *port, uint8_t addr);
+
+/** 非ブロッキング投入（満杯なら捨てて false） */
+bool si5351_engine_submit(const si5351_op_t *op);
+
+/** ブロッキング投入（満杯の間は待つ。単一コア構成では待ち中にエンジンを進める） */
+void si5351_engine_submit_wait(const si5351_op_t *op);
+
+/**
+ * @brief op を起動後時刻 t_us [us] に実行するよう予約する
+ *
+ * FREQ はエンジンが予約時に求解してレジスタ像を用意し、ハードウェアアラームの IRQ から書き込む。
+ * それ以外の操作は期限後にエンジン文脈で実行する。予定・実行時刻の差は実行後に表示される。
+ */
+void si5351_engine_submit_at(uint64_t t_us, const si5351_op_t *op);
+
+/** DMA 再生の中止を要求する（リングを経由しない。再生中でなければ何もしない） */
+void si5351_engine_dma_stop(void);
+
+/** sna 掃引の中止を要求する（リングを経由しない。掃引中でなければ何もしない） */
+void si5351_engine_sna_stop(void);
+
+/** fm / pm 変調の終了を要求する（リングを経由しない。変調中でなければ何もしない） */
+void si5351_engine_fm_stop(void);
+
+/** 現在の I2C バス速度 [Hz]（DMA のステップ上限見積りと bench 後の復元に使う） */
+void si5351_engine_set_bus_hz(uint32_t hz);
+
+/** fn をエンジン文脈で実行するよう投入する */
+void si5351_engine_call(void (*fn)(void));
+
+/**
+ * @brief 操作を最大 max 件実行する（消費者側）
+ * @return 実行した件数
+ */
+unsigned si5351_engine_poll(unsigned max);
+
+/** 投入済みの操作がすべて実行済みなら true */
+bool si5351_engine_idle(void);
+
+/** 全操作の実行完了を待つ */
+void si5351_engine_flush(void);
+
+/**
+ * @brief ウォッチドッグの保持領域（si5351_wdt.h）からプラン・シャドウ・出力設定を戻し, チップへ書き戻す
+ *
+ * si5351_engine_init() の直後, 他の操作より先に呼ぶ。チップが構成を保っていれば同じ値の上書きだけで
+ * 出力は止まらない。SYS_INIT か使用中 PLL の LOL が立っていれば（チップも電源を失っていた）PLL をリセットする。
+ * @return 0=復元, -1=保持内容なし, -2=プラン不整合, -3=I2C 失敗
+ */
+int  si5351_engine_restore(void);
+
+/**
+ * @brief チップの在席と構成の保持を確かめる（エンジン文脈: si5351_engine_call() の関数から呼ぶ）
+ * @return 0=正常, 1=チップが再起動して構成を失っている, -1=無応答
+ */
+int  si5351_engine_check(void);
+
+/**
+ * @brief シャドウの像をチップへ書き直し, 使用中 PLL をリセットする（エンジン文脈, 再接続・再給電後）
+ * @return 書いたバイト数, -1=I2C 失敗
+ */
+int  si5351_engine_reload(void);
+
+/** 起動時の復元結果を表示する */
+void si5351_engine_restore_show(void);
+
+/** si5351_engine_poll() の呼び出し回数（ウォッチドッグがエンジンの停止を見分けるための心拍） */
+uint32_t si5351_engine_heartbeat(void);
+
+/**
+ * @brief 最後の si5351_engine_check() で読んだ STAT0 の異常ビット
+ *
+ * 使用中 PLL の LOL（0x20=A, 0x40=B）, 使用中の基準の LOS（0x08=XTAL, 0x10=CLKIN）, SYS_INIT（0x80）だけを残す。
+ */
+uint8_t si5351_engine_alarms(void);
+
+/** DMA 掃引を再生中, sna 掃引中, または fm / pm 変調中なら true */
+bool si5351_engine_sweeping(void);
+
+void si5351_engine_get_stats(si5351_engine_stats_t *st);
+
+/** 操作リング・予約・トリガ表の現在の使用量をアリーナ表（si5351_mem.h）へ反映する */
+void si5351_engine_mem_sync(void);
+
+/** 現在のチップ記述子（パーサのヘルプ・範囲表示用） */
+const si5351_chip_t *si5351_engine_chip(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_ENGINE_H
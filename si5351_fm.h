@@ -0,0 +1,65 @@
+/**
+ * @file    si5351_fm.h
+ * @brief   ADC 入力による FM / PM（`fm`）の設定値と固定小数点の形式
+ * @date    2025-11-17
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * ADC（GPIO26）を更新レートでリング取り込みし、最新の 1 サンプルを搬送波まわりの MultiSynth 値へ写して
+ * 変化したバイトだけを書く。PLL は動かさないので、同じ PLL の他の出力とロックには影響しない。
+ *
+ *   MS 値は u = MS × 2^26 の整数で持つ（P3 = 2^19 固定: P1 = (u >> 19) - 512, P2 = u & (2^19 - 1)）。
+ *   入力 s（FM: x - 2048, PM: x - 前回書いた x）から u の変化量 du を 513 点の表（16 コード刻み）の線形補間で得る。
+ *   表は開始時に f / (f + Δf) - 1 から作るので、周波数と MS の反比例による偏移の歪みは表の刻みまで取り除かれる。
+ */
+
+#ifndef SI5351_FM_H
+#define SI5351_FM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_FM_RING_LOG2
+#define SI5351_FM_RING_LOG2     8           // ADC リング 2^8 語（× 2 バイトを同じ大きさの境界でアリーナから確保）
+#endif
+#define SI5351_FM_U_SHIFT       26          // u = MS × 2^26
+#define SI5351_FM_P3_LOG2       19          // P3 = 2^19
+#define SI5351_FM_LUT_SHIFT     4           // 表の刻み 16 コード
+#define SI5351_FM_LUT_N         ((8192 >> SI5351_FM_LUT_SHIFT) + 1)     // s = -4096..+4096
+#define SI5351_FM_DEV_MAX_PPM   10000       // 最大偏移 / 搬送波（1 %, MS の変化を小さく保つ）
+#define SI5351_FM_REPORT_US     1000000     // 変調中の状況表示の間隔
+
+// SI5351_OP_FM の b0
+#define SI5351_FM_MODE_FM       0           // dev = 最大偏移 [Hz]（入力振幅 ±2048 で ±dev）
+#define SI5351_FM_MODE_PM       1           // dev = 最大位相偏移 [mrad]（入力振幅 ±2048 で ±dev）
+
+// SI5351_OP_FM_PARAM の b0
+#define SI5351_FM_P_DEV         0
+#define SI5351_FM_P_RATE        1           // 更新レート [updates/s]（0=バス速度から見積もった上限）
+#define SI5351_FM_P_SIM_LEVEL   2           // 模擬入力の振幅 [% of full scale]
+
+/**
+ * @brief u（MS × 2^26）を MS 像 d[8] の P1 / P2 / P3 上位（d[2] 下位 2 ビット〜d[7]）に詰める
+ *
+ * P3 = 2^19 固定なので P1 = (u >> 19) - 512, P2 = u & (2^19 - 1)。d[0], d[1]（P3 下位 = 0）と
+ * d[2] の R_DIV / DIVBY4 ビットは呼び出し側の像のまま残す。u は 8 × 2^26 以上 2048 × 2^26 未満。
+ */
+static inline void si5351_fm_pack(int64_t u, uint8_t d[8]) {
+    uint32_t p1 = (uint32_t)(u >> SI5351_FM_P3_LOG2) - 512u;
+    uint32_t p2 = (uint32_t)u & ((1u << SI5351_FM_P3_LOG2) - 1u);
+    d[2] = (uint8_t)((d[2] & 0xFC) | ((p1 >> 16) & 0x03));
+    d[3] = (uint8_t)(p1 >> 8);
+    d[4] = (uint8_t)p1;
+    d[5] = (uint8_t)((((1u << SI5351_FM_P3_LOG2) >> 12) & 0xF0) | ((p2 >> 16) & 0x0F));
+    d[6] = (uint8_t)(p2 >> 8);
+    d[7] = (uint8_t)p2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_FM_H
@@ -0,0 +1,56 @@
+/**
+ * @file    si5351_hot.h
+ * @brief   ホットパスの SRAM 配置（IRQ 経路を XIP フラッシュのキャッシュミスから外す）
+ * @date    2025-11-09
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * SI5351_HOT(fn) を付けた関数は SI5351_HOT_IN_RAM=1 なら __not_in_flash_func で SRAM に置かれ、
+ * 0 なら通常どおりフラッシュから実行される。対象は I2C 転送・シャドウ／差分書込み・
+ * 予約アラームとトリガの IRQ・連分数ソルバの内側ループ。`bench isr` で両構成の最悪遅延を比べる。
+ */
+
+#ifndef SI5351_HOT_H
+#define SI5351_HOT_H
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "hardware/structs/timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_HOT_IN_RAM
+#define SI5351_HOT_IN_RAM   1
+#endif
+
+#if SI5351_HOT_IN_RAM
+#define SI5351_HOT(fn)      __not_in_flash_func(fn)
+#else
+#define SI5351_HOT(fn)      fn
+#endif
+
+/**
+ * @brief 起動後時刻 [us]（IRQ 経路用）
+ *
+ * SDK の time_us_64() はフラッシュ上の関数なので、ホットパスではタイマを直接読む。
+ * 上位語を読み直して下位語の桁上がりをまたいでいないことを確かめる（SDK と同じ手順）。
+ */
+static inline uint64_t si5351_hot_time_us(void) {
+    uint32_t hi = timer_hw->timerawh;
+    uint32_t lo;
+    for (;;) {
+        lo = timer_hw->timerawl;
+        uint32_t hi2 = timer_hw->timerawh;
+        if (hi2 == hi) break;
+        hi = hi2;
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_HOT_H
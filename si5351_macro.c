@@ -0,0 +1,184 @@
+/**
+ * @file    si5351_macro.c
+ * @brief   マクロ（解析済み操作列）のフラッシュ保存と実行用の参照
+ * @date    2025-11-12
+ * @version 1.0
+ */
+
+#include "si5351_macro.h"
+#include <string.h>
+#include <ctype.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "si5351_mem.h"
+
+#define MACRO_MAGIC     0x314D3553u                 // "S5M1"
+#define MACRO_FLASH_OFF (PICO_FLASH_SIZE_BYTES - SI5351_MACRO_BYTES)
+
+typedef struct {
+    char     name[SI5351_MACRO_NAME];
+    uint16_t first, count;
+} macro_dir_t;
+
+typedef struct {
+    uint32_t    magic;
+    uint16_t    n_macros, n_ops;
+    uint32_t    reserved[2];
+    macro_dir_t dir[SI5351_MACRO_MAX];
+    si5351_op_t ops[SI5351_MACRO_OPS];
+} macro_img_t;
+
+_Static_assert(sizeof(macro_img_t) <= SI5351_MACRO_BYTES, "macro image exceeds one flash sector");
+_Static_assert(SI5351_MACRO_BYTES % FLASH_SECTOR_SIZE == 0, "macro image must be whole sectors");
+
+static macro_img_t *g_img;                  // アリーナ上（SI5351_MACRO_BYTES）
+static int          g_mem_macro = -1;
+
+// 定義中の状態（操作は g_img->ops[n_ops..] に直接積む）
+static bool     g_rec;
+static char     g_rec_name[SI5351_MACRO_NAME];
+static uint16_t g_rec_n;
+static bool     g_rec_overflow;
+
+static void mem_update(void) {
+    si5351_mem_use(g_mem_macro, (uint32_t)((uint8_t *)&g_img->ops[g_img->n_ops] - (uint8_t *)g_img));
+}
+
+// 目録と操作範囲が一貫しているか（フラッシュの像を採用する前に確認）
+static bool img_valid(const macro_img_t *m) {
+    if (m->magic != MACRO_MAGIC || m->n_macros > SI5351_MACRO_MAX || m->n_ops > SI5351_MACRO_OPS) return false;
+    for (unsigned i = 0; i < m->n_macros; i++) {
+        const macro_dir_t *d = &m->dir[i];
+        if (d->name[0] == '\0' || memchr(d->name, '\0', SI5351_MACRO_NAME) == NULL) return false;
+        if ((uint32_t)d->first + d->count > m->n_ops) return false;
+    }
+    return true;
+}
+
+int si5351_macro_init(void) {
+    g_img = si5351_mem_alloc("macro", SI5351_MACRO_BYTES, &g_mem_macro);
+    if (!g_img) return -1;
+    const macro_img_t *fl = (const macro_img_t *)(XIP_BASE + MACRO_FLASH_OFF);
+    if (img_valid(fl)) {
+        memcpy(g_img, fl, sizeof(*g_img));
+    } else {
+        memset(g_img, 0, sizeof(*g_img));
+        g_img->magic = MACRO_MAGIC;
+    }
+    mem_update();
+    return g_img->n_macros;
+}
+
+// ===== フラッシュ書込み =====
+// flash_safe_execute() がもう一方のコアを止め, 割り込みを禁止した状態で呼ぶ
+static void flash_write_cb(void *param) {
+    (void)param;
+    flash_range_erase(MACRO_FLASH_OFF, SI5351_MACRO_BYTES);
+    flash_range_program(MACRO_FLASH_OFF, (const uint8_t *)g_img, SI5351_MACRO_BYTES);
+}
+
+static int store(void) {
+    if (flash_safe_execute(flash_write_cb, NULL, 100) != PICO_OK) return -4;
+    if (memcmp((const void *)(XIP_BASE + MACRO_FLASH_OFF), g_img, sizeof(*g_img)) != 0) return -4;
+    return 0;
+}
+
+// ===== 目録 =====
+static int dir_find(const char *name) {
+    for (unsigned i = 0; i < g_img->n_macros; i++)
+        if (!strcmp(g_img->dir[i].name, name)) return (int)i;
+    return -1;
+}
+
+// 目録 i を外し, その操作範囲を詰める（定義中の操作も一緒に動く）
+static void dir_remove(unsigned i) {
+    macro_dir_t d = g_img->dir[i];
+    unsigned tail = g_img->n_ops + (g_rec ? g_rec_n : 0u) - (d.first + d.count);
+    memmove(&g_img->ops[d.first], &g_img->ops[d.first + d.count], tail * sizeof(si5351_op_t));
+    g_img->n_ops = (uint16_t)(g_img->n_ops - d.count);
+    memmove(&g_img->dir[i], &g_img->dir[i + 1], (g_img->n_macros - i - 1u) * sizeof(macro_dir_t));
+    g_img->n_macros--;
+    for (unsigned k = 0; k < g_img->n_macros; k++)
+        if (g_img->dir[k].first > d.first) g_img->dir[k].first = (uint16_t)(g_img->dir[k].first - d.count);
+}
+
+// ===== 定義 =====
+int si5351_macro_begin(const char *name) {
+    if (g_rec) return -3;
+    size_t n = strlen(name);
+    if (n == 0 || n >= SI5351_MACRO_NAME) return -1;
+    for (size_t i = 0; i < n; i++)
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') return -1;
+    if (dir_find(name) < 0 && g_img->n_macros >= SI5351_MACRO_MAX) return -2;
+    memcpy(g_rec_name, name, n + 1u);
+    g_rec = true;
+    g_rec_n = 0;
+    g_rec_overflow = false;
+    return 0;
+}
+
+bool si5351_macro_recording(void) {
+    return g_rec;
+}
+
+const char *si5351_macro_recording_name(void) {
+    return g_rec ? g_rec_name : NULL;
+}
+
+int si5351_macro_put(const si5351_op_t *op) {
+    if (op->code == SI5351_OP_CALL || op->code == SI5351_OP_AT) return -2;
+    if (g_img->n_ops + g_rec_n >= SI5351_MACRO_OPS) { g_rec_overflow = true; return -1; }
+    g_img->ops[g_img->n_ops + g_rec_n++] = *op;
+    return 0;
+}
+
+int si5351_macro_end(void) {
+    if (!g_rec) return -1;
+    if (g_rec_overflow) { si5351_macro_cancel(); return -3; }
+    if (g_rec_n == 0)   { si5351_macro_cancel(); return -2; }
+
+    int old = dir_find(g_rec_name);
+    if (old >= 0) dir_remove((unsigned)old);        // 新しい定義は末尾にあるので一緒に詰まる
+    macro_dir_t *d = &g_img->dir[g_img->n_macros++];
+    memcpy(d->name, g_rec_name, SI5351_MACRO_NAME);
+    d->first = g_img->n_ops;
+    d->count = g_rec_n;
+    g_img->n_ops = (uint16_t)(g_img->n_ops + g_rec_n);
+    g_rec = false;
+    mem_update();
+    return store() < 0 ? -4 : (int)d->count;
+}
+
+void si5351_macro_cancel(void) {
+    g_rec = false;
+    g_rec_n = 0;
+    g_rec_overflow = false;
+}
+
+// ===== 参照 =====
+const si5351_op_t *si5351_macro_find(const char *name, unsigned *n) {
+    int i = dir_find(name);
+    if (i < 0) return NULL;
+    *n = g_img->dir[i].count;
+    return &g_img->ops[g_img->dir[i].first];
+}
+
+int si5351_macro_delete(const char *name) {
+    int i = dir_find(name);
+    if (i < 0) return -1;
+    dir_remove((unsigned)i);
+    mem_update();
+    return store();
+}
+
+const char *si5351_macro_name(unsigned i, unsigned *n) {
+    if (i >= g_img->n_macros) return NULL;
+    if (n) *n = g_img->dir[i].count;
+    return g_img->dir[i].name;
+}
+
+unsigned si5351_macro_ops_used(void) {
+    return g_img->n_ops;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file    si5351_macro.h
+ * @brief   マクロ（解析済み操作列）のフラッシュ保存と実行用の参照
+ * @date    2025-11-12
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * マクロは CLI が組み立てた si5351_op_t の列をそのまま持つので、実行時に字句解析はしない。
+ * 全マクロはフラッシュ末尾の 1 セクタ（4 KB）に 1 つの像として置き、起動時にアリーナへ写す。
+ * 定義・削除のたびにセクタを消去して像全体を書き直す。
+ *
+ *   [ヘッダ 16 B][目録 SI5351_MACRO_MAX × 16 B][操作 8 B × SI5351_MACRO_OPS]
+ */
+
+#ifndef SI5351_MACRO_H
+#define SI5351_MACRO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "si5351_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SI5351_MACRO_BYTES  4096        // フラッシュ 1 セクタ
+#define SI5351_MACRO_MAX    16          // マクロ数
+#define SI5351_MACRO_NAME   12          // 名前（NUL 込み）
+#define SI5351_MACRO_OPS    ((SI5351_MACRO_BYTES - 16u - SI5351_MACRO_MAX * 16u) / sizeof(si5351_op_t))
+
+/**
+ * @brief アリーナに像を確保し、フラッシュの像を読み込む
+ * @return 読み込んだマクロ数（フラッシュが空・壊れていれば 0）, -1=アリーナ不足
+ */
+int  si5351_macro_init(void);
+
+/**
+ * @brief 定義開始（以降 si5351_macro_put() の操作を末尾に積む）
+ * @return 0=OK, -1=名前が不正, -2=目録が満杯, -3=定義中
+ */
+int  si5351_macro_begin(const char *name);
+
+/** 定義中なら true */
+bool si5351_macro_recording(void);
+
+/** 定義中の名前（定義中でなければ NULL） */
+const char *si5351_macro_recording_name(void);
+
+/**
+ * @brief 操作を 1 件積む
+ * @return 0=OK, -1=容量不足, -2=マクロに入れられない操作（CALL / AT）
+ */
+int  si5351_macro_put(const si5351_op_t *op);
+
+/**
+ * @brief 定義を確定してフラッシュへ保存する（同名のマクロは置き換える）
+ * @return 操作数, -1=定義中でない, -2=空, -3=容量不足があった, -4=フラッシュ書込み失敗
+ */
+int  si5351_macro_end(void);
+
+/** 定義を破棄する */
+void si5351_macro_cancel(void);
+
+/** 名前で探す（なければ NULL）。*n に操作数 */
+const si5351_op_t *si5351_macro_find(const char *name, unsigned *n);
+
+/** 削除してフラッシュへ保存する。0=OK, -1=なし, -4=フラッシュ書込み失敗 */
+int  si5351_macro_delete(const char *name);
+
+/** i 番目のマクロ名（範囲外なら NULL）。*n に操作数 */
+const char *si5351_macro_name(unsigned i, unsigned *n);
+
+/** 使用中の操作スロット数 */
+unsigned si5351_macro_ops_used(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_MACRO_H
@@ -0,0 +1,65 @@
+/**
+ * @file    si5351_mem.c
+ * @brief   ドライバ状態用の静的アリーナ（起動時に一括確保, 解放なし）と RAM 使用量の集計
+ * @date    2025-11-10
+ * @version 1.0
+ */
+
+#include "si5351_mem.h"
+#include <string.h>
+
+static uint8_t             g_arena[SI5351_ARENA_BYTES] __attribute__((aligned(8)));
+static uint32_t            g_top;
+static si5351_mem_region_t g_region[SI5351_MEM_REGIONS];
+static unsigned            g_n;
+
+static void *take(const char *name, uint32_t size, int *id) {
+    if (g_n >= SI5351_MEM_REGIONS) return NULL;
+    si5351_mem_region_t *r = &g_region[g_n];
+    r->name = name;
+    r->off  = g_top;
+    r->size = size;
+    r->used = r->hwm = 0;
+    g_top += (size + 7u) & ~7u;
+    if (id) *id = (int)g_n;
+    g_n++;
+    memset(&g_arena[r->off], 0, size);
+    return &g_arena[r->off];
+}
+
+void *si5351_mem_alloc(const char *name, uint32_t size, int *id) {
+    if (size > SI5351_ARENA_BYTES - g_top) return NULL;
+    return take(name, size, id);
+}
+
+void *si5351_mem_alloc_aligned(const char *name, uint32_t size, uint32_t align, int *id) {
+    uint32_t pad = (uint32_t)(-(uintptr_t)&g_arena[g_top] & (align - 1u));
+    if (pad > SI5351_ARENA_BYTES - g_top || size > SI5351_ARENA_BYTES - g_top - pad) return NULL;
+    g_top += pad;
+    return take(name, size, id);
+}
+
+void *si5351_mem_alloc_rest(const char *name, uint32_t min, uint32_t *size, int *id) {
+    uint32_t rest = SI5351_ARENA_BYTES - g_top;
+    if (rest < min) return NULL;
+    *size = rest;
+    return take(name, rest, id);
+}
+
+void si5351_mem_use(int id, uint32_t used) {
+    if (id < 0 || (unsigned)id >= g_n) return;
+    g_region[id].used = used;
+    if (used > g_region[id].hwm) g_region[id].hwm = used;
+}
+
+uint32_t si5351_mem_allocated(void) {
+    return g_top;
+}
+
+unsigned si5351_mem_count(void) {
+    return g_n;
+}
+
+const si5351_mem_region_t *si5351_mem_region(unsigned i) {
+    return (i < g_n) ? &g_region[i] : NULL;
+}
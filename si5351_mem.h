@@ -0,0 +1,60 @@
+/**
+ * @file    si5351_mem.h
+ * @brief   ドライバ状態用の静的アリーナ（起動時に一括確保, 解放なし）と RAM 使用量の集計
+ * @date    2025-11-10
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * 入力行・操作リング・シャドウ・プラン・予約/トリガ表・DMA バッファを名前付き領域として
+ * 1 つの配列から切り出す。固定サイズの領域を取ったあとの残りは掃引列（seq）に回すので、
+ * SI5351_ARENA_BYTES を増やした分がそのまま格納できるステップ数になる。
+ */
+
+#ifndef SI5351_MEM_H
+#define SI5351_MEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_ARENA_BYTES
+#define SI5351_ARENA_BYTES  (160u * 1024u)
+#endif
+#define SI5351_MEM_REGIONS  16
+
+typedef struct {
+    const char *name;
+    uint32_t    off, size;
+    uint32_t    used, hwm;              // 現在の使用量と最大値（所有者が si5351_mem_use() で更新）
+} si5351_mem_region_t;
+
+/**
+ * @brief 領域を確保する（8 バイト境界）
+ * @param id 領域番号の格納先（NULL 可）
+ * @return 先頭アドレス。残りが足りなければ NULL
+ */
+void *si5351_mem_alloc(const char *name, uint32_t size, int *id);
+
+/** 領域を align バイト（2 のべき）境界に確保する（DMA のリングバッファ用。詰め物は領域に含めない） */
+void *si5351_mem_alloc_aligned(const char *name, uint32_t size, uint32_t align, int *id);
+
+/** 残り全部を確保する（min 未満しか残っていなければ NULL）。*size に確保量 */
+void *si5351_mem_alloc_rest(const char *name, uint32_t min, uint32_t *size, int *id);
+
+/** 領域 id の使用量を更新する（最大値も更新） */
+void si5351_mem_use(int id, uint32_t used);
+
+/** 確保済みバイト数 */
+uint32_t si5351_mem_allocated(void);
+
+unsigned si5351_mem_count(void);
+const si5351_mem_region_t *si5351_mem_region(unsigned i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_MEM_H
@@ -0,0 +1,99 @@
+/**
+ * @file    si5351_ops.h
+ * @brief   CLI パーサ → レジスタエンジン間の解析済み操作（オペコード + 引数）
+ * @date    2025-11-06
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SI5351_OPS_H
+#define SI5351_OPS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SI5351_OP_NOP = 0,
+    SI5351_OP_CALL,         // v.fn をエンジン文脈で実行（I2C を使う診断などの直列化用）
+    SI5351_OP_INIT,
+    SI5351_OP_SCAN,
+    SI5351_OP_STATUS,
+    SI5351_OP_PEEK,         // b0=reg
+    SI5351_OP_POKE,         // b0=reg, b1=val
+    SI5351_OP_FORCE_ON,
+    SI5351_OP_OE,           // b0: 1=全有効, 0=全無効
+    SI5351_OP_FREQ,         // ch, v.u=Hz（0=停止）
+    SI5351_OP_FINE,         // ch, v.i=オフセット [mHz]
+    SI5351_OP_DRIVE,        // ch, b0=mA
+    SI5351_OP_INVERT,       // ch, b0=0/1
+    SI5351_OP_IDLE,         // ch, b0=DIS_STATE
+    SI5351_OP_CFG,
+    SI5351_OP_POWER,        // b0=policy（SI5351_OP_ARG_NONE なら表示のみ）
+    SI5351_OP_CHIP,         // b0=SI5351_CHIP_*（SI5351_OP_ARG_NONE なら表示のみ）
+    SI5351_OP_REF,          // b0=0 XTAL / 1 CLKIN / NONE 表示, v.u=CLKIN Hz（0=前回値）
+    SI5351_OP_PLAN_SHOW,
+    SI5351_OP_PLAN_EXPLAIN, // ch
+    SI5351_OP_PLAN_BUDGET,  // v.u=us（b0=NONE なら表示のみ）
+    SI5351_OP_BENCH_CF,     // v.u=回数
+    SI5351_OP_BENCH_ISR,    // v.u=回数
+    SI5351_OP_AT,           // 次の操作を予約: 時刻 = b0<<40 | b1<<32 | v.u [us since boot]
+    SI5351_OP_AT_LIST,
+    SI5351_OP_AT_CLEAR,
+    SI5351_OP_TRIG_LOAD,    // b0=1 新規リスト（ch）/ 0 追加, v.u=Hz
+    SI5351_OP_TRIG_ARM,     // b0=GPIO, b1=0 立上り / 1 立下り
+    SI5351_OP_TRIG_OFF,
+    SI5351_OP_TRIG_SHOW,
+    SI5351_OP_DMA_PARAM,    // b0=SI5351_DMA_P_*, v.u=値（直後の DMA_SWEEP / PLAY が使う）
+    SI5351_OP_DMA_SWEEP,    // ch, v.u=開始 Hz: シーケンスを作って再生
+    SI5351_OP_DMA_PLAY,     // v.u=ステップ周波数 [Hz]（0=バス上限, b0=NONE なら前回値）
+    SI5351_OP_DMA_SHOW,
+    SI5351_OP_DMA_BENCH,
+    SI5351_OP_TRACE,        // b0=SI5351_TR_*（si5351_trace.h）, v.u=件数
+    SI5351_OP_HOP_PREP,     // ch, v.u=Hz: 空き PLL を合わせてロックさせておく
+    SI5351_OP_HOP_GO,       // 準備した PLL へ出力を切り替える
+    SI5351_OP_HOP_SHOW,
+    SI5351_OP_TRACK,        // ch=slave（NONE=全解除）, b0=master（NONE=解除）, v.i=オフセット [Hz]
+    SI5351_OP_TRACK_SHOW,
+    SI5351_OP_SNA_PARAM,    // b0=SI5351_SNA_P_*, v.u=値
+    SI5351_OP_SNA,          // v.u=開始 [Hz]（終了・点数などは SNA_PARAM で先に送る）
+    SI5351_OP_SNA_SIM,      // b0=フィルタ次数（0=模擬なし）, v.u=中心 [Hz]
+    SI5351_OP_SNA_SHOW,
+    SI5351_OP_FM_PARAM,     // b0=SI5351_FM_P_*, v.u=値
+    SI5351_OP_FM,           // ch, b0=SI5351_FM_MODE_*, v.u=搬送波 [Hz]（偏移・レートは FM_PARAM で先に送る）
+    SI5351_OP_FM_SIM,       // v.u=模擬トーン [Hz]（0=模擬なし）
+    SI5351_OP_FM_SHOW,
+    SI5351_OP_PING,         // 0x60 の ACK 確認
+    SI5351_OP_COUNT
+} si5351_opcode_t;
+
+#define SI5351_OP_ARG_NONE  0xFF
+
+// SI5351_OP_POWER の b0
+#define SI5351_PWR_OE_ONLY  0
+#define SI5351_PWR_AUTO     1
+
+// SI5351_OP_DMA_PARAM の b0
+#define SI5351_DMA_P_STOP_HZ    0
+#define SI5351_DMA_P_POINTS     1
+#define SI5351_DMA_P_RATE_HZ    2
+
+/** 解析済み操作（RP2040 では 8 バイト） */
+typedef struct {
+    uint8_t code;           // si5351_opcode_t
+    uint8_t ch;
+    uint8_t b0, b1;
+    union {
+        uint32_t u;
+        int32_t  i;
+        void   (*fn)(void);
+    } v;
+} si5351_op_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_OPS_H
@@ -0,0 +1,639 @@
+/**
+ * @file    si5351_plan.c
+ * @brief   Si5351A 周波数プランナ（最小ジッタ候補探索・スコアリング・plan explain 用候補保持）
+ * @date    2025-11-05
+ * @version 1.0
+ */
+
+#include "si5351_plan.h"
+#include "si5351_hot.h"
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#define Q32_ONE        (1ULL << 32)
+#define BUDGET_CHECK   32      // 何候補ごとに経過時間を確認するか
+
+// ===== 探索コンテキスト =====
+typedef struct {
+    si5351_plan_t *p;
+    unsigned       ch;
+    uint32_t       f;
+    si5351_cand_t  top[SI5351_PLAN_RUNNERS];
+    uint8_t        n_top;
+    uint64_t       t_start;
+    uint32_t       evaluated;
+    bool           timed_out;
+} search_t;
+
+// =========================================================
+// 連分数による最良有理近似
+// =========================================================
+typedef struct {
+    uint64_t h0, k0, h1, k1;   // 直前 2 つの収束子
+    uint64_t n, d;             // 互除の状態（r_{j-1}, r_j）
+} cf_state_t;
+
+static void SI5351_HOT(cf_state_cold)(cf_state_t *st, uint64_t num, uint64_t den) {
+    st->h0 = 0; st->k0 = 1; st->h1 = 1; st->k1 = 0;
+    st->n = num; st->d = den;
+}
+
+// 互除を最後まで進める（cc があれば新しい収束子を追記）
+static uint32_t SI5351_HOT(cf_finish)(cf_state_t *st, uint64_t num, uint64_t den, uint32_t max_den,
+                                      si5351_cf_cache_t *cc, si5351_frac_t *out) {
+    uint32_t steps = 0;
+    while (st->d) {
+        uint64_t q  = st->n / st->d;
+        uint64_t k2 = q * st->k1 + st->k0;
+        steps++;
+        if (k2 > max_den) {
+            // 半収束子 (t*h1+h0)/(t*k1+k0) と h1/k1 の良い方
+            uint64_t t  = (max_den - st->k0) / st->k1;
+            uint64_t hs = t * st->h1 + st->h0, ks = t * st->k1 + st->k0;
+            double x  = (double)num / (double)den;
+            double e1 = fabs(x - (double)st->h1 / (double)st->k1);
+            double es = fabs(x - (double)hs / (double)ks);
+            if (t > 0 && es < e1) { st->h1 = hs; st->k1 = ks; }
+            break;
+        }
+        uint64_t h2 = q * st->h1 + st->h0;
+        st->h0 = st->h1; st->k0 = st->k1; st->h1 = h2; st->k1 = k2;
+        uint64_t r = st->n - q * st->d;
+        st->n = st->d; st->d = r;
+        if (cc && cc->depth < SI5351_CF_DEPTH) {
+            cc->h[cc->depth] = h2;
+            cc->k[cc->depth] = (uint32_t)k2;
+            cc->depth++;
+        }
+    }
+
+    out->a = (uint32_t)(st->h1 / st->k1);
+    out->b = (uint32_t)(st->h1 % st->k1);
+    out->c = (uint32_t)st->k1;
+    if (out->b == 0) out->c = 1;
+    return steps;
+}
+
+void SI5351_HOT(si5351_frac_approx)(uint64_t num, uint64_t den, uint32_t max_den, si5351_frac_t *out) {
+    cf_state_t st;
+    cf_state_cold(&st, num, den);
+    (void)cf_finish(&st, num, den, max_den, NULL, out);
+}
+
+void si5351_cf_cache_init(si5351_cf_cache_t *cc) {
+    memset(cc, 0, sizeof(*cc));
+    cc->h[0] = 0; cc->k[0] = 1;
+    cc->h[1] = 1; cc->k[1] = 0;
+    cc->depth = 2;
+}
+
+// r_e = (-1)^e (k_e*num - h_e*den)（e はオフセット込みの添字）
+static inline int64_t cf_residual(const si5351_cf_cache_t *cc, unsigned e, uint64_t num, uint64_t den) {
+    int64_t r = (int64_t)((uint64_t)cc->k[e] * num) - (int64_t)(cc->h[e] * den);
+    return (e & 1u) ? -r : r;
+}
+
+void SI5351_HOT(si5351_frac_approx_cached)(si5351_cf_cache_t *cc, uint64_t num, uint64_t den,
+                                           uint32_t max_den, si5351_frac_t *out) {
+    cf_state_t st;
+    cf_state_cold(&st, num, den);
+    cc->calls++;
+
+    if (cc->max_den != max_den || cc->depth < 2) {
+        si5351_cf_cache_init(cc);
+        cc->max_den = max_den;
+    } else {
+        // 最深の一致プレフィクスを探す（深い方から 2 乗算ずつ）
+        unsigned e = cc->depth;
+        while (--e >= 2) {
+            int64_t t = cf_residual(cc, e, num, den);
+            if (t < 0) continue;
+            int64_t s = cf_residual(cc, e - 1, num, den);
+            if (s <= t) continue;
+            st.h0 = cc->h[e - 1]; st.k0 = cc->k[e - 1];
+            st.h1 = cc->h[e];     st.k1 = cc->k[e];
+            st.n  = (uint64_t)s;  st.d  = (uint64_t)t;
+            cc->warm_hits++;
+            break;
+        }
+        cc->depth = (uint8_t)((e >= 2) ? e + 1 : 2);
+    }
+    cc->steps += cf_finish(&st, num, den, max_den, cc, out);
+}
+
+// =========================================================
+// ベンチマーク（bench cf）: VCO=800MHz 固定の MS 比を解く
+// =========================================================
+void si5351_cf_bench(uint32_t n, si5351_cf_bench_t *res) {
+    static si5351_cf_cache_t cc;   // スタック節約
+    const uint64_t vco = 800000000ULL;
+    const uint32_t f0  = 7000000UL;
+    si5351_frac_t ms;
+    uint32_t seed = 0x1234567u;
+    uint64_t t0;
+
+    memset(res, 0, sizeof(*res));
+    res->n = n;
+
+    // (1) ランダム目標 1..30 MHz（キャッシュ使用, ほぼ毎回コールド）
+    si5351_cf_cache_init(&cc);
+    t0 = time_us_64();
+    for (uint32_t i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t f = 1000000UL + seed % 29000000UL;
+        si5351_frac_approx_cached(&cc, vco, f, SI5351_FRAC_MAX_DEN, &ms);
+    }
+    res->random_us    = (uint32_t)(time_us_64() - t0);
+    res->random_steps = cc.steps;
+
+    // (2) 1 Hz 逐次ステップ（キャッシュなし相当: 毎回初期化）
+    t0 = time_us_64();
+    uint32_t steps = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        si5351_cf_cache_init(&cc);
+        si5351_frac_approx_cached(&cc, vco, f0 + i, SI5351_FRAC_MAX_DEN, &ms);
+        steps += cc.steps;
+    }
+    res->seq_cold_us    = (uint32_t)(time_us_64() - t0);
+    res->seq_cold_steps = steps;
+
+    // (3) 1 Hz 逐次ステップ（ウォームスタート）
+    si5351_cf_cache_init(&cc);
+    t0 = time_us_64();
+    for (uint32_t i = 0; i < n; i++) {
+        si5351_frac_approx_cached(&cc, vco, f0 + i, SI5351_FRAC_MAX_DEN, &ms);
+    }
+    res->seq_warm_us    = (uint32_t)(time_us_64() - t0);
+    res->seq_warm_steps = cc.steps;
+    res->seq_warm_hits  = cc.warm_hits;
+}
+
+// =========================================================
+// レジスタ像エンコード（AN619: P1/P2/P3）
+// =========================================================
+// 予約・トリガの IRQ から書く経路（ms_apply / pll_apply）でも使うので SRAM に置く
+static void SI5351_HOT(frac_to_p)(const si5351_frac_t *f, uint32_t *P1, uint32_t *P2, uint32_t *P3) {
+    uint32_t fl = (uint32_t)(((uint64_t)128 * f->b) / f->c);
+    *P1 = 128 * f->a + fl - 512;
+    *P2 = 128 * f->b - f->c * fl;
+    *P3 = f->c;
+}
+
+static void SI5351_HOT(pack_p)(uint32_t P1, uint32_t P2, uint32_t P3, uint8_t d[8]) {
+    d[0] = (uint8_t)((P3 >> 8) & 0xFF);
+    d[1] = (uint8_t)(P3 & 0xFF);
+    d[2] = (uint8_t)((P1 >> 16) & 0x03);
+    d[3] = (uint8_t)((P1 >> 8) & 0xFF);
+    d[4] = (uint8_t)(P1 & 0xFF);
+    d[5] = (uint8_t)(((P3 >> 12) & 0xF0) | ((P2 >> 16) & 0x0F));
+    d[6] = (uint8_t)((P2 >> 8) & 0xFF);
+    d[7] = (uint8_t)(P2 & 0xFF);
+}
+
+void SI5351_HOT(si5351_encode_pll)(const si5351_frac_t *fb, uint8_t out[8]) {
+    uint32_t P1, P2, P3;
+    frac_to_p(fb, &P1, &P2, &P3);
+    pack_p(P1, P2, P3, out);
+}
+
+void SI5351_HOT(si5351_encode_ms)(const si5351_frac_t *ms, uint8_t r_log2, bool divby4, uint8_t out[8]) {
+    uint32_t P1 = 0, P2 = 0, P3 = 1;
+    if (!divby4) frac_to_p(ms, &P1, &P2, &P3);
+    pack_p(P1, P2, P3, out);
+    out[2] |= (uint8_t)(((r_log2 & 0x07) << 4) | (divby4 ? 0x0C : 0x00));
+}
+
+// =========================================================
+// 候補評価
+// =========================================================
+static inline double frac_value(const si5351_frac_t *f) {
+    return (double)f->a + (double)f->b / (double)f->c;
+}
+
+static bool ms_valid(const si5351_frac_t *ms, bool compact) {
+    if (compact)
+        return ms->b == 0 && (ms->a & 1u) == 0 && ms->a >= SI5351_MS67_MIN && ms->a <= SI5351_MS67_MAX;
+    if (ms->b == 0) return ms->a == 4 || ms->a == 6 || (ms->a >= 8 && ms->a <= SI5351_MS_MAX);
+    return ms->a >= SI5351_MS_FRAC_MIN && ms->a < SI5351_MS_MAX;
+}
+
+static bool budget_left(search_t *s) {
+    if (s->timed_out) return false;
+    if ((s->evaluated % BUDGET_CHECK) == 0 &&
+        time_us_64() - s->t_start > s->p->budget_us) {
+        s->timed_out = true;
+    }
+    return !s->timed_out;
+}
+
+static void evaluate(search_t *s, uint8_t pll, const si5351_frac_t *fb, bool new_pll,
+                     uint8_t r_log2, const si5351_frac_t *ms) {
+    s->evaluated++;
+    if (!ms_valid(ms, (s->p->compact_mask >> s->ch) & 1u)) return;
+
+    si5351_cand_t c;
+    memset(&c, 0, sizeof(c));
+    c.target_hz = s->f;
+    c.pll       = pll;
+    c.r_log2    = r_log2;
+    c.fb        = *fb;
+    c.ms        = *ms;
+
+    double vco  = (double)s->p->ref_hz * frac_value(fb);
+    c.actual_hz = vco / frac_value(ms) / (double)(1u << r_log2);
+    c.err_ppb   = fabs(c.actual_hz - (double)s->f) / (double)s->f * 1e9;
+
+    double se = c.err_ppb * SI5351_SCORE_PER_PPB;
+    c.score = (se > (double)SI5351_SCORE_ERR_CAP) ? SI5351_SCORE_ERR_CAP : (uint32_t)(se + 0.5);
+
+    if (ms->b == 0) {
+        c.flags |= SI5351_CF_INT_MS;
+        if ((ms->a & 1u) == 0) c.flags |= SI5351_CF_EVEN_MS;
+        else                   c.score += SI5351_SCORE_ODD_MS;
+        if (ms->a == 4)        c.flags |= SI5351_CF_DIVBY4;
+    } else {
+        c.score += SI5351_SCORE_FRAC_MS;
+    }
+    if (fb->b == 0) c.flags |= SI5351_CF_INT_PLL;
+    else            c.score += SI5351_SCORE_FRAC_PLL;
+    if (new_pll) {
+        c.flags |= SI5351_CF_NEW_PLL;
+        c.score += SI5351_SCORE_NEW_PLL;
+    }
+    c.score += SI5351_SCORE_PER_R * r_log2;
+    if (vco < SI5351_VCO_MIN_HZ * 1.001 || vco > SI5351_VCO_MAX_HZ * 0.999) c.score += SI5351_SCORE_VCO_EDGE;
+
+    // 上位 N 件を score 昇順で保持（同点は先着優先）
+    if (s->n_top == SI5351_PLAN_RUNNERS && c.score >= s->top[s->n_top - 1].score) return;
+    int i = (s->n_top < SI5351_PLAN_RUNNERS) ? s->n_top++ : SI5351_PLAN_RUNNERS - 1;
+    while (i > 0 && s->top[i - 1].score > c.score) {
+        s->top[i] = s->top[i - 1];
+        i--;
+    }
+    s->top[i] = c;
+}
+
+// ---- VCO 固定（他チャネルと共有中の PLL）----
+// 直前プランと同じ PLL/R の分数解はウォームスタート（1 Hz 刻み等の連続チューニング向け）
+static void approx_ms(search_t *s, uint8_t k, uint8_t r, uint32_t pll_a,
+                      uint64_t num, uint64_t den, si5351_frac_t *ms) {
+    const si5351_ch_plan_t *cp = &s->p->ch[s->ch];
+    if (cp->active && cp->sel.pll == k && cp->sel.r_log2 == r && cp->sel.fb.a == pll_a)
+        si5351_frac_approx_cached(&s->p->cf[s->ch], num, den, SI5351_FRAC_MAX_DEN, ms);
+    else
+        si5351_frac_approx(num, den, SI5351_FRAC_MAX_DEN, ms);
+}
+
+static void search_fixed_pll(search_t *s, uint8_t k) {
+    const si5351_pll_plan_t *pl = &s->p->pll[k];
+    for (uint8_t r = 0; r <= SI5351_R_MAX_LOG2 && budget_left(s); r++) {
+        uint64_t d = (uint64_t)s->f << r;
+        double x = pl->vco_hz / (double)d;
+        if (x < 4.0) break;
+        if (x > (double)SI5351_MS_MAX) continue;
+
+        si5351_frac_t ms;
+        if (pl->fb.b == 0) {
+            approx_ms(s, k, r, pl->fb.a, (uint64_t)s->p->ref_hz * pl->fb.a, d, &ms);
+        } else {
+            approx_ms(s, k, r, pl->fb.a, (uint64_t)(x * (double)Q32_ONE + 0.5), Q32_ONE, &ms);
+        }
+        evaluate(s, k, &pl->fb, false, r, &ms);
+    }
+}
+
+// ---- VCO 自由（空き PLL）----
+static void search_free_pll(search_t *s, uint8_t k) {
+    const uint32_t ref = s->p->ref_hz;
+    // (1) 整数 MS → VCO = f*R*MS、PLL 帰還を近似（偶数整数を優先的に評価）
+    for (uint8_t r = 0; r <= SI5351_R_MAX_LOG2; r++) {
+        uint64_t d = (uint64_t)s->f << r;
+        uint64_t lo = (SI5351_VCO_MIN_HZ + d - 1) / d;
+        uint64_t hi = SI5351_VCO_MAX_HZ / d;
+        if (hi > SI5351_MS_MAX) hi = SI5351_MS_MAX;
+        for (uint64_t m = hi; m >= lo && m >= 4; m--) {
+            if (!budget_left(s)) return;
+            si5351_frac_t ms = { (uint32_t)m, 0, 1 }, fb;
+            si5351_frac_approx(m * d, ref, SI5351_FRAC_MAX_DEN, &fb);
+            evaluate(s, k, &fb, true, r, &ms);
+        }
+    }
+
+    // (2) 整数 PLL → MS を分数近似
+    uint32_t a_lo = (SI5351_VCO_MIN_HZ + ref - 1) / ref;
+    uint32_t a_hi = SI5351_VCO_MAX_HZ / ref;
+    for (uint8_t r = 0; r <= SI5351_R_MAX_LOG2; r++) {
+        uint64_t d = (uint64_t)s->f << r;
+        for (uint32_t a = a_hi; a >= a_lo; a--) {
+            if (!budget_left(s)) return;
+            uint64_t vco = (uint64_t)ref * a;
+            if (vco < 4 * d || vco > (uint64_t)SI5351_MS_MAX * d) continue;
+            si5351_frac_t fb = { a, 0, 1 }, ms;
+            approx_ms(s, k, r, a, vco, d, &ms);
+            if (ms.b == 0) continue;   // 整数解は (1) で評価済み
+            evaluate(s, k, &fb, true, r, &ms);
+        }
+    }
+}
+
+// =========================================================
+// 公開 API
+// =========================================================
+void si5351_plan_init(si5351_plan_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->budget_us = SI5351_PLAN_BUDGET_US;
+    p->n_ch      = 3;
+    p->pll_mask  = 0x03;
+    p->ref_hz    = SI5351_XTAL_HZ;
+    for (unsigned ch = 0; ch < SI5351_MAX_CH; ch++) si5351_cf_cache_init(&p->cf[ch]);
+}
+
+uint8_t si5351_plan_set_chip(si5351_plan_t *p, const si5351_chip_t *chip) {
+    p->n_ch = chip->n_out;
+    p->compact_mask = 0;
+    for (unsigned ch = SI5351_MS_FULL_MAX; ch < chip->n_out; ch++) p->compact_mask |= (uint8_t)(1u << ch);
+    p->pll_mask = chip->has_vcxo ? 0x01 : 0x03;
+
+    // 使えなくなった PLL（Si5351B の PLLB）に載っているチャネルを外す（sel.target_hz は残る）
+    uint8_t released = 0;
+    for (unsigned ch = 0; ch < chip->n_out; ch++) {
+        if (!p->ch[ch].active || ((p->pll_mask >> p->ch[ch].sel.pll) & 1u)) continue;
+        si5351_plan_release(p, ch);
+        released |= (uint8_t)(1u << ch);
+    }
+    return released;
+}
+
+void SI5351_HOT(si5351_plan_release)(si5351_plan_t *p, unsigned ch) {
+    if (ch >= SI5351_MAX_CH || !p->ch[ch].active) return;
+    p->pll[p->ch[ch].sel.pll].users &= (uint8_t)~(1u << ch);
+    p->ch[ch].active = false;
+}
+
+// 探索のみ（プランは変更しない。収束子キャッシュは更新される）
+static int solve(si5351_plan_t *p, unsigned ch, uint32_t freq_hz, search_t *s) {
+    if (ch >= p->n_ch) return -1;
+    if (freq_hz < SI5351_OUT_MIN_HZ || freq_hz > SI5351_OUT_MAX_HZ) return -1;
+
+    memset(s, 0, sizeof(*s));
+    s->p = p;
+    s->ch = ch;
+    s->f = freq_hz;
+    s->t_start = time_us_64();
+
+    uint8_t me = (uint8_t)(1u << ch);
+    int free_pll = -1;
+
+    // 自分が単独で使っている PLL を優先して VCO 自由扱いにする
+    if (p->ch[ch].active && ((p->pll_mask >> p->ch[ch].sel.pll) & 1u) &&
+        (p->pll[p->ch[ch].sel.pll].users & ~me) == 0)
+        free_pll = p->ch[ch].sel.pll;
+
+    for (uint8_t k = 0; k < SI5351_NUM_PLL; k++) {
+        if (!((p->pll_mask >> k) & 1u)) continue;
+        if (p->pll[k].users & ~me) search_fixed_pll(s, k);
+        else if (free_pll < 0) free_pll = k;
+    }
+    if (free_pll >= 0) search_free_pll(s, (uint8_t)free_pll);
+
+    p->last_elapsed_us = (uint32_t)(time_us_64() - s->t_start);
+    p->last_evaluated  = s->evaluated;
+    p->last_timed_out  = s->timed_out;
+
+    return (s->n_top == 0) ? -2 : 0;
+}
+
+int si5351_plan_probe(si5351_plan_t *p, unsigned ch, uint32_t freq_hz, si5351_cand_t *out) {
+    search_t s;
+    int rc = solve(p, ch, freq_hz, &s);
+    if (rc == 0) *out = s.top[0];
+    return rc;
+}
+
+int si5351_plan_probe_pll(si5351_plan_t *p, unsigned ch, uint32_t freq_hz, uint8_t k, bool keep_ms,
+                          si5351_cand_t *out) {
+    if (ch >= p->n_ch || k >= SI5351_NUM_PLL) return -1;
+    if (freq_hz < SI5351_OUT_MIN_HZ || freq_hz > SI5351_OUT_MAX_HZ) return -1;
+    if (!((p->pll_mask >> k) & 1u) || (p->pll[k].users & (uint8_t)~(1u << ch))) return -3;
+
+    search_t s;
+    memset(&s, 0, sizeof(s));
+    s.p = p;
+    s.ch = ch;
+    s.f = freq_hz;
+    s.t_start = time_us_64();
+    if (keep_ms) {
+        // 現在の MS/R のまま VCO だけ動かす: VCO = f * MS * R を帰還分数で近似
+        const si5351_cand_t *c = &p->ch[ch].sel;
+        if (!p->ch[ch].active || (c->flags & SI5351_CF_DIVBY4)) return -4;
+        double vco = (double)freq_hz * frac_value(&c->ms) * (double)(1u << c->r_log2);
+        if (vco < (double)SI5351_VCO_MIN_HZ || vco > (double)SI5351_VCO_MAX_HZ) return -4;
+        si5351_frac_t fb;
+        si5351_frac_approx((uint64_t)(vco / (double)p->ref_hz * (double)Q32_ONE + 0.5), Q32_ONE,
+                           SI5351_FRAC_MAX_DEN, &fb);
+        evaluate(&s, k, &fb, true, c->r_log2, &c->ms);
+    } else {
+        search_free_pll(&s, k);
+    }
+    p->last_elapsed_us = (uint32_t)(time_us_64() - s.t_start);
+    p->last_evaluated  = s.evaluated;
+    p->last_timed_out  = s.timed_out;
+    if (s.n_top == 0) return -2;
+    *out = s.top[0];
+    return 0;
+}
+
+int si5351_plan_channel(si5351_plan_t *p, unsigned ch, uint32_t freq_hz) {
+    search_t s;
+    int rc = solve(p, ch, freq_hz, &s);
+    if (rc != 0) return rc;
+
+    uint8_t me = (uint8_t)(1u << ch);
+    // 採用：旧 PLL から外して新 PLL に載せる（他チャネルのプランは不変）
+    si5351_plan_release(p, ch);
+    const si5351_cand_t *best = &s.top[0];
+    si5351_pll_plan_t *pl = &p->pll[best->pll];
+    if (best->flags & SI5351_CF_NEW_PLL) {
+        pl->fb     = best->fb;
+        pl->vco_hz = (double)p->ref_hz * frac_value(&best->fb);
+    }
+    pl->users |= me;
+    p->ch[ch].active  = true;
+    p->ch[ch].sel     = *best;
+    p->ch[ch].fine_hz = 0.0;
+
+    memcpy(p->runners[ch], s.top, sizeof(s.top));
+    p->n_runners[ch] = s.n_top;
+    return 0;
+}
+
+// 次の順列（辞書順）。最後の順列なら false
+static bool next_order(uint8_t *idx, unsigned n) {
+    if (n < 2) return false;
+    unsigned i = n - 1;
+    while (i > 0 && idx[i - 1] >= idx[i]) i--;
+    if (i == 0) return false;
+    unsigned j = n - 1;
+    while (idx[j] <= idx[i - 1]) j--;
+    uint8_t t = idx[i - 1]; idx[i - 1] = idx[j]; idx[j] = t;
+    for (j = n - 1; i < j; i++, j--) { t = idx[i]; idx[i] = idx[j]; idx[j] = t; }
+    return true;
+}
+
+int si5351_plan_replan(si5351_plan_t *p, unsigned ch, uint32_t freq_hz) {
+    if (ch >= p->n_ch) return -1;
+    if (freq_hz < SI5351_OUT_MIN_HZ || freq_hz > SI5351_OUT_MAX_HZ) return -1;
+
+    // set[0] = ch, set[1..] = 他の使用中チャネル（番号順）
+    uint32_t hz[SI5351_MAX_CH];
+    uint8_t set[SI5351_MAX_CH], idx[SI5351_MAX_CH], n = 0;
+    set[n] = (uint8_t)ch; hz[n++] = freq_hz;
+    for (unsigned c = 0; c < p->n_ch; c++) {
+        if (c == ch || !p->ch[c].active) continue;
+        if (p->ch[c].fine_hz != 0.0) return -3;     // fine のオフセットは再探索で失われる
+        set[n] = (uint8_t)c; hz[n++] = p->ch[c].sel.target_hz;
+    }
+    if (n < 2) return -2;
+    for (unsigned i = 0; i < n; i++) idx[i] = (uint8_t)i;
+
+    // 解く順序を辞書順に試す（ch を先に解く順序から）。各チャネルは先着の VCO を共有できなければ空き PLL を使う
+    uint64_t t0 = time_us_64();
+    unsigned tries = 0;
+    do {
+        for (unsigned i = 0; i < n; i++) si5351_plan_release(p, set[i]);
+        unsigned i = 0;
+        while (i < n && si5351_plan_channel(p, set[idx[i]], hz[idx[i]]) == 0) i++;
+        if (i == n) return 0;
+    } while (++tries < SI5351_REPLAN_ORDERS && time_us_64() - t0 < SI5351_REPLAN_BUDGET_US && next_order(idx, n));
+    return -2;
+}
+
+int si5351_plan_fine(si5351_plan_t *p, unsigned ch, double offset_hz) {
+    if (ch >= SI5351_MAX_CH || !p->ch[ch].active) return -1;
+    si5351_cand_t *c = &p->ch[ch].sel;
+    si5351_pll_plan_t *pl = &p->pll[c->pll];
+    if (pl->users & (uint8_t)~(1u << ch)) return -3;
+
+    double f   = (double)c->target_hz + offset_hz;
+    double div = frac_value(&c->ms) * (double)(1u << c->r_log2);
+    double vco = f * div;
+    if (f <= 0.0 || vco < (double)SI5351_VCO_MIN_HZ || vco > (double)SI5351_VCO_MAX_HZ) return -4;
+
+    double x = vco / (double)p->ref_hz;
+    si5351_frac_t fb = { (uint32_t)x, 0, SI5351_FINE_DEN };
+    fb.b = (uint32_t)((x - (double)fb.a) * (double)SI5351_FINE_DEN + 0.5);
+    if (fb.b >= SI5351_FINE_DEN) { fb.a++; fb.b = 0; }
+
+    pl->fb     = fb;
+    pl->vco_hz = (double)p->ref_hz * frac_value(&fb);
+    c->fb        = fb;
+    c->actual_hz = pl->vco_hz / div;
+    c->err_ppb   = fabs(c->actual_hz - f) / f * 1e9;
+    if (fb.b == 0) c->flags |= SI5351_CF_INT_PLL;
+    else           c->flags &= (uint8_t)~SI5351_CF_INT_PLL;
+    p->ch[ch].fine_hz = offset_hz;
+    return 0;
+}
+
+int SI5351_HOT(si5351_plan_adoptable)(const si5351_plan_t *p, unsigned ch, const si5351_cand_t *cand) {
+    if (ch >= SI5351_MAX_CH || cand->pll >= SI5351_NUM_PLL) return -1;
+    uint8_t me = (uint8_t)(1u << ch);
+    const si5351_pll_plan_t *pl = &p->pll[cand->pll];
+    bool same_fb = pl->fb.a == cand->fb.a && pl->fb.b == cand->fb.b && pl->fb.c == cand->fb.c;
+    bool others  = (pl->users & ~me) != 0;
+    if (others && !same_fb) return -3;
+    if (!others && !same_fb && !(cand->flags & SI5351_CF_NEW_PLL)) return -3;
+    return 0;
+}
+
+int SI5351_HOT(si5351_plan_adopt)(si5351_plan_t *p, unsigned ch, const si5351_cand_t *cand) {
+    int rc = si5351_plan_adoptable(p, ch, cand);
+    if (rc != 0) return rc;
+
+    si5351_pll_plan_t *pl = &p->pll[cand->pll];
+    uint8_t me = (uint8_t)(1u << ch);
+    si5351_plan_release(p, ch);
+    pl->fb     = cand->fb;
+    pl->vco_hz = (double)p->ref_hz * frac_value(&cand->fb);
+    pl->users |= me;
+    p->ch[ch].active  = true;
+    p->ch[ch].sel     = *cand;
+    p->ch[ch].fine_hz = 0.0;
+    return 0;
+}
+
+// =========================================================
+// 基準周波数の切替（基準ごとにプランをキャッシュ）
+// =========================================================
+static void snap_save(si5351_plan_t *p) {
+    // 同じ基準のスロット、なければ空き／最古（slot 0 から順に上書き）
+    si5351_plan_snap_t *sn = NULL;
+    for (unsigned i = 0; i < SI5351_REF_CACHE; i++)
+        if (p->refcache[i].ref_hz == p->ref_hz) sn = &p->refcache[i];
+    if (!sn) {
+        sn = &p->refcache[p->refcache_next];
+        p->refcache_next = (uint8_t)((p->refcache_next + 1) % SI5351_REF_CACHE);
+    }
+    sn->ref_hz = p->ref_hz;
+    sn->active_mask = 0;
+    for (unsigned ch = 0; ch < p->n_ch; ch++) {
+        if (!p->ch[ch].active) continue;
+        sn->active_mask |= (uint8_t)(1u << ch);
+        sn->sel[ch] = p->ch[ch].sel;
+        sn->fine_hz[ch] = p->ch[ch].fine_hz;
+    }
+    memcpy(sn->pll, p->pll, sizeof(sn->pll));
+}
+
+// スナップショットの目標周波数集合と fine オフセットが現在のプランと一致するか
+static bool snap_matches(const si5351_plan_t *p, const si5351_plan_snap_t *sn) {
+    for (unsigned ch = 0; ch < p->n_ch; ch++) {
+        bool act = p->ch[ch].active;
+        if (act != ((sn->active_mask >> ch) & 1u)) return false;
+        if (act && sn->sel[ch].target_hz != p->ch[ch].sel.target_hz) return false;
+        if (act && sn->fine_hz[ch] != p->ch[ch].fine_hz) return false;
+    }
+    return true;
+}
+
+int si5351_plan_set_ref(si5351_plan_t *p, uint32_t ref_hz) {
+    if (ref_hz < SI5351_PFD_MIN_HZ || ref_hz > SI5351_PFD_MAX_HZ) return -1;
+    if (ref_hz == p->ref_hz) return 1;
+
+    snap_save(p);
+    p->ref_hz = ref_hz;
+
+    for (unsigned i = 0; i < SI5351_REF_CACHE; i++) {
+        const si5351_plan_snap_t *sn = &p->refcache[i];
+        if (sn->ref_hz != ref_hz || !snap_matches(p, sn)) continue;
+        memcpy(p->pll, sn->pll, sizeof(p->pll));
+        for (unsigned ch = 0; ch < p->n_ch; ch++) {
+            if (!p->ch[ch].active) continue;
+            p->ch[ch].sel = sn->sel[ch];
+            p->ch[ch].fine_hz = sn->fine_hz[ch];
+            si5351_cf_cache_init(&p->cf[ch]);
+        }
+        return 1;
+    }
+
+    // キャッシュなし: 全 PLL を空けてチャネル番号順に再探索
+    uint32_t target[SI5351_MAX_CH];
+    double fine[SI5351_MAX_CH];
+    uint8_t mask = 0;
+    for (unsigned ch = 0; ch < p->n_ch; ch++) {
+        if (!p->ch[ch].active) continue;
+        target[ch] = p->ch[ch].sel.target_hz;
+        fine[ch] = p->ch[ch].fine_hz;
+        mask |= (uint8_t)(1u << ch);
+        si5351_plan_release(p, ch);
+    }
+    int rc = 0;
+    for (unsigned ch = 0; ch < p->n_ch; ch++) {
+        if (!((mask >> ch) & 1u)) continue;
+        si5351_cf_cache_init(&p->cf[ch]);
+        if (si5351_plan_channel(p, ch, target[ch]) != 0) rc = -2;
+        else if (fine[ch] != 0.0 && si5351_plan_fine(p, ch, fine[ch]) != 0 && rc == 0) rc = -3;
+    }
+    return rc;
+}
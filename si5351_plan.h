@@ -0,0 +1,267 @@
+/**
+ * @file    si5351_plan.h
+ * @brief   Si5351A 周波数プランナ（VCO / PLL a,b,c / MS a,b,c / R の候補探索とスコアリング）
+ * @date    2025-11-05
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SI5351_PLAN_H
+#define SI5351_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "si5351_chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===== デバイス定数 =====
+#define SI5351_XTAL_HZ          25000000UL
+#define SI5351_PFD_MIN_HZ       10000000UL  // PLL 入力（XTAL / CLKIN÷N）の範囲
+#define SI5351_PFD_MAX_HZ       40000000UL
+#define SI5351_CLKIN_MIN_HZ     10000000UL  // CLKIN 端子の入力範囲（Si5351C）
+#define SI5351_CLKIN_MAX_HZ     100000000UL
+#define SI5351_VCO_MIN_HZ       600000000UL
+#define SI5351_VCO_MAX_HZ       900000000UL
+#define SI5351_OUT_MIN_HZ       2500UL
+#define SI5351_OUT_MAX_HZ       150000000UL
+#define SI5351_FRAC_MAX_DEN     1048575UL   // c の上限（20bit）
+#define SI5351_MS_FRAC_MIN      8           // 分数MSは 8+1/c 以上
+#define SI5351_MS_MAX           2048
+#define SI5351_R_MAX_LOG2       7           // R = 1..128
+
+#define SI5351_MAX_CH           SI5351_MAX_OUT
+#define SI5351_NUM_PLL          2
+#define SI5351_PLAN_RUNNERS     5           // plan explain で保持する候補数
+#define SI5351_PLAN_BUDGET_US   20000       // 1ch あたりの探索時間上限（既定）
+#define SI5351_REPLAN_ORDERS    24          // si5351_plan_replan が試す解く順序の上限（4 チャネルなら全順序）
+#define SI5351_REPLAN_BUDGET_US 500000      // si5351_plan_replan の時間上限（順序ごとに確認）
+#define SI5351_REF_CACHE        2           // 基準周波数ごとに保持するプラン数
+#define SI5351_CF_DEPTH         34          // 収束子キャッシュ段数（c<=2^20 なら 31 段で足りる）
+
+// ===== スコア重み（小さいほど良い, 1点 = 0.01 ppb 相当）=====
+#define SI5351_SCORE_PER_PPB    100
+#define SI5351_SCORE_ERR_CAP    100000000UL // 1000 ppm 以上は同点扱い
+#define SI5351_SCORE_FRAC_MS    2000        // 分数 MultiSynth
+#define SI5351_SCORE_ODD_MS     500         // 整数だが奇数（MS_INT 不可）
+#define SI5351_SCORE_FRAC_PLL   1000        // 分数 PLL 帰還
+#define SI5351_SCORE_NEW_PLL    50          // 空き PLL を消費する
+#define SI5351_SCORE_PER_R      10          // R 分周 1段あたり
+#define SI5351_SCORE_VCO_EDGE   5           // VCO が範囲端 0.1% 以内（fine の余裕なし）
+#define SI5351_FINE_DEN         SI5351_FRAC_MAX_DEN  // fine は c 固定（P3 不変で書込バイト最小）
+
+// ===== 候補フラグ =====
+#define SI5351_CF_INT_MS        0x01        // MS が整数
+#define SI5351_CF_EVEN_MS       0x02        // MS が偶数整数（MS_INT=1 可）
+#define SI5351_CF_INT_PLL       0x04        // PLL 帰還が整数（FB_INT=1 可）
+#define SI5351_CF_DIVBY4        0x08        // MS=4 特殊モード
+#define SI5351_CF_NEW_PLL       0x10        // PLL の VCO をこの候補で決める
+
+/** a + b/c 形式の分周比 */
+typedef struct {
+    uint32_t a, b, c;
+} si5351_frac_t;
+
+/** 1チャネル分の候補（PLL 設定を含む） */
+typedef struct {
+    uint32_t      target_hz;
+    double        actual_hz;
+    double        err_ppb;
+    uint32_t      score;
+    uint8_t       pll;      // 0=PLLA, 1=PLLB
+    uint8_t       r_log2;   // R = 1<<r_log2
+    uint8_t       flags;    // SI5351_CF_*
+    si5351_frac_t fb;       // PLL 帰還（NEW_PLL でなければ既存値のコピー）
+    si5351_frac_t ms;
+} si5351_cand_t;
+
+/**
+ * 連分数収束子キャッシュ（ウォームスタート用）
+ * h[0..1], k[0..1] は h_{-2}=0,k_{-2}=1 / h_{-1}=1,k_{-1}=0 の固定値
+ */
+typedef struct {
+    uint32_t max_den;
+    uint8_t  depth;                 // 有効な収束子エントリ数（2 以上）
+    uint64_t h[SI5351_CF_DEPTH];
+    uint32_t k[SI5351_CF_DEPTH];
+    // 統計
+    uint32_t calls;
+    uint32_t warm_hits;             // 前回の収束子を再利用できた回数
+    uint32_t steps;                 // ユークリッド互除の実行段数（累計）
+} si5351_cf_cache_t;
+
+/** bench cf の結果 */
+typedef struct {
+    uint32_t n;
+    uint32_t random_us, random_steps;       // ランダム目標（キャッシュ使用）
+    uint32_t seq_cold_us, seq_cold_steps;   // 1 Hz ステップ（キャッシュなし）
+    uint32_t seq_warm_us, seq_warm_steps;   // 1 Hz ステップ（ウォームスタート）
+    uint32_t seq_warm_hits;
+} si5351_cf_bench_t;
+
+typedef struct {
+    uint8_t       users;    // 使用中チャネルのビットマスク
+    si5351_frac_t fb;
+    double        vco_hz;
+} si5351_pll_plan_t;
+
+typedef struct {
+    bool          active;
+    si5351_cand_t sel;
+    double        fine_hz;  // fine による target_hz からのオフセット
+} si5351_ch_plan_t;
+
+/** 基準周波数ごとのプラン保存（set_ref の再探索回避用） */
+typedef struct {
+    uint32_t          ref_hz;           // 0=未使用
+    uint8_t           active_mask;
+    si5351_cand_t     sel[SI5351_MAX_CH];
+    double            fine_hz[SI5351_MAX_CH];   // sel / pll に含まれる fine のオフセット
+    si5351_pll_plan_t pll[SI5351_NUM_PLL];
+} si5351_plan_snap_t;
+
+typedef struct {
+    si5351_pll_plan_t pll[SI5351_NUM_PLL];
+    si5351_ch_plan_t  ch[SI5351_MAX_CH];
+
+    uint32_t          ref_hz;           // PLL 入力周波数（XTAL または CLKIN÷N）
+    si5351_plan_snap_t refcache[SI5351_REF_CACHE];
+    uint8_t           refcache_next;
+
+    // plan explain 用（採用候補を先頭に score 昇順）
+    si5351_cand_t     runners[SI5351_MAX_CH][SI5351_PLAN_RUNNERS];
+    uint8_t           n_runners[SI5351_MAX_CH];
+
+    // チャネルごとの分数 MS 用収束子キャッシュ（直前と同じ PLL/R のときに使用）
+    si5351_cf_cache_t cf[SI5351_MAX_CH];
+
+    // チップ構成（si5351_plan_set_chip）
+    uint8_t           n_ch;             // 使用可能な出力数
+    uint8_t           compact_mask;     // MS6/MS7 形式（偶数整数 6..254 のみ）のチャネル
+    uint8_t           pll_mask;         // 自動割り当てに使える PLL（bit0=A, bit1=B）
+
+    uint32_t          budget_us;
+    uint32_t          last_elapsed_us;
+    uint32_t          last_evaluated;
+    bool              last_timed_out;
+} si5351_plan_t;
+
+/** プランを空にする（全PLL空き, 全ch停止, 3 出力 Si5351A 構成） */
+void si5351_plan_init(si5351_plan_t *p);
+
+/**
+ * @brief チップ記述子に合わせて出力数・MS6/MS7 制約・使用 PLL を設定する
+ * @note  Si5351B では PLLB を VCXO 用に残し、自動割り当ては PLLA のみとする
+ * @return 使えなくなった PLL から外したチャネルのマスク（呼び出し側で解き直すか止める）
+ */
+uint8_t si5351_plan_set_chip(si5351_plan_t *p, const si5351_chip_t *chip);
+
+/**
+ * @brief チャネル ch を freq_hz に割り当てる（インクリメンタル）
+ *
+ * 他チャネルが使用中の PLL は VCO を固定したまま探索し、既存チャネルの
+ * プランは変更しない。空き PLL（または ch 単独使用の PLL）は VCO も含めて探索する。
+ * @return 0=成功, -1=引数不正, -2=候補なし
+ */
+int  si5351_plan_channel(si5351_plan_t *p, unsigned ch, uint32_t freq_hz);
+
+/**
+ * @brief 他の使用中チャネルも含めて全 PLL を空けて解き直し, ch を freq_hz に割り当てる
+ *
+ * si5351_plan_channel() が -2（両 PLL が他チャネルの VCO で固定されて候補なし）のときの代替。
+ * 解く順序を変えながら（ch を先に解く順序から, 最大 SI5351_REPLAN_ORDERS 通り）貪欲に割り当て直す。
+ * 他チャネルの目標周波数は保つが PLL/MS は変わりうるので, 呼び出し側で書き直すこと。
+ * @note  失敗時はプランが途中の状態で残る（呼び出し側で退避・復元する）
+ * @return 0=成功, -1=引数不正, -2=候補なし（他の使用中チャネルなしを含む）, -3=fine 中のチャネルあり
+ */
+int  si5351_plan_replan(si5351_plan_t *p, unsigned ch, uint32_t freq_hz);
+
+/**
+ * @brief si5351_plan_channel() と同じ探索を行い、最良候補を out に返す（プランは変更しない）
+ *
+ * 予約実行用の事前求解。適用時は si5351_plan_adopt() で PLL 状態が変わっていないことを確認する。
+ * @return 0=成功, -1=引数不正, -2=候補なし
+ */
+int  si5351_plan_probe(si5351_plan_t *p, unsigned ch, uint32_t freq_hz, si5351_cand_t *out);
+
+/**
+ * @brief PLL k だけを使う候補を探す（プランは変更しない, hop の事前準備用）
+ *
+ * PLL k は空き（または ch 単独）であること。keep_ms なら ch の現在の MS/R をそのまま使い、
+ * VCO = f * MS * R となる帰還分数だけを求める（出力側は CLKx_CTRL の PLL 選択ビットだけで切り替わる）。
+ * @return 0=成功, -1=引数不正, -2=候補なし, -3=PLL k 使用中／使用不可, -4=keep_ms で VCO 範囲外
+ */
+int  si5351_plan_probe_pll(si5351_plan_t *p, unsigned ch, uint32_t freq_hz, uint8_t k, bool keep_ms,
+                           si5351_cand_t *out);
+
+/**
+ * @brief MultiSynth/R を固定したまま PLL 帰還分数だけで ch を target_hz + offset_hz に動かす
+ *
+ * VCO = (target+offset)*MS*R を分母 c=SI5351_FINE_DEN 固定で量子化する（P3 が変わらないため
+ * 書き換わるのは P1 下位と P2 の数バイトだけ）。プランの fb/VCO と採用候補の
+ * actual_hz/err_ppb を更新する（レジスタは書かない）。
+ * @return 0=成功, -1=ch 未設定, -3=PLL を他チャネルと共有中, -4=VCO 範囲外
+ */
+int  si5351_plan_fine(si5351_plan_t *p, unsigned ch, double offset_hz);
+
+/**
+ * @brief 以前の採用候補をそのまま ch に再適用する（再探索なし）
+ *
+ * NEW_PLL 候補は PLL が空き（または ch 単独）か VCO が一致する場合のみ、
+ * 共有候補は PLL の帰還が候補作成時と一致する場合のみ受け付ける。
+ * @return 0=成功, -1=引数不正, -3=PLL 状態が変わっている
+ */
+int  si5351_plan_adopt(si5351_plan_t *p, unsigned ch, const si5351_cand_t *cand);
+
+/** si5351_plan_adopt() が受け付けるか調べるだけ（プランは変えない, IRQ から可）。戻り値は同じ */
+int  si5351_plan_adoptable(const si5351_plan_t *p, unsigned ch, const si5351_cand_t *cand);
+
+/**
+ * @brief PLL 入力周波数を切り替える
+ *
+ * 切替前のプランを旧基準のスロットに保存し、新基準で保存済みのプランが同じ目標周波数集合と
+ * fine オフセットを持っていれば再探索せずに復元する。なければ全チャネルを新基準で再探索し、
+ * fine 中のチャネルには si5351_plan_fine() で同じオフセットをかけ直す。
+ * @return 1=キャッシュから復元（または変化なし）, 0=再探索成功, -1=範囲外, -2=一部チャネル失敗,
+ *         -3=解けたが fine のオフセットをかけ直せないチャネルあり（そのチャネルは fine_hz=0 の目標周波数）
+ */
+int  si5351_plan_set_ref(si5351_plan_t *p, uint32_t ref_hz);
+
+/** チャネル ch を解放（PLL の使用者がいなくなれば空きに戻す） */
+void si5351_plan_release(si5351_plan_t *p, unsigned ch);
+
+/**
+ * @brief num/den を分母 max_den 以下の最良有理近似 a + b/c に変換（連分数）
+ * @note  num, den < 2^43 を前提（内部積が 64bit に収まる範囲）
+ */
+void si5351_frac_approx(uint64_t num, uint64_t den, uint32_t max_den, si5351_frac_t *out);
+
+/** 収束子キャッシュを空にする */
+void si5351_cf_cache_init(si5351_cf_cache_t *cc);
+
+/**
+ * @brief si5351_frac_approx() のウォームスタート版
+ *
+ * キャッシュ中の収束子 (h_j,k_j) のうち num/den の連分数展開と先頭が一致する最深のものを
+ * 残余の符号・大小（r_j = ±(k_j*num - h_j*den), r_{j-1} > r_j >= 0）で判定し、そこから互除を再開する。
+ * 結果はキャッシュなし版と完全に一致する。
+ */
+void si5351_frac_approx_cached(si5351_cf_cache_t *cc, uint64_t num, uint64_t den,
+                               uint32_t max_den, si5351_frac_t *out);
+
+/** ランダム目標 vs 1 Hz 逐次ステップの求解コスト計測（n 回ずつ） */
+void si5351_cf_bench(uint32_t n, si5351_cf_bench_t *res);
+
+/** PLL 帰還レジスタ像（0x1A/0x22 から 8 バイト） */
+void si5351_encode_pll(const si5351_frac_t *fb, uint8_t out[8]);
+
+/** MultiSynth レジスタ像（R_DIV / DIVBY4 を含む 8 バイト） */
+void si5351_encode_ms(const si5351_frac_t *ms, uint8_t r_log2, bool divby4, uint8_t out[8]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_PLAN_H
@@ -0,0 +1,91 @@
+/**
+ * @file    si5351_ring.h
+ * @brief   単一生産者・単一消費者（SPSC）ロックフリー操作リング
+ * @date    2025-11-06
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * 生産者（CLI パーサ）だけが head を、消費者（レジスタエンジン）だけが tail を書く。
+ * 要素の受け渡しはメモリバリア（DMB）で順序付けるので、コア間でも割り込みとの間でも
+ * ロックなしで使える。tail は実行完了後に進めるため head==tail は「全操作実行済み」を意味する。
+ */
+
+#ifndef SI5351_RING_H
+#define SI5351_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/sync.h"   // __dmb()
+#include "si5351_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_OPQ_LEN
+#define SI5351_OPQ_LEN      32              // 2 のべき乗
+#endif
+#define SI5351_OPQ_MASK     (SI5351_OPQ_LEN - 1u)
+
+#if (SI5351_OPQ_LEN & (SI5351_OPQ_LEN - 1)) != 0
+#error "SI5351_OPQ_LEN must be a power of two"
+#endif
+
+typedef struct {
+    volatile uint32_t head;                 // 次に書くスロット（生産者のみ更新）
+    volatile uint32_t tail;                 // 次に実行するスロット（消費者のみ更新）
+    si5351_op_t      *buf;                  // SI5351_OPQ_LEN 要素（呼び出し側が用意）
+
+    // 統計（生産者側）
+    uint32_t pushed;
+    uint32_t hwm;                           // 最大滞留数
+    uint32_t full_events;                   // 満杯で待たされた／拒否された回数
+    uint32_t dropped;                       // 非ブロッキング投入で捨てた数
+    uint32_t stall_us;                      // 満杯待ちの累計時間
+    // 統計（消費者側）
+    uint32_t popped;
+} si5351_opq_t;
+
+static inline void si5351_opq_init(si5351_opq_t *q, si5351_op_t *buf) {
+    q->buf = buf;
+    q->head = q->tail = 0;
+    q->pushed = q->hwm = q->full_events = q->dropped = q->stall_us = 0;
+    q->popped = 0;
+}
+
+static inline uint32_t si5351_opq_depth(const si5351_opq_t *q) {
+    return q->head - q->tail;
+}
+
+/** 生産者: 1 件投入（満杯なら false, 何もしない） */
+static inline bool si5351_opq_push(si5351_opq_t *q, const si5351_op_t *op) {
+    uint32_t h = q->head;
+    if (h - q->tail >= SI5351_OPQ_LEN) return false;
+    q->buf[h & SI5351_OPQ_MASK] = *op;
+    __dmb();                                // 要素の書込みを head 更新より先に見せる
+    q->head = h + 1;
+    q->pushed++;
+    uint32_t d = h + 1 - q->tail;
+    if (d > q->hwm) q->hwm = d;
+    return true;
+}
+
+/** 消費者: 先頭要素を覗く（空なら NULL）。実行後に si5351_opq_pop() で解放する */
+static inline const si5351_op_t *si5351_opq_front(si5351_opq_t *q) {
+    uint32_t t = q->tail;
+    if (q->head == t) return NULL;
+    __dmb();                                // head を見てから要素を読む
+    return &q->buf[t & SI5351_OPQ_MASK];
+}
+
+static inline void si5351_opq_pop(si5351_opq_t *q) {
+    __dmb();                                // 要素の読出し完了後にスロットを返す
+    q->tail = q->tail + 1;
+    q->popped++;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_RING_H
@@ -0,0 +1,68 @@
+/**
+ * @file    si5351_sched.c
+ * @brief   予約実行キュー（時刻順の最小ヒープ + 固定スロット）
+ * @date    2025-11-07
+ * @version 1.0
+ */
+
+#include "si5351_sched.h"
+#include "si5351_hot.h"
+
+static inline bool key_less(const si5351_sched_key_t *x, const si5351_sched_key_t *y) {
+    if (x->t_us != y->t_us) return x->t_us < y->t_us;
+    return (int32_t)(x->seq - y->seq) < 0;
+}
+
+static inline void key_swap(si5351_sched_key_t *x, si5351_sched_key_t *y) {
+    si5351_sched_key_t t = *x; *x = *y; *y = t;
+}
+
+void si5351_sched_init(si5351_sched_t *s) {
+    s->n = 0;
+    s->seq = 0;
+    s->used = 0;
+}
+
+int si5351_sched_push(si5351_sched_t *s, uint64_t t_us) {
+    if (s->n >= SI5351_SCHED_MAX) return -1;
+    uint8_t slot = 0;
+    while ((s->used >> slot) & 1u) slot++;
+    s->used |= 1u << slot;
+
+    unsigned i = s->n++;
+    s->heap[i] = (si5351_sched_key_t){ t_us, s->seq++, slot };
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!key_less(&s->heap[i], &s->heap[parent])) break;
+        key_swap(&s->heap[i], &s->heap[parent]);
+        i = parent;
+    }
+    return slot;
+}
+
+bool SI5351_HOT(si5351_sched_peek)(const si5351_sched_t *s, uint64_t *t_us, uint8_t *slot) {
+    if (s->n == 0) return false;
+    if (t_us) *t_us = s->heap[0].t_us;
+    if (slot) *slot = s->heap[0].slot;
+    return true;
+}
+
+int SI5351_HOT(si5351_sched_pop)(si5351_sched_t *s) {
+    if (s->n == 0) return -1;
+    int slot = s->heap[0].slot;
+    s->heap[0] = s->heap[--s->n];
+    unsigned i = 0;
+    for (;;) {
+        unsigned l = 2 * i + 1, r = l + 1, m = i;
+        if (l < s->n && key_less(&s->heap[l], &s->heap[m])) m = l;
+        if (r < s->n && key_less(&s->heap[r], &s->heap[m])) m = r;
+        if (m == i) break;
+        key_swap(&s->heap[i], &s->heap[m]);
+        i = m;
+    }
+    return slot;
+}
+
+void SI5351_HOT(si5351_sched_free)(si5351_sched_t *s, uint8_t slot) {
+    s->used &= ~(1u << slot);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file    si5351_sched.h
+ * @brief   予約実行キュー（時刻順の最小ヒープ + 固定スロット）
+ * @date    2025-11-07
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * ヒープには (時刻, 投入順, スロット番号) だけを持ち、ペイロードは呼び出し側が
+ * スロット番号で管理する。同時刻は投入順に取り出す。
+ */
+
+#ifndef SI5351_SCHED_H
+#define SI5351_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_SCHED_MAX
+#define SI5351_SCHED_MAX    16
+#endif
+
+typedef struct {
+    uint64_t t_us;
+    uint32_t seq;
+    uint8_t  slot;
+} si5351_sched_key_t;
+
+typedef struct {
+    si5351_sched_key_t heap[SI5351_SCHED_MAX];
+    uint8_t            n;
+    uint32_t           seq;
+    uint32_t           used;    // 使用中スロットのビットマスク
+} si5351_sched_t;
+
+void si5351_sched_init(si5351_sched_t *s);
+
+/**
+ * @brief 時刻 t_us のエントリを追加する
+ * @return スロット番号（0..SI5351_SCHED_MAX-1）, 満杯なら -1
+ */
+int  si5351_sched_push(si5351_sched_t *s, uint64_t t_us);
+
+/** 最も早いエントリを覗く（空なら false） */
+bool si5351_sched_peek(const si5351_sched_t *s, uint64_t *t_us, uint8_t *slot);
+
+/** 最も早いエントリをヒープから外す（スロットは si5351_sched_free() まで使用中のまま） */
+int  si5351_sched_pop(si5351_sched_t *s);
+
+void si5351_sched_free(si5351_sched_t *s, uint8_t slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_SCHED_H
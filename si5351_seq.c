@@ -0,0 +1,91 @@
+/**
+ * @file    si5351_seq.c
+ * @brief   レジスタ列の差分圧縮形式（ステップごとに前ステップから変わったバイトだけを持つ）
+ * @date    2025-11-09
+ * @version 1.0
+ */
+
+#include "si5351_seq.h"
+#include <string.h>
+
+void si5351_seq_init(si5351_seq_t *q, uint8_t *buf, uint32_t cap) {
+    memset(q, 0, sizeof(*q));
+    q->buf = buf;
+    q->cap = cap;
+}
+
+bool si5351_seq_begin(si5351_seq_t *q) {
+    q->step_start = q->len;
+    q->cur_payload = 0;
+    q->step_raw = q->raw_bytes;                         // 容量不足で捨てるときの戻し先
+    memcpy(q->step_img, q->img, sizeof(q->img));
+    memcpy(q->step_touched, q->touched, sizeof(q->touched));
+    if (q->len + 1u > q->cap) { q->overflow = true; return false; }
+    q->buf[q->len++] = 0;                               // run 数（end で確定）
+    return true;
+}
+
+static bool put_run(si5351_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len) {
+    if (q->buf[q->step_start] == 0xFF || q->len + 2u + len > q->cap) { q->overflow = true; return false; }
+    q->buf[q->len++] = reg;
+    q->buf[q->len++] = len;
+    memcpy(&q->buf[q->len], d, len);
+    q->len += len;
+    q->buf[q->step_start]++;
+    q->cur_payload += 1u + len;
+    return true;
+}
+
+int si5351_seq_put(si5351_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len, bool full) {
+    int lo = -1, hi = -1, diff = 0;
+    for (int i = 0; i < len; i++) {
+        if (q->img[(uint8_t)(reg + i)] != d[i]) { diff++; if (lo < 0) lo = i; hi = i; }
+    }
+    q->raw_bytes += len;
+    if (full) { lo = 0; hi = len - 1; }
+    if (lo < 0) return 0;
+    if (!put_run(q, (uint8_t)(reg + lo), &d[lo], (uint8_t)(hi - lo + 1))) return -1;
+    for (int i = lo; i <= hi; i++) {
+        uint8_t r = (uint8_t)(reg + i);
+        q->img[r] = d[i];
+        q->touched[r >> 5] |= 1u << (r & 31);
+    }
+    return diff;
+}
+
+bool si5351_seq_raw(si5351_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len) {
+    q->raw_bytes += len;
+    return put_run(q, reg, d, len);
+}
+
+void si5351_seq_cancel(si5351_seq_t *q) {
+    // 捨てたステップの書込みを img/touched からも消す（次のステップの差分が欠けないように）
+    q->len = q->step_start;
+    q->cur_payload = 0;
+    q->raw_bytes = q->step_raw;
+    memcpy(q->img, q->step_img, sizeof(q->img));
+    memcpy(q->touched, q->step_touched, sizeof(q->touched));
+}
+
+bool si5351_seq_end(si5351_seq_t *q) {
+    if (q->overflow) { si5351_seq_cancel(q); return false; }
+    uint32_t runs = q->buf[q->step_start];
+    q->n_steps++;
+    q->payload += q->cur_payload;
+    q->runs += runs;
+    if (q->cur_payload > q->max_step_payload) q->max_step_payload = q->cur_payload;
+    if (runs > q->max_step_runs) q->max_step_runs = runs;
+    return true;
+}
+
+bool si5351_seq_decode(const si5351_seq_t *q, uint32_t *pos, si5351_seq_sink_t sink, void *ctx) {
+    const uint8_t *p = &q->buf[*pos];
+    uint8_t n = *p++;
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t reg = p[0], len = p[1];
+        if (!sink(ctx, reg, &p[2], len)) return false;
+        p += 2u + len;
+    }
+    *pos = (uint32_t)(p - q->buf);
+    return true;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file    si5351_seq.h
+ * @brief   レジスタ列の差分圧縮形式（ステップごとに前ステップから変わったバイトだけを持つ）
+ * @date    2025-11-09
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * 1 ステップ = [run 数 N] + N × [開始レジスタ][長さ L][バイト × L]
+ *
+ * エンコーダは直前ステップまでのレジスタ値 img[] を持ち、si5351_seq_put() は img と異なる
+ * 範囲だけを 1 run として積む。掃引の隣接ステップは MS の数バイトしか変わらないので、
+ * 8 バイト像をそのまま持つより 1 桁ほど小さくなる。
+ */
+
+#ifndef SI5351_SEQ_H
+#define SI5351_SEQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t  *buf;
+    uint32_t  len, cap;
+    uint32_t  n_steps;
+    uint32_t  step_start;               // 作成中ステップのヘッダ位置
+    uint8_t   img[256];                 // 直前ステップ後のレジスタ値（呼び出し側が初期値を入れる）
+    uint32_t  touched[256 / 32];        // 一度でも書いたレジスタ
+    uint8_t   step_img[256];            // 作成中ステップ開始時の img / touched / raw_bytes（si5351_seq_end で戻す）
+    uint32_t  step_touched[256 / 32];
+    uint32_t  step_raw;
+    // 統計
+    uint32_t  raw_bytes;                // 全像で持った場合のデータバイト数
+    uint32_t  payload, runs;            // I2C ペイロード（レジスタ番号を含む）とトランザクション数
+    uint32_t  max_step_payload, max_step_runs;
+    uint32_t  cur_payload;
+    bool      overflow;
+} si5351_seq_t;
+
+/** run を 1 つ受け取る（false で復号を中断） */
+typedef bool (*si5351_seq_sink_t)(void *ctx, uint8_t reg, const uint8_t *d, uint8_t len);
+
+void si5351_seq_init(si5351_seq_t *q, uint8_t *buf, uint32_t cap);
+
+/** ステップ開始（ヘッダ 1 バイトを予約）。容量不足なら false */
+bool si5351_seq_begin(si5351_seq_t *q);
+
+/**
+ * @brief img と異なる範囲を 1 run として積む（full なら len バイトすべて）
+ * @return img と異なっていたバイト数, 負=容量不足
+ */
+int  si5351_seq_put(si5351_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len, bool full);
+
+/** img に残さない書込み（PLL リセットなど自己クリアのレジスタ）を積む */
+bool si5351_seq_raw(si5351_seq_t *q, uint8_t reg, const uint8_t *d, uint8_t len);
+
+/** 作成中ステップを捨てる（buf/img/touched/raw_bytes を si5351_seq_begin() の時点に戻す） */
+void si5351_seq_cancel(si5351_seq_t *q);
+
+/** ステップを確定。容量不足なら si5351_seq_cancel() して false */
+bool si5351_seq_end(si5351_seq_t *q);
+
+/**
+ * @brief *pos から 1 ステップを復号して run ごとに sink を呼ぶ
+ * @return 成功なら true（*pos は次ステップへ進む）。sink が false を返したら *pos は動かない
+ */
+bool si5351_seq_decode(const si5351_seq_t *q, uint32_t *pos, si5351_seq_sink_t sink, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_SEQ_H
@@ -0,0 +1,63 @@
+/**
+ * @file    si5351_sna.h
+ * @brief   スカラーネットワークアナライザ（`sna`）の設定値と出力形式
+ * @date    2025-11-16
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Si5351 の出力（SI5351_SNA_CH）を信号源、ADC につないだ対数検波器を受信側として周波数特性を測る。
+ * 1 点ごとに「書込み（PLL リセットならロックまで）→ 整定待ち → ADC を DMA で N サンプル取り込み → 平均」を行い、
+ * 取り込み中に前の点の結果を USB へ送り、次の点のレジスタ像を解いておく。
+ *
+ *   出力: "sna bin: ..." の 1 行の後に
+ *         "S5NA" [版 u16][1 点の大きさ u16][点数 u32][サンプル数 u16][整定 us u16][開始 Hz u32][終了 Hz u32]
+ *         + si5351_sna_rec_t × 点数（LE, 途中停止なら少ない）, 最後に集計 1 行
+ */
+
+#ifndef SI5351_SNA_H
+#define SI5351_SNA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_SNA_CH
+#define SI5351_SNA_CH           0           // 信号源に使う出力
+#endif
+#ifndef SI5351_SNA_SAMPLES_MAX
+#define SI5351_SNA_SAMPLES_MAX  1024        // 1 点あたりの ADC サンプル上限（× 2 バイトをアリーナから確保）
+#endif
+#define SI5351_SNA_SAMPLES_DEF  64
+#define SI5351_SNA_SETTLE_DEF   500         // 書込み（とロック）後, 検波器の整定を待つ時間 [us]
+
+#define SI5351_SNA_MAGIC        "S5NA"
+#define SI5351_SNA_VERSION      1
+
+// SI5351_OP_SNA_PARAM の b0
+#define SI5351_SNA_P_STOP_HZ    0
+#define SI5351_SNA_P_POINTS     1
+#define SI5351_SNA_P_SAMPLES    2
+#define SI5351_SNA_P_SETTLE_US  3
+#define SI5351_SNA_P_SIM_BW_HZ  4
+
+// si5351_sna_rec_t.flags
+#define SI5351_SNA_F_RESET      0x0001      // この点で PLL をリセットした
+#define SI5351_SNA_F_UNLOCKED   0x0002      // ロックを確かめられなかった
+#define SI5351_SNA_F_ERROR      0x0004      // 解なし・I2C 失敗・ADC 失敗
+#define SI5351_SNA_F_SIM        0x8000      // 模擬検波器の値
+
+/** 1 点（12 バイト） */
+typedef struct {
+    uint32_t hz;                // 目標周波数
+    uint16_t mean_x16;          // ADC コード平均 × 16（12 bit → 16 bit 固定小数）
+    uint16_t min, max;
+    uint16_t flags;             // SI5351_SNA_F_*
+} si5351_sna_rec_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_SNA_H
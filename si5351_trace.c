@@ -0,0 +1,234 @@
+/**
+ * @file    si5351_trace.c
+ * @brief   I2C トランザクションの記録（RAM リング）と集計・ダンプ（`trace`）
+ * @date    2025-11-15
+ * @version 1.0
+ */
+
+#include "si5351_trace.h"
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/stdio.h"
+#include "hardware/sync.h"
+#include "hardware/structs/timer.h"
+#include "serial_comm.h"
+#include "si5351_ops.h"
+#include "si5351_mem.h"
+#include "si5351_hot.h"
+
+#define TRACE_MAGIC     "S5TR"
+#define TRACE_VERSION   1
+#define TRACE_GROUPS    24                  // 内訳に並べる操作の種類の上限
+
+_Static_assert(sizeof(si5351_trace_ev_t) == 24, "trace entry must stay 24 bytes (binary dump format)");
+
+volatile bool    si5351_trace_active;
+volatile uint8_t si5351_trace_ctx = SI5351_TR_CTX_NONE;
+
+static si5351_trace_ev_t *g_ring;           // アリーナ上（SI5351_TRACE_LEN 件）
+static int      g_mem_trace = -1;
+static uint32_t g_head;                     // 記録した総数（次に書く位置 = g_head % LEN）
+static uint32_t g_t_on, g_t_off;            // on / off の時刻
+static uint64_t g_busy_us;                  // on 以降のバス占有時間の合計
+static uint32_t g_bytes, g_fails;
+
+// オペコード名（ops.h の順）
+static const char *const k_op_name[SI5351_OP_COUNT] = {
+    "nop", "call", "init", "scan", "status", "peek", "poke", "force_on", "oe", "freq", "fine", "drive",
+    "invert", "idle", "cfg", "power", "chip", "ref", "plan", "plan explain", "plan budget", "bench cf",
+    "bench isr", "at", "at list", "at clear", "trig load", "trig arm", "trig off", "trig show", "dma param",
+    "dma sweep", "dma play", "dma show", "dma bench", "trace", "hop prep", "hop go", "hop show",
+    "track", "track show", "sna param", "sna", "sna sim", "sna show",
+    "fm param", "fm", "fm sim", "fm show", "ping",
+};
+
+static const char *ctx_name(uint8_t ctx) {
+    switch (ctx) {
+    case SI5351_TR_CTX_AT:   return "at fire";
+    case SI5351_TR_CTX_TRIG: return "trig step";
+    case SI5351_TR_CTX_ISR:  return "bench isr irq";
+    case SI5351_TR_CTX_DMA:  return "dma segment";
+    case SI5351_TR_CTX_NONE: return "-";
+    default:                 return ctx < SI5351_OP_COUNT ? k_op_name[ctx] : "?";
+    }
+}
+
+static const char *kind_name(uint8_t kind) {
+    return kind == SI5351_TR_WR ? "wr" : kind == SI5351_TR_RD ? "rd" : "dma";
+}
+
+bool si5351_trace_init(void) {
+    g_ring = si5351_mem_alloc("trace", SI5351_TRACE_LEN * (uint32_t)sizeof(si5351_trace_ev_t), &g_mem_trace);
+    return g_ring != NULL;
+}
+
+// ===== 記録（I2C 転送の直後, IRQ からも呼ばれる）=====
+void SI5351_HOT(si5351_trace_put)(uint8_t kind, uint8_t dev, uint8_t reg, const uint8_t *d, uint16_t len,
+                                  uint32_t t0_us, int rc) {
+    uint32_t t1 = timer_hw->timerawl;
+    uint8_t  n = (kind == SI5351_TR_DMA || !d) ? 0 : (uint8_t)(len < 8 ? len : 8);
+    uint32_t irq = save_and_disable_interrupts();      // エンジンの記録中に at / trig の IRQ が割り込んでも壊さない
+    if (!si5351_trace_active) { restore_interrupts(irq); return; }
+    si5351_trace_ev_t *e = &g_ring[g_head++ % SI5351_TRACE_LEN];
+    e->t0_us  = t0_us;
+    e->dur_us = t1 - t0_us;
+    e->len    = len;
+    e->dev    = dev;
+    e->reg    = reg;
+    e->kind   = kind;
+    e->ctx    = (kind == SI5351_TR_DMA) ? SI5351_TR_CTX_DMA : si5351_trace_ctx;
+    e->rc     = (int8_t)(rc < -128 ? -128 : rc);
+    e->n_data = n;
+    for (uint8_t i = 0; i < n; i++) e->d[i] = d[i];
+    g_busy_us += e->dur_us;
+    g_bytes   += len;
+    if (rc != 0) g_fails++;
+    restore_interrupts(irq);
+}
+
+// ===== 参照 =====
+static uint32_t count(void) {
+    return g_head < SI5351_TRACE_LEN ? g_head : SI5351_TRACE_LEN;
+}
+
+// 古い順に i 番目（0..count()-1）
+static const si5351_trace_ev_t *at(uint32_t i) {
+    return &g_ring[(g_head - count() + i) % SI5351_TRACE_LEN];
+}
+
+static void clear(void) {
+    g_head = 0;
+    g_busy_us = 0;
+    g_bytes = g_fails = 0;
+    g_t_on = g_t_off = timer_hw->timerawl;
+    si5351_mem_use(g_mem_trace, 0);
+}
+
+static void show(void) {
+    uint32_t n = count(), now = si5351_trace_active ? timer_hw->timerawl : g_t_off, span = now - g_t_on;
+    serial_printf("trace: %s, %lu transaction(s) (ring %u, %lu overwritten), %lu B, %lu failed", 1,
+                  si5351_trace_active ? "on" : "off", (unsigned long)g_head, (unsigned)SI5351_TRACE_LEN,
+                  (unsigned long)(g_head - n), (unsigned long)g_bytes, (unsigned long)g_fails);
+    if (!g_head) return;
+    serial_printf("  bus busy %llu us of %lu us recorded (%.2f %%)", 1, (unsigned long long)g_busy_us,
+                  (unsigned long)span, span ? 100.0 * (double)g_busy_us / span : 0.0);
+
+    // リングに残っている範囲の使用率と, 実行中の操作ごとの内訳
+    struct { uint8_t ctx; uint32_t n, bytes, fails; uint64_t us; } grp[TRACE_GROUPS];
+    unsigned n_grp = 0, other = 0;
+    uint64_t busy = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const si5351_trace_ev_t *e = at(i);
+        busy += e->dur_us;
+        unsigned g = 0;
+        while (g < n_grp && grp[g].ctx != e->ctx) g++;
+        if (g == n_grp) {
+            if (n_grp == TRACE_GROUPS) { other++; continue; }
+            memset(&grp[n_grp], 0, sizeof(grp[0]));
+            grp[n_grp++].ctx = e->ctx;
+        }
+        grp[g].n++;
+        grp[g].bytes += e->len;
+        grp[g].us    += e->dur_us;
+        if (e->rc) grp[g].fails++;
+    }
+    const si5351_trace_ev_t *first = at(0), *last = at(n - 1);
+    uint32_t win = last->t0_us + last->dur_us - first->t0_us;
+    serial_printf("  ring window %lu us, bus busy %llu us (%.1f %%)", 1, (unsigned long)win,
+                  (unsigned long long)busy, win ? 100.0 * (double)busy / win : 0.0);
+    serial_printf("  %-14s %6s %8s %10s %8s %5s", 1, "command", "xfers", "bytes", "bus us", "avg us", "fail");
+    for (unsigned g = 0; g < n_grp; g++)
+        serial_printf("  %-14s %6lu %8lu %10llu %8lu %5lu", 1, ctx_name(grp[g].ctx), (unsigned long)grp[g].n,
+                      (unsigned long)grp[g].bytes, (unsigned long long)grp[g].us,
+                      (unsigned long)(grp[g].us / grp[g].n), (unsigned long)grp[g].fails);
+    if (other) serial_printf("  (%u transaction(s) in further commands not listed)", 1, other);
+}
+
+// n 件（0=全件）の最新分を古い順に出す
+static uint32_t first_of(uint32_t n) {
+    uint32_t c = count();
+    return (n == 0 || n > c) ? 0 : c - n;
+}
+
+static void dump_text(uint32_t n) {
+    uint32_t c = count(), seq0 = g_head - c;
+    if (!c) { serial_printf("trace: empty", 1); return; }
+    serial_printf("%8s %10s %7s %-4s %-4s %-4s %4s %4s  %-14s %s", 1, "#", "t0 us", "dur us", "kind", "dev", "reg",
+                  "len", "rc", "command", "data");
+    for (uint32_t i = first_of(n); i < c; i++) {
+        const si5351_trace_ev_t *e = at(i);
+        serial_printf("%8lu %10lu %7lu %-4s 0x%02X 0x%02X %4u %4d  %-14s", 0, (unsigned long)(seq0 + i),
+                      (unsigned long)e->t0_us, (unsigned long)e->dur_us, kind_name(e->kind), e->dev, e->reg, e->len,
+                      e->rc, ctx_name(e->ctx));
+        for (uint8_t k = 0; k < e->n_data; k++) serial_printf(" %02X", 0, e->d[k]);
+        serial_printf("", 1);
+    }
+}
+
+static void dump_csv(uint32_t n) {
+    uint32_t c = count(), seq0 = g_head - c;
+    serial_printf("seq,t_start_us,t_end_us,kind,dev,reg,len,rc,command,data", 1);
+    for (uint32_t i = first_of(n); i < c; i++) {
+        const si5351_trace_ev_t *e = at(i);
+        serial_printf("%lu,%lu,%lu,%s,%u,%u,%u,%d,%s,", 0, (unsigned long)(seq0 + i), (unsigned long)e->t0_us,
+                      (unsigned long)(e->t0_us + e->dur_us), kind_name(e->kind), e->dev, e->reg, e->len, e->rc,
+                      ctx_name(e->ctx));
+        for (uint8_t k = 0; k < e->n_data; k++) serial_printf("%02X", 0, e->d[k]);
+        serial_printf("", 1);
+    }
+}
+
+// 改行変換を通さずに出す（stdio の CRLF 変換でバイナリが崩れないように）
+static void put_raw(const void *p, uint32_t len) {
+    const uint8_t *b = p;
+    for (uint32_t i = 0; i < len; i++) putchar_raw(b[i]);
+}
+
+static void dump_bin(uint32_t n) {
+    uint32_t c = count(), i0 = first_of(n), cnt = c - i0, now = timer_hw->timerawl;
+    uint16_t ver = TRACE_VERSION, sz = (uint16_t)sizeof(si5351_trace_ev_t);
+    serial_printf("trace bin: %lu entr%s, %lu B follow", 1, (unsigned long)cnt, cnt == 1 ? "y" : "ies",
+                  (unsigned long)(16u + cnt * sz));
+    put_raw(TRACE_MAGIC, 4);
+    put_raw(&ver, 2);
+    put_raw(&sz, 2);
+    put_raw(&cnt, 4);
+    put_raw(&now, 4);
+    for (uint32_t i = i0; i < c; i++) put_raw(at(i), sz);
+    serial_printf("", 1);
+}
+
+void si5351_trace_op(uint8_t sub, uint32_t n) {
+    switch (sub) {
+    case SI5351_TR_ON:
+        clear();
+        si5351_trace_active = true;
+        serial_printf("trace: on (ring %u x %u B)", 1, (unsigned)SI5351_TRACE_LEN,
+                      (unsigned)sizeof(si5351_trace_ev_t));
+        return;
+    case SI5351_TR_OFF:
+        if (si5351_trace_active) g_t_off = timer_hw->timerawl;
+        si5351_trace_active = false;
+        show();
+        return;
+    case SI5351_TR_CLEAR:
+        clear();
+        serial_printf("trace: cleared", 1);
+        return;
+    default:
+        break;
+    }
+    // 出力中は記録を止める（IRQ からの記録で読んでいる範囲が動かないように）
+    bool was = si5351_trace_active;
+    si5351_trace_active = false;
+    uint32_t t = timer_hw->timerawl;
+    switch (sub) {
+    case SI5351_TR_DUMP: dump_text(n); break;
+    case SI5351_TR_CSV:  dump_csv(n); break;
+    case SI5351_TR_BIN:  dump_bin(n); break;
+    default:             show(); break;
+    }
+    si5351_mem_use(g_mem_trace, count() * (uint32_t)sizeof(si5351_trace_ev_t));
+    if (was) g_t_on += timer_hw->timerawl - t;      // 出力に使った時間は使用率の分母から除く
+    si5351_trace_active = was;
+}
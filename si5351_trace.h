@@ -0,0 +1,90 @@
+/**
+ * @file    si5351_trace.h
+ * @brief   I2C トランザクションの記録（RAM リング）と集計・ダンプ（`trace`）
+ * @date    2025-11-15
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * `trace on` の間、エンジンが出す I2C トランザクション 1 件ごとに
+ * デバイス・レジスタ・長さ・先頭 8 バイト・開始時刻と所要時間・結果・実行中の操作を 24 バイトで記録する。
+ * リングはアリーナ上（SI5351_TRACE_LEN 件）で、満杯になると古いものから上書きする。
+ * 記録は割り込み禁止の間に 1 件書くだけで、`trace off` の間は呼び出し側の分岐 1 つで済む。
+ *
+ * DMA 掃引は区間（最大 SI5351_DMA_STEPS ステップ）ごとに 1 件として記録する（len=ステップ数）。
+ * `trace` で件数・バス使用率・操作ごとの内訳、`trace dump [n]` で表、`trace csv` で CSV、
+ * `trace bin` でバイナリ（下記）を出す。いずれもエンジン文脈で実行する（SI5351_OP_TRACE）。
+ *
+ *   バイナリ: "S5TR" [版 u16][1 件の大きさ u16][件数 u32][出力時刻 us u32] + si5351_trace_ev_t × 件数（古い順, LE）
+ */
+
+#ifndef SI5351_TRACE_H
+#define SI5351_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_TRACE_LEN
+#define SI5351_TRACE_LEN    512         // 記録件数（× 24 バイトをアリーナから確保）
+#endif
+
+// 種別（kind）
+#define SI5351_TR_WR        0
+#define SI5351_TR_RD        1
+#define SI5351_TR_DMA       2
+
+// 実行中の操作（ctx）: 0..SI5351_OP_COUNT-1 はオペコード, 以下は IRQ・エンジン内部
+#define SI5351_TR_CTX_AT    0xF0        // 予約の実行（at, IRQ またはエンジン）
+#define SI5351_TR_CTX_TRIG  0xF1        // トリガのステップ送り（trig, IRQ またはエンジン）
+#define SI5351_TR_CTX_ISR   0xF2        // bench isr
+#define SI5351_TR_CTX_DMA   0xF3        // DMA 掃引の区間
+#define SI5351_TR_CTX_NONE  0xFF
+
+// SI5351_OP_TRACE の b0（v.u = 件数, 0 なら全件）
+#define SI5351_TR_SHOW      0
+#define SI5351_TR_ON        1
+#define SI5351_TR_OFF       2
+#define SI5351_TR_CLEAR     3
+#define SI5351_TR_DUMP      4
+#define SI5351_TR_CSV       5
+#define SI5351_TR_BIN       6
+
+/** 1 件（24 バイト） */
+typedef struct {
+    uint32_t t0_us;                     // 開始時刻（起動後 us の下位 32 bit）
+    uint32_t dur_us;
+    uint16_t len;                       // バイト数（DMA はステップ数）
+    uint8_t  dev, reg;
+    uint8_t  kind, ctx;
+    int8_t   rc;                        // 0=成功, 負=NACK/タイムアウト
+    uint8_t  n_data;                    // d[] の有効バイト数
+    uint8_t  d[8];
+} si5351_trace_ev_t;
+
+/** 記録中なら true（呼び出し側はこれを見てから si5351_trace_put() を呼ぶ） */
+extern volatile bool si5351_trace_active;
+
+/** 実行中の操作（エンジンが操作・IRQ の前後で書き換える） */
+extern volatile uint8_t si5351_trace_ctx;
+
+/** アリーナにリングを確保する（エンジン初期化時）。不足なら false */
+bool si5351_trace_init(void);
+
+/**
+ * @brief 1 件記録する（I2C 転送の直後に呼ぶ, IRQ からも可）
+ * @param t0_us 転送開始時刻（timer の下位 32 bit）。終了時刻は呼び出し時点
+ */
+void si5351_trace_put(uint8_t kind, uint8_t dev, uint8_t reg, const uint8_t *d, uint16_t len, uint32_t t0_us,
+                      int rc);
+
+/** SI5351_OP_TRACE の実行（エンジン文脈） */
+void si5351_trace_op(uint8_t sub, uint32_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_TRACE_H
@@ -0,0 +1,176 @@
+/**
+ * @file    si5351_wdt.c
+ * @brief   ウォッチドッグ監視と再起動をまたぐ保持領域（Si5351 の状態・直近の操作記録）
+ * @date    2025-11-13
+ * @version 1.0
+ */
+
+#include "si5351_wdt.h"
+#include <stddef.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "hardware/structs/watchdog.h"
+#include "serial_comm.h"
+#include "si5351_engine.h"
+
+#define KEEP_MAGIC  0x4B353553u                 // "S5K"（scratch[0]）
+#define EV_MAGIC    0x56453553u                 // 操作記録のチェック値の種
+
+// scratch[0]=KEEP_MAGIC, [1]=長さ<<1 | 面, [2]=チェックサム, [3]=連続復元回数
+#define SCR_MAGIC   0
+#define SCR_SLOT    1
+#define SCR_SUM     2
+#define SCR_STREAK  3
+
+typedef struct {
+    uint32_t    seq, t_ms;
+    si5351_op_t op;
+    uint32_t    chk;
+} wdt_ev_t;
+
+// ===== 保持領域（リセットで初期化されない SRAM）=====
+static uint8_t  __uninitialized_ram(g_keep)[2][SI5351_WDT_KEEP_BYTES] __attribute__((aligned(8)));
+static wdt_ev_t __uninitialized_ram(g_ev)[SI5351_WDT_EVENTS];
+
+// ===== 内部状態 =====
+static bool     g_by_wdt;                   // 起動理由がウォッチドッグのタイムアウト
+static uint8_t  g_slot;                     // 最後に確定した面
+static const void *g_kept;                  // 起動時に有効だった保持内容
+static uint32_t g_kept_len;
+static uint32_t g_commits;
+static uint32_t g_streak;                   // 連続してウォッチドッグで再起動した回数
+static uint32_t g_timeout_ms;
+static uint32_t g_beat;                     // 前回更新時のエンジン心拍
+static uint32_t g_ev_seq;
+static wdt_ev_t g_prev[SI5351_WDT_EVENTS];  // 前回の操作記録（古い順）
+static unsigned g_prev_n;
+
+static uint32_t fnv1a(const void *p, uint32_t n) {
+    const uint8_t *b = p;
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < n; i++) { h ^= b[i]; h *= 16777619u; }
+    return h;
+}
+
+static uint32_t ev_chk(const wdt_ev_t *e) {
+    return fnv1a(e, offsetof(wdt_ev_t, chk)) ^ EV_MAGIC;
+}
+
+// 前回の操作記録を番号順に取り出す（以降の記録で上書きされる前に）
+static void ev_collect(void) {
+    g_prev_n = 0;
+    for (unsigned i = 0; i < SI5351_WDT_EVENTS; i++) {
+        const wdt_ev_t *e = &g_ev[i];
+        if (e->chk != ev_chk(e)) continue;
+        unsigned k = g_prev_n++;
+        while (k > 0 && g_prev[k - 1].seq > e->seq) { g_prev[k] = g_prev[k - 1]; k--; }
+        g_prev[k] = *e;
+    }
+    if (g_prev_n) g_ev_seq = g_prev[g_prev_n - 1].seq + 1u;
+}
+
+bool si5351_wdt_init(void) {
+    g_by_wdt = watchdog_enable_caused_reboot();
+    if (!g_by_wdt) {
+        memset(g_ev, 0, sizeof(g_ev));
+        watchdog_hw->scratch[SCR_MAGIC]  = 0;
+        watchdog_hw->scratch[SCR_STREAK] = 0;
+        return false;
+    }
+    ev_collect();
+
+    g_streak = watchdog_hw->scratch[SCR_STREAK] + 1u;
+    watchdog_hw->scratch[SCR_STREAK] = g_streak;
+
+    uint32_t s = watchdog_hw->scratch[SCR_SLOT], len = s >> 1;
+    g_slot = (uint8_t)(s & 1u);
+    if (watchdog_hw->scratch[SCR_MAGIC] != KEEP_MAGIC || len > SI5351_WDT_KEEP_BYTES ||
+        fnv1a(g_keep[g_slot], len) != watchdog_hw->scratch[SCR_SUM])
+        return false;
+    if (g_streak > SI5351_WDT_MAX_RESTORES) return false;     // 書き戻しのたびに止まっている
+    g_kept = g_keep[g_slot];
+    g_kept_len = len;
+    return true;
+}
+
+// ===== ウォッチドッグ =====
+void si5351_wdt_start(uint32_t ms) {
+    if (ms > SI5351_WDT_MAX_MS) ms = SI5351_WDT_MAX_MS;
+    g_timeout_ms = ms;
+    if (ms == 0) { hw_clear_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_ENABLE_BITS); return; }
+    watchdog_enable(ms, true);      // デバッガ停止中は数えない
+}
+
+uint32_t si5351_wdt_timeout_ms(void) {
+    return g_timeout_ms;
+}
+
+bool si5351_wdt_rebooted(void) {
+    return g_by_wdt;
+}
+
+void si5351_wdt_kick(void) {
+    if (g_timeout_ms == 0) return;
+#if SI5351_ENGINE_CORE1
+    // core1 のエンジンが 1 つの操作から戻らなければ, core0 が動いていても更新しない
+    uint32_t beat = si5351_engine_heartbeat();
+    if (beat != 0 && beat == g_beat) return;
+    g_beat = beat;
+#endif
+    watchdog_update();
+    // タイムアウトの 4 倍動き続けたら連続復元回数を戻す
+    if (g_streak && time_us_64() > 4000ull * g_timeout_ms) {
+        g_streak = 0;
+        watchdog_hw->scratch[SCR_STREAK] = 0;
+    }
+}
+
+// ===== 保持領域 =====
+void *si5351_wdt_keep_buf(void) {
+    return g_keep[g_slot ^ 1u];
+}
+
+void si5351_wdt_keep_commit(uint32_t len) {
+    uint8_t s = (uint8_t)(g_slot ^ 1u);
+    uint32_t sum = fnv1a(g_keep[s], len);
+    // 書き換え中にリセットされても前の面を採用しないよう, 印を外してから入れ替える
+    watchdog_hw->scratch[SCR_MAGIC] = 0;
+    watchdog_hw->scratch[SCR_SLOT]  = (len << 1) | s;
+    watchdog_hw->scratch[SCR_SUM]   = sum;
+    watchdog_hw->scratch[SCR_MAGIC] = KEEP_MAGIC;
+    g_slot = s;
+    g_kept = NULL;                  // 起動時の面は次の確定で上書きされる
+    g_commits++;
+}
+
+const void *si5351_wdt_kept(uint32_t *len) {
+    *len = g_kept_len;
+    return g_kept;
+}
+
+// ===== 操作記録 =====
+void si5351_wdt_note(const si5351_op_t *op) {
+    wdt_ev_t *e = &g_ev[g_ev_seq % SI5351_WDT_EVENTS];
+    e->seq  = g_ev_seq++;
+    e->t_ms = to_ms_since_boot(get_absolute_time());
+    e->op   = *op;
+    e->chk  = ev_chk(e);
+}
+
+void si5351_wdt_show(void) {
+    if (g_timeout_ms) serial_printf("wdt: timeout %lu ms", 1, (unsigned long)g_timeout_ms);
+    else              serial_printf("wdt: off", 1);
+    serial_printf("  last reset : %s%s", 1, g_by_wdt ? "watchdog timeout" : "power-on / external",
+                  (g_by_wdt && g_streak > SI5351_WDT_MAX_RESTORES) ? " (repeated: state not restored)" : "");
+    serial_printf("  keep area  : 2 x %u B, %lu snapshot(s) since boot, slot %u", 1,
+                  (unsigned)SI5351_WDT_KEEP_BYTES, (unsigned long)g_commits, g_slot);
+    if (!g_by_wdt) return;
+    if (!g_prev_n) { serial_printf("  no ops recorded before the reset", 1); return; }
+    serial_printf("  last %u op(s) before the reset (oldest first):", 1, g_prev_n);
+    for (unsigned i = 0; i < g_prev_n; i++) {
+        const wdt_ev_t *e = &g_prev[i];
+        serial_printf("  %8lu ms  op=%-3u ch=%u b0=%u b1=%u v=%lu", 1, (unsigned long)e->t_ms, e->op.code,
+                      e->op.ch, e->op.b0, e->op.b1, (unsigned long)e->op.v.u);
+    }
+}
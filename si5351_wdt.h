@@ -0,0 +1,80 @@
+/**
+ * @file    si5351_wdt.h
+ * @brief   ウォッチドッグ監視と再起動をまたぐ保持領域（Si5351 の状態・直近の操作記録）
+ * @date    2025-11-13
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * メインループ（と core1 構成ではエンジンの心拍）が止まると RP2040 のウォッチドッグが再起動する。
+ * エンジンは状態が変わるたびにレジスタシャドウ・プラン・出力設定を __uninitialized_ram の保持領域へ書き、
+ * 長さとチェックサムをウォッチドッグの scratch レジスタに置く。保持領域は 2 面あり、書き込み中に
+ * リセットされても直前に確定した面が残る。ウォッチドッグによる再起動で保持内容が有効なら、
+ * USB の接続を待たずにエンジンへ戻して Si5351 に書き戻す（si5351_engine_restore()）。
+ *
+ * 併せて、エンジンが実行した操作を直近 SI5351_WDT_EVENTS 件だけ保持領域に記録する（実行前に書くので、
+ * 止まった操作も残る）。再起動後に `wdt` で前回の記録を表示する。
+ *
+ * scratch[0..3] を使う（scratch[4..7] は SDK の watchdog_reboot() 用）。
+ */
+
+#ifndef SI5351_WDT_H
+#define SI5351_WDT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "si5351_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SI5351_WDT_MS
+#define SI5351_WDT_MS           3000    // 既定のタイムアウト [ms]（0=無効）
+#endif
+#define SI5351_WDT_MAX_MS       8388    // RP2040 の上限（24bit カウンタ, 1 us で 2 減る）
+#define SI5351_WDT_KEEP_BYTES   1024    // 保持領域 1 面の大きさ
+#define SI5351_WDT_EVENTS       16      // 操作記録の件数
+#define SI5351_WDT_MAX_RESTORES 3       // 連続してこの回数を超えたら書き戻さない（復元自体が止まる場合）
+
+/**
+ * @brief 起動理由と保持領域を調べる（main の最初に 1 回）
+ * @return 書き戻せる保持内容があれば true
+ */
+bool si5351_wdt_init(void);
+
+/** ウォッチドッグを ms [ms] で開始する（0 で停止, 上限 SI5351_WDT_MAX_MS） */
+void si5351_wdt_start(uint32_t ms);
+
+/** 現在のタイムアウト [ms]（0=停止中） */
+uint32_t si5351_wdt_timeout_ms(void);
+
+/** 直前の再起動がウォッチドッグのタイムアウトによるものなら true */
+bool si5351_wdt_rebooted(void);
+
+/**
+ * @brief ウォッチドッグを更新する（メインループ・待ちループから呼ぶ）
+ *
+ * core1 構成ではエンジンの心拍（si5351_engine_heartbeat()）が前回から進んでいなければ更新しない。
+ */
+void si5351_wdt_kick(void);
+
+/** 書き込み用の保持領域（確定済みでない側の面, SI5351_WDT_KEEP_BYTES） */
+void *si5351_wdt_keep_buf(void);
+
+/** si5351_wdt_keep_buf() に書いた len バイトを確定する（チェックサムを scratch へ） */
+void si5351_wdt_keep_commit(uint32_t len);
+
+/** 起動時に有効だった保持内容（なければ NULL, 最初の確定以降も NULL）。*len に長さ */
+const void *si5351_wdt_kept(uint32_t *len);
+
+/** 操作を記録する（エンジンが実行する直前に呼ぶ） */
+void si5351_wdt_note(const si5351_op_t *op);
+
+/** 設定・起動理由・保持領域の状態と前回の操作記録を表示する */
+void si5351_wdt_show(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SI5351_WDT_H
@@ -0,0 +1,20 @@
+/**
+ * @file    timer.h
+ * @brief   ホスト単体テスト用の hardware/structs/timer.h 最小スタブ（si5351_hot.h の型だけ）
+ * @date    2025-11-18
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_HARDWARE_STRUCTS_TIMER_H
+#define HOST_HARDWARE_STRUCTS_TIMER_H
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t timerawh, timerawl;
+} timer_hw_t;
+
+extern timer_hw_t *timer_hw;    // テストからは読まない（定義なし）
+
+#endif // HOST_HARDWARE_STRUCTS_TIMER_H
@@ -0,0 +1,28 @@
+/**
+ * @file    stdlib.h
+ * @brief   ホスト単体テスト用の pico/stdlib.h 最小スタブ（時刻は clock() から）
+ * @date    2025-11-18
+ * @version 1.0
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+typedef unsigned int uint;
+
+#define __not_in_flash_func(f)  f
+
+static inline uint64_t time_us_64(void) {
+    return (uint64_t)clock() * 1000000u / CLOCKS_PER_SEC;
+}
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+#endif // HOST_PICO_STDLIB_H
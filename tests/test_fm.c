@@ -0,0 +1,82 @@
+/**
+ * @file    test_fm.c
+ * @brief   fm の MS 像（P3 = 2^19 固定の P1 / P2）の単体テスト
+ * @date    2025-11-18
+ * @version 1.0
+ */
+
+#include "si5351_fm.h"
+#include "si5351_plan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int g_fail;
+
+#define CHECK(cond, ...) do { if (!(cond)) { g_fail++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static uint32_t g_rng = 0x6C078965u;
+static uint32_t rnd(uint32_t n) {
+    g_rng ^= g_rng << 13; g_rng ^= g_rng >> 17; g_rng ^= g_rng << 5;
+    return g_rng % n;
+}
+
+// 開始時と同じ像（P3 下位 = 0, R_DIV だけ入れる）に u を詰める
+static void pack(int64_t u, uint8_t r_log2, uint8_t d[8]) {
+    memset(d, 0, 8);
+    d[2] = (uint8_t)((r_log2 & 0x07) << 4);
+    si5351_fm_pack(u, d);
+}
+
+// MS = a + b / 2^19 は si5351_encode_ms() と同じ 8 バイトになる
+static void test_vs_encode_ms(void) {
+    const uint32_t c = 1u << SI5351_FM_P3_LOG2;
+    for (int i = 0; i < 100000; i++) {
+        si5351_frac_t ms = { SI5351_MS_FRAC_MIN + rnd(SI5351_MS_MAX - SI5351_MS_FRAC_MIN), rnd(c), c };
+        uint8_t r = (uint8_t)rnd(8), want[8], got[8];
+        int64_t u = (((int64_t)ms.a << SI5351_FM_P3_LOG2) + ms.b) << (SI5351_FM_U_SHIFT - SI5351_FM_P3_LOG2);
+        si5351_encode_ms(&ms, r, false, want);
+        pack(u, r, got);
+        CHECK(memcmp(want, got, 8) == 0, "MS %lu+%lu/%lu R=%u: %02X %02X %02X %02X %02X %02X %02X %02X", (unsigned long)ms.a,
+              (unsigned long)ms.b, (unsigned long)ms.c, 1u << r, got[0], got[1], got[2], got[3], got[4], got[5], got[6], got[7]);
+    }
+}
+
+// 任意の u で P1 / P2 / P3 から戻した MS × 2^26 は u と一致する（下位ビットも捨てない）
+static void test_exact_u(void) {
+    const int64_t u_min = ((int64_t)SI5351_MS_FRAC_MIN << SI5351_FM_U_SHIFT) + 1;
+    const int64_t u_max = ((int64_t)SI5351_MS_MAX << SI5351_FM_U_SHIFT) - 1;
+    for (int i = 0; i < 100000; i++) {
+        int64_t u = u_min + (((int64_t)rnd(1u << 31) << 6) | rnd(64)) % (u_max - u_min + 1);
+        if (i == 0) u = u_min;
+        if (i == 1) u = u_max;
+        uint8_t r = (uint8_t)rnd(8), d[8];
+        pack(u, r, d);
+        uint32_t p1 = ((uint32_t)(d[2] & 0x03) << 16) | ((uint32_t)d[3] << 8) | d[4];
+        uint32_t p2 = ((uint32_t)(d[5] & 0x0F) << 16) | ((uint32_t)d[6] << 8) | d[7];
+        uint32_t p3 = ((uint32_t)(d[5] & 0xF0) << 12) | ((uint32_t)d[0] << 8) | d[1];
+        // MS = (P1 + 512 + P2 / P3) / 128  →  MS × 2^26 = (P1 + 512) × 2^19 + P2（P3 = 2^19）
+        int64_t back = ((int64_t)(p1 + 512u) << SI5351_FM_P3_LOG2) + p2;
+        CHECK(p3 == (1u << SI5351_FM_P3_LOG2) && p2 < p3, "u=%lld: P3=%lu P2=%lu", (long long)u, (unsigned long)p3,
+              (unsigned long)p2);
+        CHECK(back == u, "u=%lld packs to %lld", (long long)u, (long long)back);
+        CHECK(((d[2] >> 4) & 0x07) == r && (d[2] & 0x0C) == 0, "u=%lld: R/DIVBY4 bits changed (0x%02X)", (long long)u, d[2]);
+    }
+}
+
+// 隣り合う u は P2 の下位だけが変わる（変調中の書込みが数バイトで済む）
+static void test_small_step(void) {
+    int64_t u = ((int64_t)100 << SI5351_FM_U_SHIFT) + 12345;
+    uint8_t a[8], b[8];
+    pack(u, 0, a);
+    pack(u + 1, 0, b);
+    CHECK(memcmp(a, b, 7) == 0 && a[7] + 1 == b[7], "u+1 changes more than P2[7:0]");
+}
+
+int main(void) {
+    test_vs_encode_ms();
+    test_exact_u();
+    test_small_step();
+    printf("test_fm: %s\n", g_fail ? "FAILED" : "ok");
+    return g_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
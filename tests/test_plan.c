@@ -0,0 +1,167 @@
+/**
+ * @file    test_plan.c
+ * @brief   連分数ソルバとプランナの単体テスト（正確に表せる分周比・総当たりとの比較・ウォームスタート）
+ * @date    2025-11-18
+ * @version 1.0
+ */
+
+#include "si5351_plan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static int g_fail;
+
+#define CHECK(cond, ...) do { if (!(cond)) { g_fail++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static uint64_t gcd64(uint64_t a, uint64_t b) {
+    while (b) { uint64_t t = a % b; a = b; b = t; }
+    return a;
+}
+
+// 再現可能な擬似乱数（xorshift32）
+static uint32_t g_rng = 0x12345678u;
+static uint32_t rnd(uint32_t n) {
+    g_rng ^= g_rng << 13; g_rng ^= g_rng >> 17; g_rng ^= g_rng << 5;
+    return g_rng % n;
+}
+
+// 分母 max_den 以下で表せる比はそのまま（既約形で）返る
+static void test_exact(void) {
+    for (int i = 0; i < 10000; i++) {
+        uint32_t a = 4 + rnd(2045), c = 1 + rnd(SI5351_FRAC_MAX_DEN), b = rnd(c);
+        uint64_t g = gcd64(b, c);
+        uint64_t num = (uint64_t)a * c + b;
+        si5351_frac_t f;
+        si5351_frac_approx(num, c, SI5351_FRAC_MAX_DEN, &f);
+        uint32_t eb = (uint32_t)(b / g), ec = (uint32_t)(c / g);
+        if (b == 0) ec = 1;
+        CHECK(f.a == a && f.b == eb && f.c == ec, "%lu/%lu -> %lu+%lu/%lu (want %lu+%lu/%lu)",
+              (unsigned long)num, (unsigned long)c, (unsigned long)f.a, (unsigned long)f.b, (unsigned long)f.c,
+              (unsigned long)a, (unsigned long)eb, (unsigned long)ec);
+    }
+}
+
+// 小さい max_den では総当たりの最良近似と誤差が一致する
+static void test_best(void) {
+    const uint32_t max_den = 1000;
+    for (int i = 0; i < 300; i++) {
+        uint64_t den = 1000 + rnd(1000000), num = den * 4 + rnd((uint32_t)den * 60);
+        si5351_frac_t f;
+        si5351_frac_approx(num, den, max_den, &f);
+        CHECK(f.c >= 1 && f.c <= max_den && f.b < f.c, "%lu/%lu -> c=%lu", (unsigned long)num, (unsigned long)den,
+              (unsigned long)f.c);
+
+        // 誤差 |num*q - p*den| / (den*q) を q を揃えて比べる（e1/q1 と e2/q2）
+        uint64_t p = (uint64_t)f.a * f.c + f.b;
+        uint64_t e = (num * f.c > p * den) ? num * f.c - p * den : p * den - num * f.c;
+        uint64_t best_e = UINT64_MAX, best_q = 1;
+        for (uint64_t q = 1; q <= max_den; q++) {
+            uint64_t pq = (num * q + den / 2) / den;
+            uint64_t eq = (num * q > pq * den) ? num * q - pq * den : pq * den - num * q;
+            if (best_e == UINT64_MAX || eq * best_q < best_e * q) { best_e = eq; best_q = q; }
+        }
+        CHECK(e * best_q == best_e * f.c, "%lu/%lu: solver %lu+%lu/%lu worse than brute force q=%lu",
+              (unsigned long)num, (unsigned long)den, (unsigned long)f.a, (unsigned long)f.b, (unsigned long)f.c,
+              (unsigned long)best_q);
+    }
+}
+
+// キャッシュ版はキャッシュなし版と完全に一致する（1 Hz 刻みとランダム目標）
+static void test_cached(void) {
+    si5351_cf_cache_t cc;
+    si5351_cf_cache_init(&cc);
+    for (uint32_t k = 0; k < 2000; k++) {
+        uint32_t f = (k < 1000) ? 7000000u + k : 2500u + rnd(150000000u);
+        si5351_frac_t x, y;
+        si5351_frac_approx(800000000ULL, f, SI5351_FRAC_MAX_DEN, &x);
+        si5351_frac_approx_cached(&cc, 800000000ULL, f, SI5351_FRAC_MAX_DEN, &y);
+        CHECK(x.a == y.a && x.b == y.b && x.c == y.c, "f=%lu: cached %lu+%lu/%lu != %lu+%lu/%lu", (unsigned long)f,
+              (unsigned long)y.a, (unsigned long)y.b, (unsigned long)y.c,
+              (unsigned long)x.a, (unsigned long)x.b, (unsigned long)x.c);
+    }
+    CHECK(cc.warm_hits > 0, "no warm start over 1 Hz steps");
+}
+
+// 整数分周で正確に出せる周波数は誤差 0 の候補が選ばれ, 採用値はレジスタ上の分周比と一致する
+static void test_planner(void) {
+    static const uint32_t exact[] = { 100000000u, 50000000u, 25000000u, 10000000u, 1000000u, 150000000u, 3125000u };
+    for (unsigned i = 0; i < sizeof(exact) / sizeof(exact[0]); i++) {
+        si5351_plan_t p;
+        si5351_plan_init(&p);
+        p.budget_us = 1000000;
+        int rc = si5351_plan_channel(&p, 0, exact[i]);
+        const si5351_cand_t *c = &p.ch[0].sel;
+        CHECK(rc == 0, "f=%lu rc=%d", (unsigned long)exact[i], rc);
+        if (rc != 0) continue;
+        double vco = (double)p.ref_hz * ((double)c->fb.a + (double)c->fb.b / c->fb.c);
+        double f = vco / ((double)c->ms.a + (double)c->ms.b / c->ms.c) / (double)(1u << c->r_log2);
+        CHECK(c->err_ppb == 0.0, "f=%lu err=%.3f ppb", (unsigned long)exact[i], c->err_ppb);
+        CHECK(c->ms.b == 0 && (c->flags & SI5351_CF_INT_MS), "f=%lu MS not integer", (unsigned long)exact[i]);
+        CHECK(fabs(f - exact[i]) < 1e-6 && fabs(c->actual_hz - f) < 1e-6, "f=%lu actual=%.6f", (unsigned long)exact[i], f);
+        CHECK(vco >= SI5351_VCO_MIN_HZ && vco <= SI5351_VCO_MAX_HZ, "f=%lu vco=%.0f", (unsigned long)exact[i], vco);
+    }
+
+    // 分数でしか出せない周波数も, 採用値は目標から 1 ppb 以内
+    for (int i = 0; i < 50; i++) {
+        uint32_t f0 = 2500u + rnd(150000000u - 2500u);
+        si5351_plan_t p;
+        si5351_plan_init(&p);
+        p.budget_us = 1000000;
+        int rc = si5351_plan_channel(&p, 0, f0);
+        CHECK(rc == 0 && p.ch[0].sel.err_ppb < 1.0, "f=%lu rc=%d err=%.3f ppb", (unsigned long)f0, rc, p.ch[0].sel.err_ppb);
+    }
+}
+
+// レジスタ像は AN619 の P1/P2/P3 の定義どおり
+static void test_encode(void) {
+    for (int i = 0; i < 1000; i++) {
+        si5351_frac_t ms = { 8 + rnd(2040), 0, 1 + rnd(SI5351_FRAC_MAX_DEN) };
+        ms.b = rnd(ms.c);
+        uint8_t r = (uint8_t)rnd(8), d[8];
+        si5351_encode_ms(&ms, r, false, d);
+        uint32_t fl = (uint32_t)(128ull * ms.b / ms.c);
+        uint32_t p1 = 128u * ms.a + fl - 512u, p2 = 128u * ms.b - ms.c * fl, p3 = ms.c;
+        uint32_t g1 = ((uint32_t)(d[2] & 0x03) << 16) | ((uint32_t)d[3] << 8) | d[4];
+        uint32_t g2 = ((uint32_t)(d[5] & 0x0F) << 16) | ((uint32_t)d[6] << 8) | d[7];
+        uint32_t g3 = ((uint32_t)(d[5] & 0xF0) << 12) | ((uint32_t)d[0] << 8) | d[1];
+        CHECK(g1 == p1 && g2 == p2 && g3 == p3 && ((d[2] >> 4) & 7) == r,
+              "MS %lu+%lu/%lu R=%u: P1=%lu P2=%lu P3=%lu", (unsigned long)ms.a, (unsigned long)ms.b,
+              (unsigned long)ms.c, 1u << r, (unsigned long)g1, (unsigned long)g2, (unsigned long)g3);
+    }
+}
+
+// 基準を切り替えて戻しても fine のオフセットは残る（キャッシュから復元・再探索の両方）
+static void test_ref_fine(void) {
+    si5351_plan_t p;
+    si5351_plan_init(&p);
+    p.budget_us = 1000000;
+    CHECK(si5351_plan_channel(&p, 0, 10000000u) == 0 && si5351_plan_fine(&p, 0, 12.5) == 0, "plan + fine");
+    double f0 = p.ch[0].sel.actual_hz;
+
+    CHECK(si5351_plan_set_ref(&p, 27000000u) == 0, "re-solve at 27 MHz");
+    // 再探索の fine は帰還分数の刻み（27 MHz / c / MS ≒ 0.3 Hz）で量子化される
+    CHECK(p.ch[0].fine_hz == 12.5 && fabs(p.ch[0].sel.actual_hz - 10000012.5) < 0.5,
+          "re-solve: fine=%.3f actual=%.6f", p.ch[0].fine_hz, p.ch[0].sel.actual_hz);
+
+    CHECK(si5351_plan_set_ref(&p, SI5351_XTAL_HZ) == 1, "restore 25 MHz from cache");
+    CHECK(p.ch[0].fine_hz == 12.5 && fabs(p.ch[0].sel.actual_hz - f0) < 1e-3,
+          "cache: fine=%.3f actual=%.6f (want %.6f)", p.ch[0].fine_hz, p.ch[0].sel.actual_hz, f0);
+
+    // オフセットを変えた後はキャッシュを使わず, 新しいオフセットで解き直す
+    CHECK(si5351_plan_fine(&p, 0, -3.0) == 0, "fine -3 Hz");
+    CHECK(si5351_plan_set_ref(&p, 27000000u) == 0, "stale cache must not be used");
+    CHECK(p.ch[0].fine_hz == -3.0 && fabs(p.ch[0].sel.actual_hz - (10000000.0 - 3.0)) < 0.5,
+          "fine=%.3f actual=%.6f", p.ch[0].fine_hz, p.ch[0].sel.actual_hz);
+}
+
+int main(void) {
+    test_exact();
+    test_best();
+    test_cached();
+    test_planner();
+    test_encode();
+    test_ref_fine();
+    printf("test_plan: %s\n", g_fail ? "FAILED" : "ok");
+    return g_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
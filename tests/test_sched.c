@@ -0,0 +1,107 @@
+/**
+ * @file    test_sched.c
+ * @brief   予約実行キューの単体テスト（時刻順・同時刻は投入順・スロットの再利用）
+ * @date    2025-11-18
+ * @version 1.0
+ */
+
+#include "si5351_sched.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int g_fail;
+
+#define CHECK(cond, ...) do { if (!(cond)) { g_fail++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static uint32_t g_rng = 0x9E3779B9u;
+static uint32_t rnd(uint32_t n) {
+    g_rng ^= g_rng << 13; g_rng ^= g_rng >> 17; g_rng ^= g_rng << 5;
+    return g_rng % n;
+}
+
+// 参照モデル: スロットごとの (時刻, 投入順)
+static uint64_t g_t[SI5351_SCHED_MAX];
+static uint32_t g_order[SI5351_SCHED_MAX];
+static bool     g_live[SI5351_SCHED_MAX];
+
+// 生きているエントリのうち (時刻, 投入順) が最小のスロット
+static int model_min(void) {
+    int m = -1;
+    for (int i = 0; i < SI5351_SCHED_MAX; i++) {
+        if (!g_live[i]) continue;
+        if (m < 0 || g_t[i] < g_t[m] || (g_t[i] == g_t[m] && g_order[i] < g_order[m])) m = i;
+    }
+    return m;
+}
+
+// 満杯まで積んで全部取り出すと時刻順, 同時刻は投入順
+static void test_fill_drain(void) {
+    si5351_sched_t s;
+    si5351_sched_init(&s);
+    uint64_t t_of[SI5351_SCHED_MAX];
+    int order_of[SI5351_SCHED_MAX];
+    for (int i = 0; i < SI5351_SCHED_MAX; i++) {
+        uint64_t t = 1000u + rnd(4) * 10u;          // 同時刻を多く作る
+        int slot = si5351_sched_push(&s, t);
+        CHECK(slot >= 0 && slot < SI5351_SCHED_MAX, "push #%d slot=%d", i, slot);
+        if (slot < 0) return;
+        t_of[slot] = t;
+        order_of[slot] = i;
+    }
+    CHECK(si5351_sched_push(&s, 0) == -1, "push into a full queue");
+
+    uint64_t last_t = 0;
+    int last_order = -1;
+    for (int i = 0; i < SI5351_SCHED_MAX; i++) {
+        uint64_t t;
+        uint8_t slot;
+        CHECK(si5351_sched_peek(&s, &t, &slot), "peek #%d on non-empty queue", i);
+        CHECK(si5351_sched_pop(&s) == slot, "pop #%d differs from peek", i);
+        CHECK(t == t_of[slot], "slot %u time %llu != %llu", slot, (unsigned long long)t, (unsigned long long)t_of[slot]);
+        CHECK(t > last_t || (t == last_t && order_of[slot] > last_order),
+              "pop #%d out of order: t=%llu order=%d after t=%llu order=%d", i, (unsigned long long)t,
+              order_of[slot], (unsigned long long)last_t, last_order);
+        last_t = t;
+        last_order = order_of[slot];
+        si5351_sched_free(&s, slot);
+    }
+    CHECK(!si5351_sched_peek(&s, NULL, NULL) && si5351_sched_pop(&s) == -1, "queue not empty after drain");
+    CHECK(s.used == 0, "slots still used: 0x%08lx", (unsigned long)s.used);
+}
+
+// 投入・取り出しを混ぜても参照モデルと同じ順に出る（スロットは解放後に再利用される）
+static void test_mixed(void) {
+    si5351_sched_t s;
+    si5351_sched_init(&s);
+    uint32_t order = 0;
+    for (int i = 0; i < 100000; i++) {
+        if (rnd(3) != 0) {
+            uint64_t t = rnd(64);
+            int slot = si5351_sched_push(&s, t);
+            int live = 0;
+            for (int k = 0; k < SI5351_SCHED_MAX; k++) live += g_live[k];
+            if (live == SI5351_SCHED_MAX) { CHECK(slot == -1, "push into a full queue returned %d", slot); continue; }
+            CHECK(slot >= 0 && !g_live[slot], "push returned slot %d (in use or invalid)", slot);
+            if (slot < 0 || g_live[slot]) return;
+            g_live[slot] = true;
+            g_t[slot] = t;
+            g_order[slot] = order++;
+        } else {
+            int want = model_min();
+            int got = si5351_sched_pop(&s);
+            CHECK(got == want, "step %d: pop %d, model %d", i, got, want);
+            if (got != want) return;
+            if (got >= 0) {
+                g_live[got] = false;
+                si5351_sched_free(&s, (uint8_t)got);
+            }
+        }
+    }
+}
+
+int main(void) {
+    test_fill_drain();
+    test_mixed();
+    printf("test_sched: %s\n", g_fail ? "FAILED" : "ok");
+    return g_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
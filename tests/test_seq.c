@@ -0,0 +1,123 @@
+/**
+ * @file    test_seq.c
+ * @brief   レジスタ列の差分圧縮形式の単体テスト（符号化→復号の往復・容量不足で捨てたステップの巻き戻し）
+ * @date    2025-11-18
+ * @version 1.0
+ */
+
+#include "si5351_seq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int g_fail;
+
+#define CHECK(cond, ...) do { if (!(cond)) { g_fail++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static uint32_t g_rng = 0x2545F491u;
+static uint32_t rnd(uint32_t n) {
+    g_rng ^= g_rng << 13; g_rng ^= g_rng >> 17; g_rng ^= g_rng << 5;
+    return g_rng % n;
+}
+
+// 復号先のレジスタファイル
+static uint8_t g_regs[256];
+
+static bool sink(void *ctx, uint8_t reg, const uint8_t *d, uint8_t len) {
+    uint32_t *runs = ctx;
+    for (uint8_t i = 0; i < len; i++) g_regs[(uint8_t)(reg + i)] = d[i];
+    (*runs)++;
+    return true;
+}
+
+// 掃引らしい 1 ステップ: PLL 像 8 バイト（時々）と MS 像 8 バイトの下位数バイトが変わる
+static void make_step(uint8_t *pll, uint8_t *ms) {
+    if (rnd(8) == 0) pll[rnd(8)] = (uint8_t)rnd(256);
+    for (int k = 5 + (int)rnd(3); k < 8; k++) ms[k] = (uint8_t)rnd(256);
+}
+
+// 各ステップを復号して積み上げたレジスタ値が, そのステップで書いた像と一致する
+static void test_round_trip(void) {
+    static uint8_t buf[65536];
+    static si5351_seq_t q;
+    uint8_t pll[8], ms[8], ctrl = 0x4F;
+    for (int k = 0; k < 8; k++) { pll[k] = (uint8_t)rnd(256); ms[k] = (uint8_t)rnd(256); }
+
+    si5351_seq_init(&q, buf, sizeof(buf));
+    memset(q.img, 0, sizeof(q.img));
+    uint8_t want[1000][17];
+    int n = 0;
+    for (; n < 1000; n++) {
+        make_step(pll, ms);
+        if (rnd(50) == 0) ctrl ^= 0x40;
+        CHECK(si5351_seq_begin(&q), "begin #%d", n);
+        CHECK(si5351_seq_put(&q, 26, pll, 8, n == 0) >= 0, "put PLL #%d", n);
+        CHECK(si5351_seq_put(&q, 42, ms, 8, n == 0) >= 0, "put MS #%d", n);
+        CHECK(si5351_seq_put(&q, 16, &ctrl, 1, n == 0) >= 0, "put CTRL #%d", n);
+        CHECK(si5351_seq_end(&q), "end #%d", n);
+        memcpy(&want[n][0], pll, 8);
+        memcpy(&want[n][8], ms, 8);
+        want[n][16] = ctrl;
+    }
+    CHECK(q.n_steps == 1000u, "n_steps=%lu", (unsigned long)q.n_steps);
+    CHECK(q.len < q.raw_bytes, "no compression: %lu bytes for %lu raw", (unsigned long)q.len, (unsigned long)q.raw_bytes);
+
+    memset(g_regs, 0, sizeof(g_regs));
+    uint32_t pos = 0, runs = 0;
+    for (int i = 0; i < n; i++) {
+        CHECK(pos < q.len && si5351_seq_decode(&q, &pos, sink, &runs), "decode #%d at %lu", i, (unsigned long)pos);
+        CHECK(memcmp(&g_regs[26], &want[i][0], 8) == 0 && memcmp(&g_regs[42], &want[i][8], 8) == 0 &&
+              g_regs[16] == want[i][16], "step #%d decodes to a different image", i);
+    }
+    CHECK(pos == q.len, "decoded %lu of %lu bytes", (unsigned long)pos, (unsigned long)q.len);
+    CHECK(runs == q.runs, "decoded %lu runs, encoder counted %lu", (unsigned long)runs, (unsigned long)q.runs);
+    CHECK(memcmp(g_regs, q.img, sizeof(g_regs)) == 0, "decoded registers differ from encoder img");
+}
+
+// 容量不足で捨てたステップの書込みは img/touched/raw_bytes にも残らず, 次の列が正しく復号できる
+static void test_overflow_rollback(void) {
+    uint8_t buf[30];                                    // 1 ステップ目 11 バイト + 2 ステップ目は 32 バイト必要
+    static si5351_seq_t q;
+    uint8_t a[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, b[8] = { 9, 9, 9, 9, 9, 9, 9, 9 };
+
+    si5351_seq_init(&q, buf, sizeof(buf));
+    CHECK(si5351_seq_begin(&q) && si5351_seq_put(&q, 26, a, 8, true) == 8 && si5351_seq_end(&q), "first step");
+    uint32_t len0 = q.len, raw0 = q.raw_bytes;
+    uint8_t img0[256];
+    uint32_t touched0[256 / 32];
+    memcpy(img0, q.img, sizeof(img0));
+    memcpy(touched0, q.touched, sizeof(touched0));
+
+    // 1 run 目（PLL）は入り, 2 run 目（MS）で溢れる
+    CHECK(si5351_seq_begin(&q), "second step begin");
+    CHECK(si5351_seq_put(&q, 26, b, 8, false) == 8, "second step PLL fits");
+    CHECK(si5351_seq_put(&q, 42, b, 8, false) < 0, "second step MS overflows");
+    CHECK(!si5351_seq_end(&q), "overflowed step must be discarded");
+    CHECK(q.len == len0 && q.raw_bytes == raw0 && q.n_steps == 1, "len=%lu raw=%lu steps=%lu after discard",
+          (unsigned long)q.len, (unsigned long)q.raw_bytes, (unsigned long)q.n_steps);
+    CHECK(memcmp(img0, q.img, sizeof(img0)) == 0, "img keeps the discarded step's bytes");
+    CHECK(memcmp(touched0, q.touched, sizeof(touched0)) == 0, "touched keeps the discarded step's bytes");
+
+    // 同じ像をもう一度積めば差分として全部出る（巻き戻しがなければ 0 バイトになる）
+    q.overflow = false;
+    CHECK(si5351_seq_begin(&q) && si5351_seq_put(&q, 26, b, 8, false) == 8 && si5351_seq_end(&q), "retry step");
+
+    // 途中で打ち切ったステップも si5351_seq_cancel で同じく戻る
+    memcpy(img0, q.img, sizeof(img0));
+    uint32_t len1 = q.len;
+    CHECK(si5351_seq_begin(&q) && si5351_seq_put(&q, 26, a, 1, false) == 1, "cancelled step put");
+    si5351_seq_cancel(&q);
+    CHECK(q.len == len1 && memcmp(img0, q.img, sizeof(img0)) == 0, "cancel did not restore the step start");
+
+    memset(g_regs, 0, sizeof(g_regs));
+    uint32_t pos = 0, runs = 0;
+    while (pos < q.len) CHECK(si5351_seq_decode(&q, &pos, sink, &runs), "decode at %lu", (unsigned long)pos);
+    CHECK(memcmp(&g_regs[26], b, 8) == 0, "decoded PLL image is not the retried one");
+}
+
+int main(void) {
+    test_round_trip();
+    test_overflow_rollback();
+    printf("test_seq: %s\n", g_fail ? "FAILED" : "ok");
+    return g_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}